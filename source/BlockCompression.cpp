@@ -0,0 +1,356 @@
+#include "pch.h"
+#include "BlockCompression.h"
+#include <climits>
+#include <type_traits>
+
+namespace dae
+{
+	namespace
+	{
+		constexpr int TexelCount{ 16 };
+
+		//565 endpoint <-> 8 bit channels, the low bits get refilled with the high ones like the hardware does
+		void UnpackColor565(uint16_t color, int* pChannels)
+		{
+			const int r{ (color >> 11) & 31 };
+			const int g{ (color >> 5) & 63 };
+			const int b{ color & 31 };
+
+			pChannels[0] = (r << 3) | (r >> 2);
+			pChannels[1] = (g << 2) | (g >> 4);
+			pChannels[2] = (b << 3) | (b >> 2);
+		}
+
+		uint16_t PackColor565(const float* pChannels)
+		{
+			const int r{ Clamp(static_cast<int>(std::lround(pChannels[0] * 31.0f / 255.0f)), 0, 31) };
+			const int g{ Clamp(static_cast<int>(std::lround(pChannels[1] * 63.0f / 255.0f)), 0, 63) };
+			const int b{ Clamp(static_cast<int>(std::lround(pChannels[2] * 31.0f / 255.0f)), 0, 31) };
+
+			return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+		}
+
+		//Builds the 4 entry palette, without punch-through c0 <= c1 still interpolates (BC3 colour blocks)
+		void BuildColorPalette(uint16_t color0, uint16_t color1, bool allowPunchThrough, int palette[4][4])
+		{
+			UnpackColor565(color0, palette[0]);
+			UnpackColor565(color1, palette[1]);
+			palette[0][3] = 255;
+			palette[1][3] = 255;
+
+			const bool isFourColor{ color0 > color1 || !allowPunchThrough };
+
+			for (int channel{}; channel < 3; ++channel)
+			{
+				const int c0{ palette[0][channel] };
+				const int c1{ palette[1][channel] };
+
+				if (isFourColor)
+				{
+					palette[2][channel] = (2 * c0 + c1 + 1) / 3;
+					palette[3][channel] = (c0 + 2 * c1 + 1) / 3;
+				}
+				else
+				{
+					palette[2][channel] = (c0 + c1 + 1) / 2;
+					palette[3][channel] = 0;
+				}
+			}
+
+			palette[2][3] = 255;
+			palette[3][3] = isFourColor ? 255 : 0;
+		}
+
+		//Fits the endpoints along the principal axis of the block's colours, then picks the closest palette entry per texel
+		void EncodeColorBlock(const uint8_t* pTexels, uint8_t* pBlock)
+		{
+			float mean[3]{};
+			for (int i{}; i < TexelCount; ++i)
+			{
+				for (int channel{}; channel < 3; ++channel)
+				{
+					mean[channel] += pTexels[i * 4 + channel] / static_cast<float>(TexelCount);
+				}
+			}
+
+			float covariance[3][3]{};
+			for (int i{}; i < TexelCount; ++i)
+			{
+				const float delta[3]{ pTexels[i * 4] - mean[0], pTexels[i * 4 + 1] - mean[1], pTexels[i * 4 + 2] - mean[2] };
+
+				for (int row{}; row < 3; ++row)
+				{
+					for (int column{}; column < 3; ++column)
+					{
+						covariance[row][column] += delta[row] * delta[column];
+					}
+				}
+			}
+
+			//A few power iterations are plenty for a 3x3 matrix
+			float axis[3]{ 1.0f, 1.0f, 1.0f };
+			for (int iteration{}; iteration < 8; ++iteration)
+			{
+				float next[3]{};
+				for (int row{}; row < 3; ++row)
+				{
+					next[row] = covariance[row][0] * axis[0] + covariance[row][1] * axis[1] + covariance[row][2] * axis[2];
+				}
+
+				const float length{ std::max({ std::abs(next[0]), std::abs(next[1]), std::abs(next[2]) }) };
+				if (length <= FLT_EPSILON)
+				{
+					break;
+				}
+
+				for (int channel{}; channel < 3; ++channel)
+				{
+					axis[channel] = next[channel] / length;
+				}
+			}
+
+			float minProjection{ FLT_MAX };
+			float maxProjection{ -FLT_MAX };
+			for (int i{}; i < TexelCount; ++i)
+			{
+				const float projection{ (pTexels[i * 4] - mean[0]) * axis[0] + (pTexels[i * 4 + 1] - mean[1]) * axis[1] + (pTexels[i * 4 + 2] - mean[2]) * axis[2] };
+				minProjection = std::min(minProjection, projection);
+				maxProjection = std::max(maxProjection, projection);
+			}
+
+			//Inset the endpoints a bit, the extremes are rarely worth a palette entry of their own
+			const float axisSqrLength{ axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2] };
+			const float inset{ (maxProjection - minProjection) / 16.0f };
+			float maxColor[3]{};
+			float minColor[3]{};
+
+			for (int channel{}; channel < 3; ++channel)
+			{
+				const float direction{ axisSqrLength > FLT_EPSILON ? axis[channel] / axisSqrLength : 0.0f };
+				maxColor[channel] = Clamp(mean[channel] + (maxProjection - inset) * direction, 0.0f, 255.0f);
+				minColor[channel] = Clamp(mean[channel] + (minProjection + inset) * direction, 0.0f, 255.0f);
+			}
+
+			uint16_t color0{ PackColor565(maxColor) };
+			uint16_t color1{ PackColor565(minColor) };
+
+			//Four colour mode needs color0 > color1, equal endpoints make every texel index 0
+			if (color0 < color1)
+			{
+				std::swap(color0, color1);
+			}
+
+			int palette[4][4]{};
+			BuildColorPalette(color0, color1, false, palette);
+
+			uint32_t indices{};
+			if (color0 != color1)
+			{
+				for (int i{}; i < TexelCount; ++i)
+				{
+					int bestIndex{};
+					int bestDistance{ INT_MAX };
+
+					for (int index{}; index < 4; ++index)
+					{
+						int distance{};
+						for (int channel{}; channel < 3; ++channel)
+						{
+							const int delta{ pTexels[i * 4 + channel] - palette[index][channel] };
+							distance += delta * delta;
+						}
+
+						if (distance < bestDistance)
+						{
+							bestDistance = distance;
+							bestIndex = index;
+						}
+					}
+
+					indices |= static_cast<uint32_t>(bestIndex) << (i * 2);
+				}
+			}
+
+			pBlock[0] = static_cast<uint8_t>(color0 & 0xFF);
+			pBlock[1] = static_cast<uint8_t>(color0 >> 8);
+			pBlock[2] = static_cast<uint8_t>(color1 & 0xFF);
+			pBlock[3] = static_cast<uint8_t>(color1 >> 8);
+			std::memcpy(pBlock + 4, &indices, sizeof(indices));
+		}
+
+		void DecodeColorBlock(const uint8_t* pBlock, uint8_t* pTexels, bool allowPunchThrough)
+		{
+			const uint16_t color0{ static_cast<uint16_t>(pBlock[0] | (pBlock[1] << 8)) };
+			const uint16_t color1{ static_cast<uint16_t>(pBlock[2] | (pBlock[3] << 8)) };
+
+			int palette[4][4]{};
+			BuildColorPalette(color0, color1, allowPunchThrough, palette);
+
+			uint32_t indices{};
+			std::memcpy(&indices, pBlock + 4, sizeof(indices));
+
+			for (int i{}; i < TexelCount; ++i)
+			{
+				const int* pColor{ palette[(indices >> (i * 2)) & 3] };
+
+				//BC3 keeps the alpha the alpha block wrote
+				const int channelCount{ allowPunchThrough ? 4 : 3 };
+				for (int channel{}; channel < channelCount; ++channel)
+				{
+					pTexels[i * 4 + channel] = static_cast<uint8_t>(pColor[channel]);
+				}
+			}
+		}
+
+		//Single channel blocks (BC3 alpha, BC4, both halves of BC5), Value is uint8_t for unorm and int8_t for snorm
+		template<typename Value>
+		void BuildAlphaPalette(int alpha0, int alpha1, int palette[8])
+		{
+			constexpr int minValue{ std::is_signed_v<Value> ? -127 : 0 };
+			constexpr int maxValue{ std::is_signed_v<Value> ? 127 : 255 };
+
+			palette[0] = alpha0;
+			palette[1] = alpha1;
+
+			if (alpha0 > alpha1)
+			{
+				for (int i{ 2 }; i < 8; ++i)
+				{
+					palette[i] = static_cast<int>(std::lround(((8 - i) * alpha0 + (i - 1) * alpha1) / 7.0f));
+				}
+			}
+			else
+			{
+				for (int i{ 2 }; i < 6; ++i)
+				{
+					palette[i] = static_cast<int>(std::lround(((6 - i) * alpha0 + (i - 1) * alpha1) / 5.0f));
+				}
+
+				palette[6] = minValue;
+				palette[7] = maxValue;
+			}
+		}
+
+		template<typename Value>
+		void EncodeAlphaBlock(const uint8_t* pTexels, int stride, uint8_t* pBlock)
+		{
+			int values[TexelCount]{};
+			int minValue{ INT_MAX };
+			int maxValue{ INT_MIN };
+
+			for (int i{}; i < TexelCount; ++i)
+			{
+				//-128 is not a valid snorm value, it decodes to -1 just like -127
+				values[i] = std::max(static_cast<int>(static_cast<Value>(pTexels[i * stride])), -127);
+				minValue = std::min(minValue, values[i]);
+				maxValue = std::max(maxValue, values[i]);
+			}
+
+			//alpha0 > alpha1 selects the 8 value mode, equal endpoints make every texel index 0
+			int palette[8]{};
+			BuildAlphaPalette<Value>(maxValue, minValue, palette);
+
+			uint64_t indices{};
+			if (maxValue != minValue)
+			{
+				for (int i{}; i < TexelCount; ++i)
+				{
+					int bestIndex{};
+					int bestDistance{ INT_MAX };
+
+					for (int index{}; index < 8; ++index)
+					{
+						const int distance{ std::abs(values[i] - palette[index]) };
+						if (distance < bestDistance)
+						{
+							bestDistance = distance;
+							bestIndex = index;
+						}
+					}
+
+					indices |= static_cast<uint64_t>(bestIndex) << (i * 3);
+				}
+			}
+
+			pBlock[0] = static_cast<uint8_t>(static_cast<Value>(maxValue));
+			pBlock[1] = static_cast<uint8_t>(static_cast<Value>(minValue));
+			for (int byte{}; byte < 6; ++byte)
+			{
+				pBlock[2 + byte] = static_cast<uint8_t>(indices >> (byte * 8));
+			}
+		}
+
+		template<typename Value>
+		void DecodeAlphaBlock(const uint8_t* pBlock, uint8_t* pTexels, int stride)
+		{
+			int palette[8]{};
+			BuildAlphaPalette<Value>(static_cast<Value>(pBlock[0]), static_cast<Value>(pBlock[1]), palette);
+
+			uint64_t indices{};
+			for (int byte{}; byte < 6; ++byte)
+			{
+				indices |= static_cast<uint64_t>(pBlock[2 + byte]) << (byte * 8);
+			}
+
+			for (int i{}; i < TexelCount; ++i)
+			{
+				pTexels[i * stride] = static_cast<uint8_t>(static_cast<Value>(palette[(indices >> (i * 3)) & 7]));
+			}
+		}
+	}
+
+	void BlockCompression::EncodeBC1(const uint8_t* pTexels, uint8_t* pBlock)
+	{
+		EncodeColorBlock(pTexels, pBlock);
+	}
+
+	void BlockCompression::DecodeBC1(const uint8_t* pBlock, uint8_t* pTexels)
+	{
+		DecodeColorBlock(pBlock, pTexels, true);
+	}
+
+	void BlockCompression::EncodeBC3(const uint8_t* pTexels, uint8_t* pBlock)
+	{
+		EncodeAlphaBlock<uint8_t>(pTexels + 3, 4, pBlock);
+		EncodeColorBlock(pTexels, pBlock + 8);
+	}
+
+	void BlockCompression::DecodeBC3(const uint8_t* pBlock, uint8_t* pTexels)
+	{
+		DecodeAlphaBlock<uint8_t>(pBlock, pTexels + 3, 4);
+		DecodeColorBlock(pBlock + 8, pTexels, false);
+	}
+
+	void BlockCompression::EncodeBC4(const uint8_t* pTexels, uint8_t* pBlock)
+	{
+		EncodeAlphaBlock<uint8_t>(pTexels, 1, pBlock);
+	}
+
+	void BlockCompression::DecodeBC4(const uint8_t* pBlock, uint8_t* pTexels)
+	{
+		DecodeAlphaBlock<uint8_t>(pBlock, pTexels, 1);
+	}
+
+	void BlockCompression::EncodeBC5(const uint8_t* pTexels, uint8_t* pBlock)
+	{
+		EncodeAlphaBlock<int8_t>(pTexels, 4, pBlock);
+		EncodeAlphaBlock<int8_t>(pTexels + 1, 4, pBlock + 8);
+	}
+
+	void BlockCompression::DecodeBC5(const uint8_t* pBlock, uint8_t* pTexels)
+	{
+		DecodeAlphaBlock<int8_t>(pBlock, pTexels, 4);
+		DecodeAlphaBlock<int8_t>(pBlock + 8, pTexels + 1, 4);
+
+		//Done once per decoded block, so the sampler reads a complete normal like it does from NormalSNorm8
+		for (int i{}; i < TexelCount; ++i)
+		{
+			const float x{ static_cast<int8_t>(pTexels[i * 4]) / 127.0f };
+			const float y{ static_cast<int8_t>(pTexels[i * 4 + 1]) / 127.0f };
+			const float z{ std::sqrt(std::max(0.0f, 1.0f - x * x - y * y)) };
+
+			pTexels[i * 4 + 2] = static_cast<uint8_t>(static_cast<int8_t>(std::lround(z * 127.0f)));
+			pTexels[i * 4 + 3] = 0;
+		}
+	}
+}
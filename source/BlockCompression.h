@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdint>
+
+namespace dae
+{
+	//BCn block encoders and decoders, laid out exactly like the D3D11 formats so blocks upload unchanged
+	//Every block covers 4x4 texels, the texel arrays hold those 16 texels row by row
+	namespace BlockCompression
+	{
+		//16 RGBA8 texels <-> 8 bytes, alpha is dropped (DXGI_FORMAT_BC1_UNORM)
+		void EncodeBC1(const uint8_t* pTexels, uint8_t* pBlock);
+		void DecodeBC1(const uint8_t* pBlock, uint8_t* pTexels);
+
+		//16 RGBA8 texels <-> 16 bytes, interpolated alpha (DXGI_FORMAT_BC3_UNORM)
+		void EncodeBC3(const uint8_t* pTexels, uint8_t* pBlock);
+		void DecodeBC3(const uint8_t* pBlock, uint8_t* pTexels);
+
+		//16 R8 texels <-> 8 bytes (DXGI_FORMAT_BC4_UNORM)
+		void EncodeBC4(const uint8_t* pTexels, uint8_t* pBlock);
+		void DecodeBC4(const uint8_t* pBlock, uint8_t* pTexels);
+
+		//16 signed x, y, z, 0 normals <-> 16 bytes, only x and y are stored (DXGI_FORMAT_BC5_SNORM)
+		//Decoding rebuilds z from the unit length, so decoded texels match the NormalSNorm8 format
+		void EncodeBC5(const uint8_t* pTexels, uint8_t* pBlock);
+		void DecodeBC5(const uint8_t* pBlock, uint8_t* pTexels);
+	}
+}
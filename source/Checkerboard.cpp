@@ -0,0 +1,143 @@
+#include "pch.h"
+#include "Checkerboard.h"
+#include "JobSystem.h"
+
+namespace dae
+{
+	Checkerboard::Checkerboard(int width, int height)
+		: m_Width{ width }
+		, m_Height{ height }
+	{
+	}
+
+	void Checkerboard::Resize(int width, int height)
+	{
+		m_Width = width;
+		m_Height = height;
+		m_HasHistory = false;
+	}
+
+	void Checkerboard::BeginFrame(bool isEnabled)
+	{
+		m_IsEnabled = isEnabled;
+		if (!m_IsEnabled)
+		{
+			m_HasHistory = false;
+			return;
+		}
+
+		m_Parity ^= 1;
+
+		//Allocated on first use, a checkerboard that is never turned on costs nothing
+		m_MotionVectors.resize(static_cast<size_t>(m_Width) * m_Height);
+	}
+
+	bool Checkerboard::IsEnabled() const
+	{
+		return m_IsEnabled;
+	}
+
+	int Checkerboard::GetFirstRendered(int px, int py) const
+	{
+		return px + ((px + py + m_Parity) & 1);
+	}
+
+	void Checkerboard::StoreMotion(int px, int py, const Vector4& previousPosition)
+	{
+		Vector2& motion{ m_MotionVectors[px + py * m_Width] };
+		motion = Vector2{};
+
+		if (previousPosition.w > 0.0f)
+		{
+			//Same raster mapping as the rasterizer
+			const float previousX{ (previousPosition.x / previousPosition.w + 1.0f) * 0.5f * m_Width };
+			const float previousY{ (1.0f - previousPosition.y / previousPosition.w) * 0.5f * m_Height };
+			motion = Vector2{ px - previousX, py - previousY };
+		}
+	}
+
+	void Checkerboard::Resolve(HdrPixel* pColour, float* pDepth, int left, int top, int right, int bottom)
+	{
+		JobSystem::GetInstance().ParallelFor(bottom - top, 8, [&](int begin, int end)
+			{
+				for (int py{ top + begin }; py < top + end; ++py)
+				{
+					//Only the skipped pixels are written and only rendered ones are read, rows never race
+					for (int px{ left + ((left + py + m_Parity + 1) & 1) }; px < right; px += 2)
+					{
+						const int index{ px + py * m_Width };
+
+						//The four neighbours were all rendered this frame
+						ColorRGB minimum{ FLT_MAX, FLT_MAX, FLT_MAX };
+						ColorRGB maximum{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+						ColorRGB sum{};
+						int neighbourCount{};
+						int closest{ -1 };
+						float closestDepth{ FLT_MAX };
+
+						const int neighbours[]{ px > 0 ? index - 1 : -1, px + 1 < m_Width ? index + 1 : -1,
+							py > 0 ? index - m_Width : -1, py + 1 < m_Height ? index + m_Width : -1 };
+						for (const int neighbour : neighbours)
+						{
+							if (neighbour < 0)
+							{
+								continue;
+							}
+
+							const ColorRGB value{ ToColorRGB(pColour[neighbour]) };
+							minimum = ColorRGB{ std::min(minimum.r, value.r), std::min(minimum.g, value.g), std::min(minimum.b, value.b) };
+							maximum = ColorRGB{ std::max(maximum.r, value.r), std::max(maximum.g, value.g), std::max(maximum.b, value.b) };
+							sum += value;
+							++neighbourCount;
+
+							if (pDepth[neighbour] < closestDepth)
+							{
+								closestDepth = pDepth[neighbour];
+								closest = neighbour;
+							}
+						}
+
+						//No surface around it, the clear colour is already there
+						if (closest < 0)
+						{
+							continue;
+						}
+
+						pDepth[index] = closestDepth;
+
+						//Where the closest surface was in the last frame, bilinear
+						ColorRGB colour{ sum / static_cast<float>(neighbourCount) };
+						const Vector2& motion{ m_MotionVectors[closest] };
+						const float historyX{ px - motion.x };
+						const float historyY{ py - motion.y };
+						if (m_HasHistory && std::abs(motion.x) < StaticMotion && std::abs(motion.y) < StaticMotion)
+						{
+							//The last frame rendered this very pixel, taken as is so still views converge to the full rate image
+							pColour[index] = m_History[index];
+							continue;
+						}
+
+						if (m_HasHistory && historyX >= 0.0f && historyX <= m_Width - 1.0f && historyY >= 0.0f && historyY <= m_Height - 1.0f)
+						{
+							const int x0{ std::min(static_cast<int>(historyX), m_Width - 2) };
+							const int y0{ std::min(static_cast<int>(historyY), m_Height - 2) };
+							const float fractionX{ historyX - x0 };
+							const float fractionY{ historyY - y0 };
+							const HdrPixel* pHistory{ m_History.data() + x0 + y0 * m_Width };
+
+							const ColorRGB topValue{ ColorRGB::Lerp(ToColorRGB(pHistory[0]), ToColorRGB(pHistory[1]), fractionX) };
+							const ColorRGB bottomValue{ ColorRGB::Lerp(ToColorRGB(pHistory[m_Width]), ToColorRGB(pHistory[m_Width + 1]), fractionX) };
+							const ColorRGB history{ ColorRGB::Lerp(topValue, bottomValue, fractionY) };
+							//Neighbour clamping: history that disagrees with every neighbour is from another surface or stale lighting
+							colour = ColorRGB{ std::clamp(history.r, minimum.r, maximum.r), std::clamp(history.g, minimum.g, maximum.g), std::clamp(history.b, minimum.b, maximum.b) };
+						}
+
+						pColour[index] = ToHdrPixel(colour);
+					}
+				}
+			});
+
+		m_History.assign(pColour, pColour + static_cast<size_t>(m_Width) * m_Height);
+		m_HasHistory = true;
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <vector>
+#include "Math.h"
+#include "HdrPixel.h"
+
+namespace dae
+{
+	//Checkerboard rendering for the software rasterizer: a frame rasterizes and shades the pixels of one colour of a
+	//checkerboard, the next frame the other colour, and the pixels a frame skipped are reconstructed from the last frame
+	class Checkerboard final
+	{
+	public:
+		//Motion (pixels) below which a pixel's history is the exact colour the last frame rendered there
+		static constexpr float StaticMotion{ 1.0f / 64.0f };
+
+		Checkerboard(int width, int height);
+
+		Checkerboard(const Checkerboard&) = delete;
+		Checkerboard(Checkerboard&&) noexcept = delete;
+		Checkerboard& operator=(const Checkerboard&) = delete;
+		Checkerboard& operator=(Checkerboard&&) noexcept = delete;
+
+		//For another render resolution, drops the history
+		void Resize(int width, int height);
+
+		//Switches to the other half of the pixels, turning it off drops the history
+		void BeginFrame(bool isEnabled);
+		bool IsEnabled() const;
+
+		//The first pixel at or right of px in row py that this frame renders, every second pixel after it is rendered as well
+		int GetFirstRendered(int px, int py) const;
+
+		//previousPosition is a rendered fragment's clip space position in the last frame
+		void StoreMotion(int px, int py, const Vector4& previousPosition);
+
+		//Fills the pixels of the rectangle this frame skipped: the last frame's colour where its closest rendered neighbour
+		//was, clamped to the range of the four rendered neighbours unless nothing moved; their depth is the closest neighbour's
+		//Keeps the whole finished frame as the next one's history
+		void Resolve(HdrPixel* pColour, float* pDepth, int left, int top, int right, int bottom);
+
+	private:
+		int m_Width{};
+		int m_Height{};
+
+		bool m_IsEnabled{};
+		int m_Parity{};
+		bool m_HasHistory{};
+
+		std::vector<HdrPixel> m_History{};
+		//Pixels (current minus last frame position), only valid for the pixels rendered this frame
+		std::vector<Vector2> m_MotionVectors{};
+	};
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include "Math.h"
+#include "HdrPixel.h"
 #include "array"
 #include <string>
 //#include "Texture.h"
@@ -22,6 +23,13 @@ namespace dae
 		Vector3 normal{};
 		Vector3 tangent{};
 		Vector3 viewDirection{};
+		//Only filled in when local lights or shadows need it
+		Vector3 worldPosition{};
+		//Light and view direction in the vertex's tangent frame, only filled in with tangent space lighting
+		Vector3 tangentLightDirection{};
+		Vector3 tangentViewDirection{};
+		//Clip space position in the last frame, only filled in with temporal reuse or checkerboard rendering
+		Vector4 previousPosition{};
 		ColorRGB color{ colors::White };
 	};
 
@@ -39,9 +47,37 @@ namespace dae
 		Specular
 	};
 
+	//How the software rasterizer shades a mesh, picked from its size on screen
+	enum class ShadingLod
+	{
+		Full,			//Per pixel, normal mapped
+		NoNormalMap,	//Per pixel, with the interpolated vertex normal
+		Gouraud			//Lit per vertex, only the colour is interpolated
+	};
+
+	enum class LightType
+	{
+		Point,
+		Spot
+	};
+
+	//Local light for the software rasterizer's tiled shading, in world space
+	struct Light
+	{
+		LightType type{ LightType::Point };
+		Vector3 position{};
+		Vector3 direction{ 0.0f, -1.0f, 0.0f };	//Spot only, where the cone points
+		ColorRGB color{ colors::White };
+		float intensity{ 1.0f };
+		float range{ 10.0f };			//Adds nothing past this distance, also the culling bound
+		float innerConeCos{ 0.9f };		//Spot only, full intensity inside
+		float outerConeCos{ 0.8f };		//Spot only, nothing outside
+	};
+
 	enum class SampleMode
 	{
 		Point,
+		Bilinear,
 		Linear,
 		Anisotropic
 	};
@@ -52,4 +88,164 @@ namespace dae
 		FrontFace,
 		DoubleFace
 	};
+
+	//In-memory format a texture gets converted to on load, picked by what the shader reads from it
+	enum class TextureFormat
+	{
+		RGBA8,		//Colour maps, R, G, B, A bytes
+		NormalSNorm8,	//Normal maps, already expanded to signed x, y, z bytes in [-127, 127]
+		R8,			//Single channel maps (gloss, specular)
+		PackedMaterial,	//Diffuse RGBA8, normal.xy snorm, gloss, specular in one 8 byte texel
+
+		//Block compressed, 4x4 texels per block, stored and uploaded exactly like the DXGI formats
+		BC1,		//Colour maps without alpha, 0.5 byte per texel
+		BC3,		//Colour maps with alpha, 1 byte per texel
+		BC4,		//Single channel maps, 0.5 byte per texel
+		BC5			//Normal maps, signed x and y, 1 byte per texel
+	};
+
+	//How the texels of every mip level are ordered in memory
+	enum class TextureLayout
+	{
+		Linear,		//Row-major, like the SDL surface
+		Tiled4x4	//4x4 texel blocks stored contiguously, rows of blocks row-major (block compressed formats always use this)
+	};
+
+	enum class TextureFilter
+	{
+		Point,
+		Bilinear,
+		Trilinear
+	};
+
+	enum class TextureAddressMode
+	{
+		Wrap,
+		Clamp
+	};
+
+	//Everything ShadePixel reads from a material, fetched with a single SampleMaterial call
+	struct MaterialSample
+	{
+		ColorRGB diffuse{};
+		Vector3 normal{ 0.0f, 0.0f, 1.0f }; //Tangent space
+		float gloss{};
+		float specular{};
+	};
+
+	//SoA counterpart of MaterialSample for the batched fetches, every array holds one float per sample
+	struct MaterialSampleBatch
+	{
+		float* pDiffuseR{};
+		float* pDiffuseG{};
+		float* pDiffuseB{};
+		float* pNormalX{};
+		float* pNormalY{};
+		float* pNormalZ{};
+		float* pGloss{};
+		float* pSpecular{};
+	};
+
+	//Covered pixels waiting to be shaded together, SoA so the batched shader loads one attribute of every lane at once
+	//One batch is 16 int16 lanes for the fixed point path, or two halves of 8 float lanes
+	struct FragmentBatch
+	{
+		static constexpr int Size{ 16 };
+		static constexpr int FloatLanes{ 8 };
+
+		alignas(32) float u[Size]{};
+		alignas(32) float v[Size]{};
+		alignas(32) float uvLod[Size]{};
+		alignas(32) float normalX[Size]{};
+		alignas(32) float normalY[Size]{};
+		alignas(32) float normalZ[Size]{};
+		alignas(32) float tangentX[Size]{};
+		alignas(32) float tangentY[Size]{};
+		alignas(32) float tangentZ[Size]{};
+		alignas(32) float viewX[Size]{};
+		alignas(32) float viewY[Size]{};
+		alignas(32) float viewZ[Size]{};
+		alignas(32) float worldX[Size]{};
+		alignas(32) float worldY[Size]{};
+		alignas(32) float worldZ[Size]{};
+		alignas(32) float tangentLightX[Size]{};
+		alignas(32) float tangentLightY[Size]{};
+		alignas(32) float tangentLightZ[Size]{};
+		alignas(32) float tangentViewX[Size]{};
+		alignas(32) float tangentViewY[Size]{};
+		alignas(32) float tangentViewZ[Size]{};
+
+		//Where every lane ends up in the back buffer, and in which of its samples with multisampling
+		int pixelIndices[Size]{};
+		int sampleMasks[Size]{};
+		int count{};
+		//When set, the shaded colours are kept here as well, per lane, for fragments whose colour is needed again
+		HdrPixel* pShadedPixels{};
+
+		void Push(int pixelIndex, const Vertex_Out& vertexOut, float lod, int sampleMask)
+		{
+			u[count] = vertexOut.uv.x;
+			v[count] = vertexOut.uv.y;
+			uvLod[count] = lod;
+			normalX[count] = vertexOut.normal.x;
+			normalY[count] = vertexOut.normal.y;
+			normalZ[count] = vertexOut.normal.z;
+			tangentX[count] = vertexOut.tangent.x;
+			tangentY[count] = vertexOut.tangent.y;
+			tangentZ[count] = vertexOut.tangent.z;
+			viewX[count] = vertexOut.viewDirection.x;
+			viewY[count] = vertexOut.viewDirection.y;
+			viewZ[count] = vertexOut.viewDirection.z;
+			worldX[count] = vertexOut.worldPosition.x;
+			worldY[count] = vertexOut.worldPosition.y;
+			worldZ[count] = vertexOut.worldPosition.z;
+			tangentLightX[count] = vertexOut.tangentLightDirection.x;
+			tangentLightY[count] = vertexOut.tangentLightDirection.y;
+			tangentLightZ[count] = vertexOut.tangentLightDirection.z;
+			tangentViewX[count] = vertexOut.tangentViewDirection.x;
+			tangentViewY[count] = vertexOut.tangentViewDirection.y;
+			tangentViewZ[count] = vertexOut.tangentViewDirection.z;
+			pixelIndices[count] = pixelIndex;
+			sampleMasks[count] = sampleMask;
+			++count;
+		}
+
+		bool IsFull() const
+		{
+			return count == Size;
+		}
+
+		//Copies lane 0 into the unused lanes so a partial batch only shades valid inputs
+		void FillUnusedLanes()
+		{
+			for (float* pAttribute : { u, v, uvLod, normalX, normalY, normalZ, tangentX, tangentY, tangentZ, viewX, viewY, viewZ, worldX, worldY, worldZ,
+				tangentLightX, tangentLightY, tangentLightZ, tangentViewX, tangentViewY, tangentViewZ })
+			{
+				std::fill(pAttribute + count, pAttribute + Size, pAttribute[0]);
+			}
+		}
+	};
+
+	//Software counterpart of the D3D11 sampler states the effects use
+	struct SamplerState
+	{
+		TextureFilter filter{ TextureFilter::Point };
+		TextureAddressMode addressMode{ TextureAddressMode::Wrap };
+
+		static SamplerState FromSampleMode(SampleMode sampleMode, TextureAddressMode addressMode)
+		{
+			//There is no anisotropic filter on the cpu, trilinear is the closest match
+			switch (sampleMode)
+			{
+			case SampleMode::Bilinear:
+				return { TextureFilter::Bilinear, addressMode };
+			case SampleMode::Linear:
+			case SampleMode::Anisotropic:
+				return { TextureFilter::Trilinear, addressMode };
+			case SampleMode::Point:
+			default:
+				return { TextureFilter::Point, addressMode };
+			}
+		}
+	};
 }
\ No newline at end of file
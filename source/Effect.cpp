@@ -1,6 +1,7 @@
 #include "pch.h"
 #include "Effect.h"
 #include "Texture.h"
+#include "Material.h"
 
 namespace dae
 {
@@ -66,6 +67,7 @@ namespace dae
 		m_pInputLayout->Release();
 
 		m_pPointSampler->Release();
+		m_pBilinearSampler->Release();
 		m_pLinearSampler->Release();
 		m_pAnisothropicSampler->Release();
 
@@ -145,7 +147,7 @@ namespace dae
 		return m_pMatWorldViewProjVariable;
 	}
 
-	void Effect::SetDiffuseMap(Texture* pTexture)
+	void Effect::SetDiffuseMap(const Texture* pTexture)
 	{
 		if (m_pDiffuseMapVariable)
 		{
@@ -153,7 +155,7 @@ namespace dae
 		}
 	}
 
-	void Effect::SetNormalMap(Texture* pTexture)
+	void Effect::SetNormalMap(const Texture* pTexture)
 	{
 		if (m_pNormalMapVariable)
 		{
@@ -161,7 +163,7 @@ namespace dae
 		}
 	}
 
-	void Effect::SetSpecularMap(Texture* pTexture)
+	void Effect::SetSpecularMap(const Texture* pTexture)
 	{
 		if (m_pSpecularMapVariable)
 		{
@@ -169,7 +171,7 @@ namespace dae
 		}
 	}
 
-	void Effect::SetGlossyMap(Texture* pTexture)
+	void Effect::SetGlossyMap(const Texture* pTexture)
 	{
 		if (m_pGlossyMapVariable)
 		{
@@ -177,6 +179,40 @@ namespace dae
 		}
 	}
 
+	void Effect::SetMaterial(const MaterialBinding& material)
+	{
+		if (material.pDiffuseMap)
+		{
+			SetDiffuseMap(material.pDiffuseMap);
+		}
+		if (material.pNormalMap)
+		{
+			SetNormalMap(material.pNormalMap);
+		}
+		if (material.pSpecularMap)
+		{
+			SetSpecularMap(material.pSpecularMap);
+		}
+		if (material.pGlossyMap)
+		{
+			SetGlossyMap(material.pGlossyMap);
+		}
+
+		if (m_pLightIntensityVariable)
+		{
+			m_pLightIntensityVariable->SetFloat(material.lightIntensity);
+		}
+		if (m_pShininessVariable)
+		{
+			m_pShininessVariable->SetFloat(material.shininess);
+		}
+		if (m_pAmbientVariable)
+		{
+			const float ambient[4]{ material.ambient.r, material.ambient.g, material.ambient.b, 0.f };
+			m_pAmbientVariable->SetFloatVector(ambient);
+		}
+	}
+
 	void Effect::SetLightDirection(Vector3& lightDirection)
 	{
 		if (m_pLightDirVariable)
@@ -208,6 +244,9 @@ namespace dae
 		case dae::SampleMode::Point:
 			m_pSamplerState->SetSampler(0, m_pPointSampler);
 			break;
+		case dae::SampleMode::Bilinear:
+			m_pSamplerState->SetSampler(0, m_pBilinearSampler);
+			break;
 		case dae::SampleMode::Linear:
 			m_pSamplerState->SetSampler(0, m_pLinearSampler);
 			break;
@@ -281,6 +320,24 @@ namespace dae
 			std::wcout << L"m_pLightDirVariable is not valid\n";
 		}
 
+		m_pLightIntensityVariable = m_pEffect->GetVariableByName("gLightIntensity")->AsScalar();
+		if (!m_pLightIntensityVariable->IsValid())
+		{
+			std::wcout << L"m_pLightIntensityVariable is not valid\n";
+		}
+
+		m_pShininessVariable = m_pEffect->GetVariableByName("gShininess")->AsScalar();
+		if (!m_pShininessVariable->IsValid())
+		{
+			std::wcout << L"m_pShininessVariable is not valid\n";
+		}
+
+		m_pAmbientVariable = m_pEffect->GetVariableByName("gAmbient")->AsVector();
+		if (!m_pAmbientVariable->IsValid())
+		{
+			std::wcout << L"m_pAmbientVariable is not valid\n";
+		}
+
 		m_pViewInverseVariable = m_pEffect->GetVariableByName("gViewInverse")->AsMatrix();
 		if (!m_pViewInverseVariable->IsValid())
 		{
@@ -324,6 +381,13 @@ namespace dae
 			return;
 		}
 
+		samplerDesc.Filter = D3D11_FILTER_MIN_MAG_LINEAR_MIP_POINT;
+		hr = pDevice->CreateSamplerState(&samplerDesc, &m_pBilinearSampler);
+		if (FAILED(hr))
+		{
+			return;
+		}
+
 		samplerDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
 		hr = pDevice->CreateSamplerState(&samplerDesc, &m_pLinearSampler);
 		if (FAILED(hr))
@@ -4,6 +4,7 @@
 namespace dae
 {
 	class Texture;
+	struct MaterialBinding;
 
 	class Effect
 	{
@@ -18,10 +19,12 @@ namespace dae
 		ID3D11InputLayout* GetInputLayout() const;
 		ID3DX11EffectMatrixVariable* GetWorldViewProjectionMatrix() const;
 
-		void SetDiffuseMap(Texture* pTexture);
-		void SetNormalMap(Texture* pTexture);
-		void SetSpecularMap(Texture* pTexture);
-		void SetGlossyMap(Texture* pTexture);
+		void SetDiffuseMap(const Texture* pTexture);
+		void SetNormalMap(const Texture* pTexture);
+		void SetSpecularMap(const Texture* pTexture);
+		void SetGlossyMap(const Texture* pTexture);
+		//Binds the filled texture slots and the shading constants
+		void SetMaterial(const MaterialBinding& material);
 
 		void SetLightDirection(Vector3& lightDirection);
 		void SetWorldMatrix(Matrix& worldMatrix);
@@ -48,6 +51,9 @@ namespace dae
 		ID3DX11EffectShaderResourceVariable* m_pGlossyMapVariable{};
 
 		ID3DX11EffectVectorVariable* m_pLightDirVariable{};
+		ID3DX11EffectScalarVariable* m_pLightIntensityVariable{};
+		ID3DX11EffectScalarVariable* m_pShininessVariable{};
+		ID3DX11EffectVectorVariable* m_pAmbientVariable{};
 
 		ID3DX11EffectMatrixVariable* m_pWorldVariable{};
 		ID3DX11EffectMatrixVariable* m_pViewInverseVariable{};
@@ -56,6 +62,7 @@ namespace dae
 		ID3DX11EffectRasterizerVariable* m_pRasterizerState{};
 
 		ID3D11SamplerState* m_pPointSampler{};
+		ID3D11SamplerState* m_pBilinearSampler{};
 		ID3D11SamplerState* m_pLinearSampler{};
 		ID3D11SamplerState* m_pAnisothropicSampler{};
 
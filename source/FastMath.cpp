@@ -0,0 +1,184 @@
+#include "pch.h"
+#include "FastMath.h"
+#include <chrono>
+#include <iomanip>
+#include <random>
+
+namespace dae
+{
+	namespace
+	{
+		constexpr int SampleCount{ 1 << 16 };
+
+		//Timed results end up here, so the timed calls can not be optimized away
+		volatile float g_Sink{};
+
+		struct Inputs
+		{
+			std::vector<float> x{};
+			std::vector<float> y{};
+		};
+
+		struct Row
+		{
+			float scalarError{};
+			float simdError{};
+			float scalarNanoseconds{};
+			float simdNanoseconds{};
+		};
+
+		//Relative error for values that span many orders of magnitude, absolute error for the ones the shading writes out
+		float Error(double reference, float value, bool isRelative)
+		{
+			const double difference{ std::abs(reference - static_cast<double>(value)) };
+			return static_cast<float>(isRelative ? difference / std::max(std::abs(reference), 1e-30) : difference);
+		}
+
+		//Best of a few runs over all inputs
+		//Width is the number of values one call produces, the time is per value
+		template<int Width, typename Function>
+		float MeasureNanoseconds(const Inputs& inputs, const Function& function)
+		{
+			std::vector<float> results(SampleCount);
+			float bestNanoseconds{ FLT_MAX };
+
+			for (int run{}; run < 5; ++run)
+			{
+				const auto start{ std::chrono::high_resolution_clock::now() };
+				for (int i{}; i < SampleCount; i += Width)
+				{
+					if constexpr (Width == 4)
+					{
+						_mm_storeu_ps(&results[i], function(_mm_loadu_ps(&inputs.x[i]), _mm_loadu_ps(&inputs.y[i])));
+					}
+					else
+					{
+						results[i] = function(inputs.x[i], inputs.y[i]);
+					}
+				}
+				const auto end{ std::chrono::high_resolution_clock::now() };
+
+				g_Sink = results[run];
+				bestNanoseconds = std::min(bestNanoseconds, std::chrono::duration<float, std::nano>(end - start).count() / SampleCount);
+			}
+
+			return bestNanoseconds;
+		}
+
+		//Runs the scalar and the 4 lane version of one function over the inputs and compares both against the double precision reference
+		template<typename Reference, typename Scalar, typename Simd>
+		Row Measure(const Inputs& inputs, bool isRelative, const Reference& reference, const Scalar& scalar, const Simd& simd)
+		{
+			Row row{};
+
+			for (int i{}; i < SampleCount; i += 4)
+			{
+				alignas(16) float simdResults[4]{};
+				_mm_store_ps(simdResults, simd(_mm_loadu_ps(&inputs.x[i]), _mm_loadu_ps(&inputs.y[i])));
+
+				for (int lane{}; lane < 4; ++lane)
+				{
+					const double expected{ reference(static_cast<double>(inputs.x[i + lane]), static_cast<double>(inputs.y[i + lane])) };
+					row.scalarError = std::max(row.scalarError, Error(expected, scalar(inputs.x[i + lane], inputs.y[i + lane]), isRelative));
+					row.simdError = std::max(row.simdError, Error(expected, simdResults[lane], isRelative));
+				}
+			}
+
+			row.scalarNanoseconds = MeasureNanoseconds<1>(inputs, scalar);
+			row.simdNanoseconds = MeasureNanoseconds<4>(inputs, simd);
+			return row;
+		}
+
+		Inputs MakeInputs(std::mt19937& random, float minX, float maxX, float minY, float maxY, bool isLogarithmic)
+		{
+			std::uniform_real_distribution<float> xDistribution{ isLogarithmic ? std::log2(minX) : minX, isLogarithmic ? std::log2(maxX) : maxX };
+			std::uniform_real_distribution<float> yDistribution{ minY, maxY };
+
+			Inputs inputs{ std::vector<float>(SampleCount), std::vector<float>(SampleCount) };
+			for (int i{}; i < SampleCount; ++i)
+			{
+				inputs.x[i] = isLogarithmic ? std::exp2(xDistribution(random)) : xDistribution(random);
+				inputs.y[i] = yDistribution(random);
+			}
+
+			return inputs;
+		}
+
+		template<MathAccuracy Accuracy>
+		void ReportTier(const char* name)
+		{
+			std::mt19937 random{ 7 };
+
+			//Ranges the shading actually uses: cosines in [0, 1] raised to gloss * shininess, and interpolated direction lengths
+			const Inputs logInputs{ MakeInputs(random, 1e-4f, 1e4f, 0.f, 0.f, true) };
+			const Inputs expInputs{ MakeInputs(random, -20.f, 20.f, 0.f, 0.f, false) };
+			const Inputs powInputs{ MakeInputs(random, 0.f, 1.f, 0.f, 25.f, false) };
+			const Inputs rsqrtInputs{ MakeInputs(random, 1e-4f, 1e4f, 0.f, 0.f, true) };
+			const Inputs normalizeInputs{ MakeInputs(random, -1.f, 1.f, -1.f, 1.f, false) };
+
+			const Row log2Row{ Measure(logInputs, false,
+				[](double x, double) { return std::log2(x); },
+				[](float x, float) { return FastMath::Log2<Accuracy>(x); },
+				[](__m128 x, __m128) { return FastMath::Log2<Accuracy>(x); }) };
+
+			const Row exp2Row{ Measure(expInputs, true,
+				[](double x, double) { return std::exp2(x); },
+				[](float x, float) { return FastMath::Exp2<Accuracy>(x); },
+				[](__m128 x, __m128) { return FastMath::Exp2<Accuracy>(x); }) };
+
+			const Row powRow{ Measure(powInputs, false,
+				[](double x, double y) { return std::pow(x, y); },
+				[](float x, float y) { return FastMath::Pow<Accuracy>(x, y); },
+				[](__m128 x, __m128 y) { return FastMath::Pow<Accuracy>(x, y); }) };
+
+			const Row rsqrtRow{ Measure(rsqrtInputs, true,
+				[](double x, double) { return 1.0 / std::sqrt(x); },
+				[](float x, float) { return FastMath::Rsqrt<Accuracy>(x); },
+				[](__m128 x, __m128) { return FastMath::Rsqrt<Accuracy>(x); }) };
+
+			//Vectors are (x, y, 0.5), the error is how far the result is from unit length
+			const Row normalizeRow{ Measure(normalizeInputs, false,
+				[](double, double) { return 1.0; },
+				[](float x, float y) { return FastMath::Normalized<Accuracy>(Vector3{ x, y, 0.5f }).Magnitude(); },
+				[](__m128 x, __m128 y)
+				{
+					__m128 z{ _mm_set1_ps(0.5f) };
+					FastMath::Normalize<Accuracy>(x, y, z);
+					return _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+				}) };
+
+			const auto print{ [&](const char* function, const char* errorKind, const Row& row)
+				{
+					std::cout << '\t' << std::setw(10) << name << std::setw(12) << function << std::setw(10) << errorKind
+						<< std::setw(14) << std::scientific << std::setprecision(2) << row.scalarError
+						<< std::setw(14) << row.simdError
+						<< std::setw(12) << std::fixed << std::setprecision(2) << row.scalarNanoseconds
+						<< std::setw(12) << row.simdNanoseconds << '\n';
+				} };
+
+			print("log2", "abs", log2Row);
+			print("exp2", "rel", exp2Row);
+			print("pow", "abs", powRow);
+			print("rsqrt", "rel", rsqrtRow);
+			print("normalize", "length", normalizeRow);
+			std::cout << '\n';
+		}
+	}
+
+	void FastMath::Report()
+	{
+		std::cout << "\033[36m";
+		std::cout << "[Fast Math Report] Maximum error against double precision std functions and time per value, " << SampleCount << " samples per function\n";
+		std::cout << "\tpow: x in [0, 1], y in [0, 25]    log2, rsqrt: [1e-4, 1e4]    exp2: [-20, 20]    normalize: (x, y, 0.5) with x, y in [-1, 1]\n\n";
+		std::cout << std::left << '\t' << std::setw(10) << "Tier" << std::setw(12) << "Function" << std::setw(10) << "Error"
+			<< std::setw(14) << "Scalar" << std::setw(14) << "SIMD (x4)" << std::setw(12) << "Scalar ns" << std::setw(12) << "SIMD ns" << '\n';
+
+		ReportTier<MathAccuracy::Exact>("Exact");
+		ReportTier<MathAccuracy::Fast>("Fast");
+		ReportTier<MathAccuracy::Fastest>("Fastest");
+
+		std::cout << std::right << std::defaultfloat;
+		std::cout << "\033[0m";
+		std::cout << '\n';
+	}
+}
@@ -0,0 +1,467 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <immintrin.h>
+#include "Vector3.h"
+
+namespace dae
+{
+	//How much precision the shading math gives up for speed, picked with --math-accuracy=exact|fast|fastest
+	//Run with --fastmath-report to print the measured error and cost of every tier
+	enum class MathAccuracy
+	{
+		Exact,		//std functions
+		Fast,		//Polynomial log2/exp2 and rsqrt with a Newton step, far below one 8 bit colour step
+		Fastest		//Lower degree polynomials and the raw rsqrt estimate, pow is off by up to about 1% at shininess 25
+	};
+
+	namespace FastMath
+	{
+		namespace Detail
+		{
+			//log2(1 + t) = t * P(t) and 2^f = 1 + f * Q(f) on [0, 1), coefficients fitted for the smallest maximum error
+			template<MathAccuracy Accuracy>
+			inline float Log2Polynomial(float t)
+			{
+				if constexpr (Accuracy == MathAccuracy::Fast)
+				{
+					return t * (1.44268477f + t * (-0.720519722f + t * (0.469920099f + t * (-0.305120409f + t * (0.148410991f + t * -0.0353859663f)))));
+				}
+				else
+				{
+					return t * (1.44221663f + t * (-0.703321815f + t * (0.370656371f + t * -0.110029437f)));
+				}
+			}
+
+			template<MathAccuracy Accuracy>
+			inline float Exp2Polynomial(float f)
+			{
+				if constexpr (Accuracy == MathAccuracy::Fast)
+				{
+					return 1.0f + f * (0.6931476f + f * (0.240206555f + f * (0.0556602851f + f * (0.00919421017f + f * 0.00179096044f))));
+				}
+				else
+				{
+					return 1.0f + f * (0.693546891f + f * (0.233355746f + f * 0.0726975873f));
+				}
+			}
+
+			template<MathAccuracy Accuracy>
+			inline __m128 Log2Polynomial(__m128 t)
+			{
+				const auto term{ [&](__m128 sum, float coefficient) { return _mm_add_ps(_mm_set1_ps(coefficient), _mm_mul_ps(t, sum)); } };
+
+				if constexpr (Accuracy == MathAccuracy::Fast)
+				{
+					__m128 sum{ _mm_set1_ps(-0.0353859663f) };
+					sum = term(sum, 0.148410991f);
+					sum = term(sum, -0.305120409f);
+					sum = term(sum, 0.469920099f);
+					sum = term(sum, -0.720519722f);
+					sum = term(sum, 1.44268477f);
+					return _mm_mul_ps(t, sum);
+				}
+				else
+				{
+					__m128 sum{ _mm_set1_ps(-0.110029437f) };
+					sum = term(sum, 0.370656371f);
+					sum = term(sum, -0.703321815f);
+					sum = term(sum, 1.44221663f);
+					return _mm_mul_ps(t, sum);
+				}
+			}
+
+			template<MathAccuracy Accuracy>
+			inline __m128 Exp2Polynomial(__m128 f)
+			{
+				const auto term{ [&](__m128 sum, float coefficient) { return _mm_add_ps(_mm_set1_ps(coefficient), _mm_mul_ps(f, sum)); } };
+
+				if constexpr (Accuracy == MathAccuracy::Fast)
+				{
+					__m128 sum{ _mm_set1_ps(0.00179096044f) };
+					sum = term(sum, 0.00919421017f);
+					sum = term(sum, 0.0556602851f);
+					sum = term(sum, 0.240206555f);
+					sum = term(sum, 0.6931476f);
+					return term(sum, 1.0f);
+				}
+				else
+				{
+					__m128 sum{ _mm_set1_ps(0.0726975873f) };
+					sum = term(sum, 0.233355746f);
+					sum = term(sum, 0.693546891f);
+					return term(sum, 1.0f);
+				}
+			}
+
+			template<MathAccuracy Accuracy>
+			inline __m256 Log2Polynomial(__m256 t)
+			{
+				const auto term{ [&](__m256 sum, float coefficient) { return _mm256_add_ps(_mm256_set1_ps(coefficient), _mm256_mul_ps(t, sum)); } };
+
+				if constexpr (Accuracy == MathAccuracy::Fast)
+				{
+					__m256 sum{ _mm256_set1_ps(-0.0353859663f) };
+					sum = term(sum, 0.148410991f);
+					sum = term(sum, -0.305120409f);
+					sum = term(sum, 0.469920099f);
+					sum = term(sum, -0.720519722f);
+					sum = term(sum, 1.44268477f);
+					return _mm256_mul_ps(t, sum);
+				}
+				else
+				{
+					__m256 sum{ _mm256_set1_ps(-0.110029437f) };
+					sum = term(sum, 0.370656371f);
+					sum = term(sum, -0.703321815f);
+					sum = term(sum, 1.44221663f);
+					return _mm256_mul_ps(t, sum);
+				}
+			}
+
+			template<MathAccuracy Accuracy>
+			inline __m256 Exp2Polynomial(__m256 f)
+			{
+				const auto term{ [&](__m256 sum, float coefficient) { return _mm256_add_ps(_mm256_set1_ps(coefficient), _mm256_mul_ps(f, sum)); } };
+
+				if constexpr (Accuracy == MathAccuracy::Fast)
+				{
+					__m256 sum{ _mm256_set1_ps(0.00179096044f) };
+					sum = term(sum, 0.00919421017f);
+					sum = term(sum, 0.0556602851f);
+					sum = term(sum, 0.240206555f);
+					sum = term(sum, 0.6931476f);
+					return term(sum, 1.0f);
+				}
+				else
+				{
+					__m256 sum{ _mm256_set1_ps(0.0726975873f) };
+					sum = term(sum, 0.233355746f);
+					sum = term(sum, 0.693546891f);
+					return term(sum, 1.0f);
+				}
+			}
+		}
+
+		//x > 0, 0 gives -127 so Pow(0, y) still ends up at 0 for y > 0 and at 1 for y == 0
+		template<MathAccuracy Accuracy>
+		inline float Log2(float x)
+		{
+			if constexpr (Accuracy == MathAccuracy::Exact)
+			{
+				return std::log2(x);
+			}
+			else
+			{
+				//Split into exponent and mantissa, only the mantissa in [1, 2) goes through the polynomial
+				const uint32_t bits{ std::bit_cast<uint32_t>(x) };
+				const float exponent{ static_cast<float>(static_cast<int>(bits >> 23) - 127) };
+				const float mantissa{ std::bit_cast<float>((bits & 0x007FFFFFu) | 0x3F800000u) };
+
+				return exponent + Detail::Log2Polynomial<Accuracy>(mantissa - 1.0f);
+			}
+		}
+
+		template<MathAccuracy Accuracy>
+		inline float Exp2(float x)
+		{
+			if constexpr (Accuracy == MathAccuracy::Exact)
+			{
+				return std::exp2(x);
+			}
+			else
+			{
+				//Integer part goes straight into the exponent bits, the fraction through the polynomial
+				x = std::clamp(x, -126.0f, 127.0f);
+				const float whole{ std::floor(x) };
+				const float scale{ std::bit_cast<float>(static_cast<uint32_t>(static_cast<int>(whole) + 127) << 23) };
+
+				return scale * Detail::Exp2Polynomial<Accuracy>(x - whole);
+			}
+		}
+
+		//x >= 0
+		template<MathAccuracy Accuracy>
+		inline float Pow(float x, float y)
+		{
+			if constexpr (Accuracy == MathAccuracy::Exact)
+			{
+				return std::pow(x, y);
+			}
+			else
+			{
+				return Exp2<Accuracy>(y * Log2<Accuracy>(x));
+			}
+		}
+
+		template<MathAccuracy Accuracy>
+		inline float Rsqrt(float x)
+		{
+			if constexpr (Accuracy == MathAccuracy::Exact)
+			{
+				return 1.0f / std::sqrt(x);
+			}
+			else
+			{
+				//The hardware estimate has 12 bits, one Newton step brings it to about 22
+				//Packed instead of rsqrtss, that one merges into the old register contents and chains every call to the previous one
+				const float estimate{ _mm_cvtss_f32(_mm_rsqrt_ps(_mm_set1_ps(x))) };
+				if constexpr (Accuracy == MathAccuracy::Fast)
+				{
+					return estimate * (1.5f - 0.5f * x * estimate * estimate);
+				}
+				else
+				{
+					return estimate;
+				}
+			}
+		}
+
+		template<MathAccuracy Accuracy>
+		inline Vector3 Normalized(const Vector3& v)
+		{
+			if constexpr (Accuracy == MathAccuracy::Exact)
+			{
+				return v.Normalized();
+			}
+			else
+			{
+				return v * Rsqrt<Accuracy>(Vector3::Dot(v, v));
+			}
+		}
+
+		//4 lanes at once, same results as the scalar versions
+		template<MathAccuracy Accuracy>
+		inline __m128 Log2(__m128 x)
+		{
+			if constexpr (Accuracy == MathAccuracy::Exact)
+			{
+				alignas(16) float lanes[4]{};
+				_mm_store_ps(lanes, x);
+				return _mm_setr_ps(std::log2(lanes[0]), std::log2(lanes[1]), std::log2(lanes[2]), std::log2(lanes[3]));
+			}
+			else
+			{
+				const __m128i bits{ _mm_castps_si128(x) };
+				const __m128 exponent{ _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127))) };
+				const __m128 mantissa{ _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007FFFFF)), _mm_set1_epi32(0x3F800000))) };
+
+				return _mm_add_ps(exponent, Detail::Log2Polynomial<Accuracy>(_mm_sub_ps(mantissa, _mm_set1_ps(1.0f))));
+			}
+		}
+
+		template<MathAccuracy Accuracy>
+		inline __m128 Exp2(__m128 x)
+		{
+			if constexpr (Accuracy == MathAccuracy::Exact)
+			{
+				alignas(16) float lanes[4]{};
+				_mm_store_ps(lanes, x);
+				return _mm_setr_ps(std::exp2(lanes[0]), std::exp2(lanes[1]), std::exp2(lanes[2]), std::exp2(lanes[3]));
+			}
+			else
+			{
+				x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-126.0f)), _mm_set1_ps(127.0f));
+				const __m128 whole{ _mm_floor_ps(x) };
+				const __m128 scale{ _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_cvtps_epi32(whole), _mm_set1_epi32(127)), 23)) };
+
+				return _mm_mul_ps(scale, Detail::Exp2Polynomial<Accuracy>(_mm_sub_ps(x, whole)));
+			}
+		}
+
+		template<MathAccuracy Accuracy>
+		inline __m128 Pow(__m128 x, __m128 y)
+		{
+			if constexpr (Accuracy == MathAccuracy::Exact)
+			{
+				alignas(16) float xLanes[4]{};
+				alignas(16) float yLanes[4]{};
+				_mm_store_ps(xLanes, x);
+				_mm_store_ps(yLanes, y);
+				return _mm_setr_ps(std::pow(xLanes[0], yLanes[0]), std::pow(xLanes[1], yLanes[1]), std::pow(xLanes[2], yLanes[2]), std::pow(xLanes[3], yLanes[3]));
+			}
+			else
+			{
+				return Exp2<Accuracy>(_mm_mul_ps(y, Log2<Accuracy>(x)));
+			}
+		}
+
+		template<MathAccuracy Accuracy>
+		inline __m128 Rsqrt(__m128 x)
+		{
+			if constexpr (Accuracy == MathAccuracy::Exact)
+			{
+				return _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(x));
+			}
+			else
+			{
+				const __m128 estimate{ _mm_rsqrt_ps(x) };
+				if constexpr (Accuracy == MathAccuracy::Fast)
+				{
+					const __m128 halfXEstimateSquared{ _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), x), _mm_mul_ps(estimate, estimate)) };
+					return _mm_mul_ps(estimate, _mm_sub_ps(_mm_set1_ps(1.5f), halfXEstimateSquared));
+				}
+				else
+				{
+					return estimate;
+				}
+			}
+		}
+
+		//Normalizes 4 vectors stored as separate x, y and z lanes
+		template<MathAccuracy Accuracy>
+		inline void Normalize(__m128& x, __m128& y, __m128& z)
+		{
+			const __m128 inverseLength{ Rsqrt<Accuracy>(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z))) };
+			x = _mm_mul_ps(x, inverseLength);
+			y = _mm_mul_ps(y, inverseLength);
+			z = _mm_mul_ps(z, inverseLength);
+		}
+
+		//8 lanes at once (AVX2), same results as the scalar versions
+		template<MathAccuracy Accuracy>
+		inline __m256 Log2(__m256 x)
+		{
+			if constexpr (Accuracy == MathAccuracy::Exact)
+			{
+				alignas(32) float lanes[8]{};
+				_mm256_store_ps(lanes, x);
+				for (float& lane : lanes)
+				{
+					lane = std::log2(lane);
+				}
+				return _mm256_load_ps(lanes);
+			}
+			else
+			{
+				const __m256i bits{ _mm256_castps_si256(x) };
+				const __m256 exponent{ _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127))) };
+				const __m256 mantissa{ _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007FFFFF)), _mm256_set1_epi32(0x3F800000))) };
+
+				return _mm256_add_ps(exponent, Detail::Log2Polynomial<Accuracy>(_mm256_sub_ps(mantissa, _mm256_set1_ps(1.0f))));
+			}
+		}
+
+		template<MathAccuracy Accuracy>
+		inline __m256 Exp2(__m256 x)
+		{
+			if constexpr (Accuracy == MathAccuracy::Exact)
+			{
+				alignas(32) float lanes[8]{};
+				_mm256_store_ps(lanes, x);
+				for (float& lane : lanes)
+				{
+					lane = std::exp2(lane);
+				}
+				return _mm256_load_ps(lanes);
+			}
+			else
+			{
+				x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-126.0f)), _mm256_set1_ps(127.0f));
+				const __m256 whole{ _mm256_floor_ps(x) };
+				const __m256 scale{ _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(whole), _mm256_set1_epi32(127)), 23)) };
+
+				return _mm256_mul_ps(scale, Detail::Exp2Polynomial<Accuracy>(_mm256_sub_ps(x, whole)));
+			}
+		}
+
+		template<MathAccuracy Accuracy>
+		inline __m256 Pow(__m256 x, __m256 y)
+		{
+			if constexpr (Accuracy == MathAccuracy::Exact)
+			{
+				alignas(32) float xLanes[8]{};
+				alignas(32) float yLanes[8]{};
+				_mm256_store_ps(xLanes, x);
+				_mm256_store_ps(yLanes, y);
+				for (int lane{}; lane < 8; ++lane)
+				{
+					xLanes[lane] = std::pow(xLanes[lane], yLanes[lane]);
+				}
+				return _mm256_load_ps(xLanes);
+			}
+			else
+			{
+				return Exp2<Accuracy>(_mm256_mul_ps(y, Log2<Accuracy>(x)));
+			}
+		}
+
+		template<MathAccuracy Accuracy>
+		inline __m256 Rsqrt(__m256 x)
+		{
+			if constexpr (Accuracy == MathAccuracy::Exact)
+			{
+				return _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(x));
+			}
+			else
+			{
+				const __m256 estimate{ _mm256_rsqrt_ps(x) };
+				if constexpr (Accuracy == MathAccuracy::Fast)
+				{
+					const __m256 halfXEstimateSquared{ _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f), x), _mm256_mul_ps(estimate, estimate)) };
+					return _mm256_mul_ps(estimate, _mm256_sub_ps(_mm256_set1_ps(1.5f), halfXEstimateSquared));
+				}
+				else
+				{
+					return estimate;
+				}
+			}
+		}
+
+		template<MathAccuracy Accuracy>
+		inline void Normalize(__m256& x, __m256& y, __m256& z)
+		{
+			const __m256 lengthSquared{ _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)), _mm256_mul_ps(z, z)) };
+
+			if constexpr (Accuracy == MathAccuracy::Exact)
+			{
+				//Divide like Vector3::Normalized does
+				const __m256 length{ _mm256_sqrt_ps(lengthSquared) };
+				x = _mm256_div_ps(x, length);
+				y = _mm256_div_ps(y, length);
+				z = _mm256_div_ps(z, length);
+			}
+			else
+			{
+				const __m256 inverseLength{ Rsqrt<Accuracy>(lengthSquared) };
+				x = _mm256_mul_ps(x, inverseLength);
+				y = _mm256_mul_ps(y, inverseLength);
+				z = _mm256_mul_ps(z, inverseLength);
+			}
+		}
+
+		//Runtime picked tier, for code that reads the accuracy from the settings
+		//The branch goes the same way for a whole frame, so it predicts perfectly
+		inline float Pow(float x, float y, MathAccuracy accuracy)
+		{
+			switch (accuracy)
+			{
+			case MathAccuracy::Fast:
+				return Pow<MathAccuracy::Fast>(x, y);
+			case MathAccuracy::Fastest:
+				return Pow<MathAccuracy::Fastest>(x, y);
+			default:
+				return Pow<MathAccuracy::Exact>(x, y);
+			}
+		}
+
+		inline Vector3 Normalized(const Vector3& v, MathAccuracy accuracy)
+		{
+			switch (accuracy)
+			{
+			case MathAccuracy::Fast:
+				return Normalized<MathAccuracy::Fast>(v);
+			case MathAccuracy::Fastest:
+				return Normalized<MathAccuracy::Fastest>(v);
+			default:
+				return Normalized<MathAccuracy::Exact>(v);
+			}
+		}
+
+		//Prints the maximum error of every function and tier against the std functions, and the time per call
+		//Run with --fastmath-report
+		void Report();
+	}
+}
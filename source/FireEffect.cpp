@@ -134,7 +134,7 @@ namespace dae
 		return m_pMatWorldViewProjVariable;
 	}
 
-	void FireEffect::SetDiffuseMap(Texture* pTexture)
+	void FireEffect::SetDiffuseMap(const Texture* pTexture)
 	{
 		if (m_pDiffuseMapVariable)
 		{
@@ -18,7 +18,7 @@ namespace dae
 		ID3D11InputLayout* GetInputLayout() const;
 		ID3DX11EffectMatrixVariable* GetWorldViewProjectionMatrix() const;
 
-		void SetDiffuseMap(Texture* pTexture);
+		void SetDiffuseMap(const Texture* pTexture);
 		void SetWorldMatrix(Matrix& worldMatrix);
 		void SetInverseViewMatrix(Matrix& inverseView);
 
@@ -4,6 +4,7 @@
 #include "Effect.h"
 #include "DirectXMesh.h"
 #include "FireEffect.h"
+#include "Texture.h"
 
 namespace dae 
 {
@@ -57,11 +58,12 @@ namespace dae
 		}
 	}
 
-	void HardwareRenderer::Update(const Timer* pTimer, bool shouldRotate, bool showFire, bool uniformColor, CullMode cullMode)
+	void HardwareRenderer::Update(const Timer* pTimer, bool shouldRotate, bool showFire, bool uniformColor, CullMode cullMode, SampleMode sampleMode)
 	{
 		m_pCamera->Update(pTimer);
 		m_ShowFire = showFire;
 		m_UniformColor = uniformColor;
+		m_SampleMode = sampleMode;
 
 		if (shouldRotate)
 		{
@@ -124,31 +126,6 @@ namespace dae
 		m_pSwapChain->Present(0, 0);
 	}
 
-	void HardwareRenderer::ToggleSampleState()
-	{
-		std::cout << "\033[32m";;
-
-		switch (m_SampleMode)
-		{
-		case dae::SampleMode::Point:
-			m_SampleMode = SampleMode::Linear;
-			std::cout << "**(HARDWARE) Sampler Filter = LINEAR";
-			break;
-		case dae::SampleMode::Linear:
-			m_SampleMode = SampleMode::Anisotropic;
-			std::cout << "**(HARDWARE) Sampler Filter = ANISOTROPIC";
-			break;
-		case dae::SampleMode::Anisotropic:
-			m_SampleMode = SampleMode::Point;
-			std::cout << "**(HARDWARE) Sampler Filter = POINT";
-			break;
-		default:
-			break;
-		}
-
-		std::cout << '\n';
-	}
-
 	HRESULT HardwareRenderer::InitializeDirectX()
 	{
 		//1 Create device & device context
@@ -265,126 +242,146 @@ namespace dae
 
 	void HardwareRenderer::SetupVehicleMesh(std::vector<MeshData*>& pMeshes)
 	{
-		for (auto texture : pMeshes[0]->m_pTextureMap)
+		//Same material description the software rasterizer shades with
+		//The effect samples the separate maps, the packed and virtual maps are only read by the software rasterizer
+		const Material& material{ pMeshes[0]->material };
+
+		for (Texture* pTexture : { material.pDiffuseMap.get(), material.pNormalMap.get(), material.pSpecularMap.get(), material.pGlossyMap.get() })
 		{
-			if (texture.second == nullptr)
+			if (pTexture == nullptr)
 			{
-				std::cout << texture.first << " was a nullptr\n";
+				std::cout << "Vehicle material has an empty texture slot\n";
 				continue;
 			}
 
-			auto pSurface = texture.second->GetSurface();
-
-			DXGI_FORMAT format = DXGI_FORMAT_R8G8B8A8_UNORM;
-			D3D11_TEXTURE2D_DESC desc{};
-			desc.Width = pSurface->w;
-			desc.Height = pSurface->h;
-			desc.MipLevels = 1;
-			desc.ArraySize = 1;
-			desc.Format = format;
-			desc.SampleDesc.Count = 1;
-			desc.SampleDesc.Quality = 0;
-			desc.Usage = D3D11_USAGE_DEFAULT;
-			desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-			desc.CPUAccessFlags = 0;
-			desc.MiscFlags = 0;
-
-			D3D11_SUBRESOURCE_DATA initData;
-			initData.pSysMem = pSurface->pixels;
-			initData.SysMemPitch = static_cast<UINT>(pSurface->pitch);
-			initData.SysMemSlicePitch = static_cast<UINT>(pSurface->h * pSurface->pitch);
-
-			auto pResource{ texture.second->GetResource() };
-			HRESULT hr = m_pDevice->CreateTexture2D(&desc, &initData, &pResource);
-
-			if (FAILED(hr))
-			{
-				throw std::runtime_error("Failed to create texture for direct3d");
-			}
+			CreateShaderResource(pTexture);
+		}
 
-			texture.second->SetResource(pResource);
+		m_pMeshes[0]->GetEffect()->SetMaterial(material.Bind());
+	}
 
-			D3D11_SHADER_RESOURCE_VIEW_DESC SRVDesc{};
-			SRVDesc.Format = format;
-			SRVDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-			SRVDesc.Texture2D.MipLevels = 1;
+	void HardwareRenderer::SetupThrusterMesh(std::vector<MeshData*>& pMeshes)
+	{
+		Texture* pDiffuseMap{ pMeshes[1]->material.pDiffuseMap.get() };
+		if (pDiffuseMap == nullptr)
+		{
+			std::cout << "Thruster material has no DiffuseMap\n";
+			return;
+		}
 
-			auto pResourceView{ texture.second->GetSRV() };
+		CreateShaderResource(pDiffuseMap);
+		m_pMeshes[1]->GetFireEffect()->SetDiffuseMap(pDiffuseMap);
+	}
 
-			hr = m_pDevice->CreateShaderResourceView(pResource, &SRVDesc, &pResourceView);
+	void HardwareRenderer::CreateShaderResource(Texture* pTexture)
+	{
+		//Textures are shared between meshes, only the first mesh that uses one uploads it
+		if (pTexture->GetSRV())
+		{
+			return;
+		}
 
-			if (FAILED(hr))
-			{
-				throw std::runtime_error("Failed to create resource view for texture");
-			}
+		//Upload the whole mip chain the texture generated on load, so both rasterizers filter the same data
+		const UINT mipCount{ static_cast<UINT>(pTexture->GetMipCount()) };
+		const UINT bytesPerTexel{ static_cast<UINT>(pTexture->GetBytesPerTexel()) };
 
-			texture.second->SetResourceView(pResourceView);
+		DXGI_FORMAT format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		switch (pTexture->GetFormat())
+		{
+		case dae::TextureFormat::NormalSNorm8:
+			format = DXGI_FORMAT_R8G8B8A8_SNORM;
+			break;
+		case dae::TextureFormat::R8:
+			format = DXGI_FORMAT_R8_UNORM;
+			break;
+		case dae::TextureFormat::BC1:
+			format = DXGI_FORMAT_BC1_UNORM;
+			break;
+		case dae::TextureFormat::BC3:
+			format = DXGI_FORMAT_BC3_UNORM;
+			break;
+		case dae::TextureFormat::BC4:
+			format = DXGI_FORMAT_BC4_UNORM;
+			break;
+		case dae::TextureFormat::BC5:
+			format = DXGI_FORMAT_BC5_SNORM;
+			break;
+		default:
+			break;
 		}
 
-		m_pMeshes[0]->GetEffect()->SetDiffuseMap(m_pMeshes[0]->GetMesh()->GetTexture("DiffuseMap"));
-		m_pMeshes[0]->GetEffect()->SetNormalMap(m_pMeshes[0]->GetMesh()->GetTexture("NormalMap"));
-		m_pMeshes[0]->GetEffect()->SetSpecularMap(m_pMeshes[0]->GetMesh()->GetTexture("SpecularMap"));
-		m_pMeshes[0]->GetEffect()->SetGlossyMap(m_pMeshes[0]->GetMesh()->GetTexture("GlossyMap"));
-	}
-
-	void HardwareRenderer::SetupThrusterMesh(std::vector<MeshData*>& pMeshes)
-	{
-		for (auto texture : pMeshes[1]->m_pTextureMap)
+		D3D11_TEXTURE2D_DESC desc{};
+		desc.Width = pTexture->GetMipLevel(0).width;
+		desc.Height = pTexture->GetMipLevel(0).height;
+		desc.MipLevels = mipCount;
+		desc.ArraySize = 1;
+		desc.Format = format;
+		desc.SampleDesc.Count = 1;
+		desc.SampleDesc.Quality = 0;
+		desc.Usage = D3D11_USAGE_DEFAULT;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		desc.CPUAccessFlags = 0;
+		desc.MiscFlags = 0;
+
+		//D3D11 expects row-major texels, so tiled textures upload a linear copy of every level
+		//Block compressed textures already hold their blocks the way D3D11 expects them and upload as is
+		const bool isLinear{ pTexture->GetLayout() == TextureLayout::Linear || pTexture->IsBlockCompressed() };
+		std::vector<std::vector<uint8_t>> linearLevels(isLinear ? 0 : mipCount);
+
+		std::vector<D3D11_SUBRESOURCE_DATA> initData(mipCount);
+		for (UINT level{}; level < mipCount; ++level)
 		{
-			if (texture.second == nullptr)
+			const Texture::MipLevel& mipLevel{ pTexture->GetMipLevel(static_cast<int>(level)) };
+
+			if (isLinear)
 			{
-				std::cout << texture.first << " was a nullptr\n";
-				continue;
+				initData[level].pSysMem = mipLevel.pTexels;
+			}
+			else
+			{
+				linearLevels[level] = pTexture->CopyLevelLinear(static_cast<int>(level));
+				initData[level].pSysMem = linearLevels[level].data();
 			}
 
-			auto pSurface = texture.second->GetSurface();
-
-			DXGI_FORMAT format = DXGI_FORMAT_R8G8B8A8_UNORM;
-			D3D11_TEXTURE2D_DESC desc{};
-			desc.Width = pSurface->w;
-			desc.Height = pSurface->h;
-			desc.MipLevels = 1;
-			desc.ArraySize = 1;
-			desc.Format = format;
-			desc.SampleDesc.Count = 1;
-			desc.SampleDesc.Quality = 0;
-			desc.Usage = D3D11_USAGE_DEFAULT;
-			desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-			desc.CPUAccessFlags = 0;
-			desc.MiscFlags = 0;
-
-			D3D11_SUBRESOURCE_DATA initData;
-			initData.pSysMem = pSurface->pixels;
-			initData.SysMemPitch = static_cast<UINT>(pSurface->pitch);
-			initData.SysMemSlicePitch = static_cast<UINT>(pSurface->h * pSurface->pitch);
-
-			auto pResource{ texture.second->GetResource() };
-			HRESULT hr = m_pDevice->CreateTexture2D(&desc, &initData, &pResource);
-
-			if (FAILED(hr))
+			if (pTexture->IsBlockCompressed())
 			{
-				throw std::runtime_error("Failed to create texture for direct3d");
+				//The pitch of a block compressed level is one row of blocks
+				const UINT blocksPerRow{ static_cast<UINT>((mipLevel.width + 3) / 4) };
+				const UINT blocksPerColumn{ static_cast<UINT>((mipLevel.height + 3) / 4) };
+				initData[level].SysMemPitch = blocksPerRow * static_cast<UINT>(pTexture->GetBytesPerBlock());
+				initData[level].SysMemSlicePitch = initData[level].SysMemPitch * blocksPerColumn;
 			}
+			else
+			{
+				initData[level].SysMemPitch = static_cast<UINT>(mipLevel.width) * bytesPerTexel;
+				initData[level].SysMemSlicePitch = static_cast<UINT>(mipLevel.height * mipLevel.width) * bytesPerTexel;
+			}
+		}
 
-			texture.second->SetResource(pResource);
+		auto pResource{ pTexture->GetResource() };
+		HRESULT hr = m_pDevice->CreateTexture2D(&desc, initData.data(), &pResource);
 
-			D3D11_SHADER_RESOURCE_VIEW_DESC SRVDesc{};
-			SRVDesc.Format = format;
-			SRVDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-			SRVDesc.Texture2D.MipLevels = 1;
+		if (FAILED(hr))
+		{
+			throw std::runtime_error("Failed to create texture for direct3d");
+		}
 
-			auto pResourceView{ texture.second->GetSRV() };
+		pTexture->SetResource(pResource);
 
-			hr = m_pDevice->CreateShaderResourceView(pResource, &SRVDesc, &pResourceView);
+		D3D11_SHADER_RESOURCE_VIEW_DESC SRVDesc{};
+		SRVDesc.Format = format;
+		SRVDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+		SRVDesc.Texture2D.MipLevels = mipCount;
 
-			if (FAILED(hr))
-			{
-				throw std::runtime_error("Failed to create resource view for texture");
-			}
+		auto pResourceView{ pTexture->GetSRV() };
+
+		hr = m_pDevice->CreateShaderResourceView(pResource, &SRVDesc, &pResourceView);
 
-			texture.second->SetResourceView(pResourceView);
+		if (FAILED(hr))
+		{
+			throw std::runtime_error("Failed to create resource view for texture");
 		}
 
-		m_pMeshes[1]->GetFireEffect()->SetDiffuseMap(m_pMeshes[1]->GetMesh()->GetTexture("fireFX"));
+		pTexture->SetResourceView(pResourceView);
 	}
-}
\ No newline at end of file
+}
@@ -17,17 +17,16 @@ namespace dae
 		HardwareRenderer(SDL_Window* pWindow, Camera* pCamera, int width, int height, std::vector<MeshData*> pMeshes);
 		~HardwareRenderer();
 
-		void Update(const Timer* pTimer, bool shouldRotate, bool showFire, bool uniformColor, CullMode cullMode);
+		void Update(const Timer* pTimer, bool shouldRotate, bool showFire, bool uniformColor, CullMode cullMode, SampleMode sampleMode);
 		void Render() const;
 
-		void ToggleSampleState();
-
 	private:
 
 		HRESULT InitializeDirectX();
 
 		void SetupVehicleMesh(std::vector<MeshData*>& pMeshes);
 		void SetupThrusterMesh(std::vector<MeshData*>& pMeshes);
+		void CreateShaderResource(Texture* pTexture);
 
 		SDL_Window* m_pWindow{};
 		Camera* m_pCamera;
@@ -0,0 +1,24 @@
+#pragma once
+#include <cstdint>
+#include <immintrin.h>
+#include "ColorRGB.h"
+
+namespace dae
+{
+	//A pixel of the software rasterizer's colour buffer: linear red, green and blue as half floats, the fourth half unused
+	//Nothing is clamped until the resolve, colours above one blend and filter like any other
+	using HdrPixel = uint64_t;
+
+	inline HdrPixel ToHdrPixel(const ColorRGB& colour)
+	{
+		const __m128i halves{ _mm_cvtps_ph(_mm_setr_ps(colour.r, colour.g, colour.b, 0.0f), _MM_FROUND_TO_NEAREST_INT) };
+		return static_cast<HdrPixel>(_mm_cvtsi128_si64(halves));
+	}
+
+	inline ColorRGB ToColorRGB(HdrPixel pixel)
+	{
+		alignas(16) float channels[4]{};
+		_mm_store_ps(channels, _mm_cvtph_ps(_mm_cvtsi64_si128(static_cast<long long>(pixel))));
+		return ColorRGB{ channels[0], channels[1], channels[2] };
+	}
+}
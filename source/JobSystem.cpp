@@ -0,0 +1,125 @@
+#include "pch.h"
+#include "JobSystem.h"
+#include <atomic>
+
+namespace dae
+{
+	JobSystem::JobSystem()
+	{
+		//Keep one hardware thread for the caller, it helps out during ParallelFor
+		const unsigned int hardwareThreads{ std::thread::hardware_concurrency() };
+		const unsigned int workerCount{ hardwareThreads > 1 ? hardwareThreads - 1 : 0 };
+
+		for (unsigned int i{}; i < workerCount; ++i)
+		{
+			m_Workers.emplace_back(&JobSystem::WorkerLoop, this);
+		}
+	}
+
+	JobSystem::~JobSystem()
+	{
+		{
+			std::lock_guard<std::mutex> lock{ m_JobMutex };
+			m_IsStopping = true;
+		}
+
+		m_JobCondition.notify_all();
+
+		for (auto& worker : m_Workers)
+		{
+			worker.join();
+		}
+	}
+
+	JobSystem& JobSystem::GetInstance()
+	{
+		static JobSystem instance{};
+		return instance;
+	}
+
+	void JobSystem::ParallelFor(int count, int grainSize, const std::function<void(int begin, int end)>& job)
+	{
+		if (count <= 0)
+		{
+			return;
+		}
+
+		grainSize = std::max(grainSize, 1);
+		const int chunkCount{ (count + grainSize - 1) / grainSize };
+
+		if (chunkCount == 1 || m_Workers.empty())
+		{
+			job(0, count);
+			return;
+		}
+
+		std::atomic<int> nextChunk{ 0 };
+
+		auto runChunks = [&]()
+		{
+			for (int chunk{ nextChunk.fetch_add(1) }; chunk < chunkCount; chunk = nextChunk.fetch_add(1))
+			{
+				const int begin{ chunk * grainSize };
+				job(begin, std::min(begin + grainSize, count));
+			}
+		};
+
+		//The helpers reference this stack frame, so wait for all of them (not just all chunks) before returning
+		const int helperCount{ std::min(static_cast<int>(m_Workers.size()), chunkCount - 1) };
+		int pendingHelpers{ helperCount };
+		std::mutex doneMutex{};
+		std::condition_variable doneCondition{};
+
+		{
+			std::lock_guard<std::mutex> lock{ m_JobMutex };
+			for (int i{}; i < helperCount; ++i)
+			{
+				m_Jobs.push([&]()
+					{
+						runChunks();
+
+						std::lock_guard<std::mutex> doneLock{ doneMutex };
+						if (--pendingHelpers == 0)
+						{
+							doneCondition.notify_one();
+						}
+					});
+			}
+		}
+
+		m_JobCondition.notify_all();
+
+		runChunks();
+
+		std::unique_lock<std::mutex> doneLock{ doneMutex };
+		doneCondition.wait(doneLock, [&]() { return pendingHelpers == 0; });
+	}
+
+	int JobSystem::GetWorkerCount() const
+	{
+		return static_cast<int>(m_Workers.size());
+	}
+
+	void JobSystem::WorkerLoop()
+	{
+		while (true)
+		{
+			std::function<void()> job{};
+
+			{
+				std::unique_lock<std::mutex> lock{ m_JobMutex };
+				m_JobCondition.wait(lock, [this]() { return m_IsStopping || !m_Jobs.empty(); });
+
+				if (m_IsStopping && m_Jobs.empty())
+				{
+					return;
+				}
+
+				job = std::move(m_Jobs.front());
+				m_Jobs.pop();
+			}
+
+			job();
+		}
+	}
+}
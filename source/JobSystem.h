@@ -0,0 +1,41 @@
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace dae
+{
+	class JobSystem final
+	{
+	public:
+		JobSystem(const JobSystem&) = delete;
+		JobSystem(JobSystem&&) noexcept = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+		JobSystem& operator=(JobSystem&&) noexcept = delete;
+
+		static JobSystem& GetInstance();
+
+		//Splits [0, count) into chunks of grainSize and runs them on the workers and the calling thread
+		//Returns once every chunk has been processed
+		void ParallelFor(int count, int grainSize, const std::function<void(int begin, int end)>& job);
+
+		int GetWorkerCount() const;
+
+	private:
+		JobSystem();
+		~JobSystem();
+
+		void WorkerLoop();
+
+		std::vector<std::thread> m_Workers{};
+		std::queue<std::function<void()>> m_Jobs{};
+
+		std::mutex m_JobMutex{};
+		std::condition_variable m_JobCondition{};
+
+		bool m_IsStopping{ false };
+	};
+}
@@ -0,0 +1,31 @@
+#include "pch.h"
+#include "Material.h"
+#include "Texture.h"
+#include "VirtualTexture.h"
+
+namespace dae
+{
+	//Defined here so the header does not need the full VirtualTexture for the unique_ptr
+	Material::Material() = default;
+	Material::~Material() = default;
+
+	MaterialBinding Material::Bind() const
+	{
+		return MaterialBinding{ pDiffuseMap.get(), pNormalMap.get(), pSpecularMap.get(), pGlossyMap.get(), pPackedMap.get(), pVirtualDiffuseMap.get(),
+			shininess, lightIntensity, ambient };
+	}
+
+	size_t Material::GetMemorySize() const
+	{
+		size_t memorySize{};
+		for (const Texture* pTexture : { pDiffuseMap.get(), pNormalMap.get(), pSpecularMap.get(), pGlossyMap.get(), pPackedMap.get() })
+		{
+			if (pTexture)
+			{
+				memorySize += pTexture->GetMemorySize();
+			}
+		}
+
+		return memorySize;
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <memory>
+#include "ColorRGB.h"
+#include "DataTypes.h"
+
+namespace dae
+{
+	class Texture;
+	class VirtualTexture;
+
+	//Raw pointers into a Material, resolved once per draw so shading never looks anything up
+	//Only valid while the Material it came from is alive and unchanged
+	struct MaterialBinding
+	{
+		const Texture* pDiffuseMap{};
+		const Texture* pNormalMap{};
+		const Texture* pSpecularMap{};
+		const Texture* pGlossyMap{};
+		//Interleaved copy of the four maps above, used instead of them when it is there
+		const Texture* pPackedMap{};
+		//Streamed replacement for pDiffuseMap
+		const VirtualTexture* pVirtualDiffuseMap{};
+
+		float shininess{};
+		float lightIntensity{};
+		ColorRGB ambient{};
+	};
+
+	//Texture slots and shading constants of a mesh, read by both rasterizers
+	//Empty slots are nullptr, the textures are shared through the TextureRegistry
+	class Material final
+	{
+	public:
+		Material();
+		~Material();
+
+		Material(const Material&) = delete;
+		Material(Material&&) noexcept = delete;
+		Material& operator=(const Material&) = delete;
+		Material& operator=(Material&&) noexcept = delete;
+
+		MaterialBinding Bind() const;
+
+		//Cpu memory of the textures in the slots
+		size_t GetMemorySize() const;
+
+		std::shared_ptr<Texture> pDiffuseMap{};
+		std::shared_ptr<Texture> pNormalMap{};
+		std::shared_ptr<Texture> pSpecularMap{};
+		std::shared_ptr<Texture> pGlossyMap{};
+		std::shared_ptr<Texture> pPackedMap{};
+		std::unique_ptr<VirtualTexture> pVirtualDiffuseMap{};
+
+		float shininess{ 25.0f };
+		float lightIntensity{ 7.0f };
+		ColorRGB ambient{ 0.025f, 0.025f, 0.025f };
+	};
+}
@@ -146,9 +146,28 @@ namespace dae
 
 	Matrix Matrix::CreateLookAtLH(const Vector3& origin, const Vector3& forward, const Vector3& up)
 	{
-		//TODO W1
+		//Forward is the direction to look in, not a target point
+		const Vector3 zAxis{ forward.Normalized() };
+		const Vector3 xAxis{ Vector3::Cross(up, zAxis).Normalized() };
+		const Vector3 yAxis{ Vector3::Cross(zAxis, xAxis) };
 
-		return {};
+		return {
+			Vector4{xAxis.x, yAxis.x, zAxis.x, 0},
+			Vector4{xAxis.y, yAxis.y, zAxis.y, 0},
+			Vector4{xAxis.z, yAxis.z, zAxis.z, 0},
+			Vector4{-Vector3::Dot(xAxis, origin), -Vector3::Dot(yAxis, origin), -Vector3::Dot(zAxis, origin), 1}
+		};
+	}
+
+	Matrix Matrix::CreateOrthographicLH(float width, float height, float zn, float zf)
+	{
+		//DirectX Implementation => https://learn.microsoft.com/en-us/windows/win32/direct3d9/d3dxmatrixortholh
+		return {
+			Vector4{2.f / width, 0, 0, 0},
+			Vector4{0, 2.f / height, 0, 0},
+			Vector4{0, 0, 1.f / (zf - zn), 0},
+			Vector4{0, 0, zn / (zn - zf), 1},
+		};
 	}
 
 	Matrix Matrix::CreatePerspectiveFovLH(float fov, float aspect, float zn, float zf)
@@ -290,5 +309,18 @@ namespace dae
 
 		return *this;
 	}
+
+	bool Matrix::operator==(const Matrix& m) const
+	{
+		for (int r{ 0 }; r < 4; ++r)
+		{
+			if (data[r].x != m.data[r].x || data[r].y != m.data[r].y || data[r].z != m.data[r].z || data[r].w != m.data[r].w)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
 #pragma endregion
 }
\ No newline at end of file
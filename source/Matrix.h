@@ -51,11 +51,14 @@ namespace dae
 
 		static Matrix CreateLookAtLH(const Vector3& origin, const Vector3& forward, const Vector3& up);
 		static Matrix CreatePerspectiveFovLH(float fovy, float aspect, float zn, float zf);
+		static Matrix CreateOrthographicLH(float width, float height, float zn, float zf);
 
 		Vector4& operator[](int index);
 		Vector4 operator[](int index) const;
 		Matrix operator*(const Matrix& m) const;
 		const Matrix& operator*=(const Matrix& m);
+		//Exact, for telling whether a transform changed
+		bool operator==(const Matrix& m) const;
 
 	private:
 
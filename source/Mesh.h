@@ -1,9 +1,8 @@
 #pragma once
 
-#include "Texture.h"
+#include "Material.h"
 #include <vector>
 #include "DataTypes.h"
-#include <map>
 
 namespace dae
 {
@@ -15,13 +14,7 @@ namespace dae
 		MeshData(MeshData&&) noexcept = delete;
 		MeshData& operator=(const MeshData&) = delete;
 		MeshData& operator=(MeshData&&) noexcept = delete;
-		~MeshData()
-		{
-			for (auto& texture : m_pTextureMap)
-			{
-				delete texture.second;
-			}
-		};
+		~MeshData() = default;
 
 		std::vector<Vertex_In> vertices{};
 		std::vector<Vertex_Out> vertices_out{};
@@ -35,7 +28,8 @@ namespace dae
 		Matrix rotationMatrix{};
 		float yawRotation{};
 
-		std::map<std::string, Texture*> m_pTextureMap{};
+		//Texture slots share their textures through the TextureRegistry, meshes that use the same file point at the same texture
+		Material material{};
 
 		void AddRotationY(float yaw)
 		{
@@ -46,11 +40,6 @@ namespace dae
 			UpdateWorldMatrix();
 		};
 
-		Texture* GetTexture(std::string textureName) const
-		{
-			return m_pTextureMap.at(textureName);
-		}
-
 	private:
 		void UpdateWorldMatrix()
 		{
@@ -0,0 +1,167 @@
+#include "pch.h"
+#include "MultisampleBuffer.h"
+#include "JobSystem.h"
+
+namespace dae
+{
+	MultisampleBuffer::MultisampleBuffer(int width, int height)
+		: m_Width{ width }
+		, m_Height{ height }
+	{
+	}
+
+	void MultisampleBuffer::Resize(int width, int height)
+	{
+		m_Width = width;
+		m_Height = height;
+		m_Depths.clear();
+		m_Colours.clear();
+		m_IsSplit.clear();
+	}
+
+	void MultisampleBuffer::BeginFrame(bool isEnabled, int left, int top, int right, int bottom, HdrPixel clearColour)
+	{
+		m_IsEnabled = isEnabled;
+		if (!m_IsEnabled)
+		{
+			return;
+		}
+
+		//Allocated on first use, multisampling that is never turned on costs nothing
+		const size_t pixelCount{ static_cast<size_t>(m_Width) * m_Height };
+		m_Depths.resize(pixelCount * SampleCount, FLT_MAX);
+		m_Colours.resize(pixelCount, clearColour);
+		m_IsSplit.resize(pixelCount, false);
+		m_SampleColours.clear();
+
+		//Outside of the rectangle nothing is rasterized or resolved this frame
+		for (int py{ top }; py < bottom; ++py)
+		{
+			const int first{ left + py * m_Width };
+			std::fill_n(m_Depths.begin() + static_cast<size_t>(first) * SampleCount, (right - left) * SampleCount, FLT_MAX);
+			std::fill_n(m_Colours.begin() + first, right - left, clearColour);
+			std::fill_n(m_IsSplit.begin() + first, right - left, uint8_t{ false });
+		}
+	}
+
+	bool MultisampleBuffer::IsEnabled() const
+	{
+		return m_IsEnabled;
+	}
+
+	int MultisampleBuffer::TestDepth(int pixelIndex, __m128 depths, __m128 covered, bool isEqualTest, float& pixelDepth)
+	{
+		float* pDepths{ m_Depths.data() + static_cast<size_t>(pixelIndex) * SampleCount };
+		const __m128 stored{ _mm_loadu_ps(pDepths) };
+
+		if (isEqualTest)
+		{
+			return _mm_movemask_ps(_mm_and_ps(covered, _mm_cmpeq_ps(depths, stored)));
+		}
+
+		const __m128 passed{ _mm_and_ps(covered, _mm_cmplt_ps(depths, stored)) };
+		const int sampleMask{ _mm_movemask_ps(passed) };
+		if (sampleMask == 0)
+		{
+			return 0;
+		}
+
+		_mm_storeu_ps(pDepths, _mm_blendv_ps(stored, depths, passed));
+
+		//Closest passing sample, the other lanes at FLT_MAX
+		__m128 closest{ _mm_blendv_ps(_mm_set1_ps(FLT_MAX), depths, passed) };
+		closest = _mm_min_ps(closest, _mm_shuffle_ps(closest, closest, _MM_SHUFFLE(2, 3, 0, 1)));
+		closest = _mm_min_ps(closest, _mm_shuffle_ps(closest, closest, _MM_SHUFFLE(1, 0, 3, 2)));
+		pixelDepth = std::min(pixelDepth, _mm_cvtss_f32(closest));
+
+		return sampleMask;
+	}
+
+	void MultisampleBuffer::Write(int pixelIndex, int sampleMask, HdrPixel colour)
+	{
+		if (sampleMask == FullCoverage && !m_IsSplit[pixelIndex])
+		{
+			m_Colours[pixelIndex] = colour;
+			return;
+		}
+
+		if (!m_IsSplit[pixelIndex])
+		{
+			const HdrPixel pixelColour{ m_Colours[pixelIndex] };
+			m_Colours[pixelIndex] = static_cast<HdrPixel>(m_SampleColours.size());
+			m_SampleColours.insert(m_SampleColours.end(), SampleCount, pixelColour);
+			m_IsSplit[pixelIndex] = true;
+		}
+
+		//A split pixel keeps its slot for the rest of the frame, a full mask only makes its samples one colour again
+		HdrPixel* pSamples{ m_SampleColours.data() + m_Colours[pixelIndex] };
+		for (int sample{}; sample < SampleCount; ++sample)
+		{
+			if (sampleMask & (1 << sample))
+			{
+				pSamples[sample] = colour;
+			}
+		}
+	}
+
+	void MultisampleBuffer::Resolve(HdrPixel* pColour, int left, int top, int right, int bottom) const
+	{
+		//The 4 samples' channels summed in float, two samples per 8 lanes, and divided by 4
+		const auto average{ [](const HdrPixel* pSamples)
+			{
+				const __m256i samples{ _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSamples)) };
+				const __m256 pairSum{ _mm256_add_ps(_mm256_cvtph_ps(_mm256_castsi256_si128(samples)), _mm256_cvtph_ps(_mm256_extracti128_si256(samples, 1))) };
+				const __m128 sum{ _mm_add_ps(_mm256_castps256_ps128(pairSum), _mm256_extractf128_ps(pairSum, 1)) };
+				return static_cast<HdrPixel>(_mm_cvtsi128_si64(_mm_cvtps_ph(_mm_mul_ps(sum, _mm_set1_ps(0.25f)), _MM_FROUND_TO_NEAREST_INT)));
+			} };
+
+		JobSystem::GetInstance().ParallelFor(bottom - top, 8, [&](int begin, int end)
+			{
+				for (int py{ top + begin }; py < top + end; ++py)
+				{
+					const int rowStart{ py * m_Width };
+					int px{ left };
+
+					//Runs of 4 pixels that never split are one copy, the common case away from the edges
+					for (; px + 4 <= right; px += 4)
+					{
+						uint32_t splitFlags{};
+						std::memcpy(&splitFlags, m_IsSplit.data() + rowStart + px, sizeof(splitFlags));
+						if (splitFlags == 0)
+						{
+							_mm256_storeu_si256(reinterpret_cast<__m256i*>(pColour + rowStart + px),
+								_mm256_loadu_si256(reinterpret_cast<const __m256i*>(m_Colours.data() + rowStart + px)));
+							continue;
+						}
+
+						for (int pixel{ px }; pixel < px + 4; ++pixel)
+						{
+							const int index{ rowStart + pixel };
+							pColour[index] = m_IsSplit[index] ? average(m_SampleColours.data() + m_Colours[index]) : m_Colours[index];
+						}
+					}
+
+					for (; px < right; ++px)
+					{
+						const int index{ rowStart + px };
+						pColour[index] = m_IsSplit[index] ? average(m_SampleColours.data() + m_Colours[index]) : m_Colours[index];
+					}
+				}
+			});
+	}
+
+	int MultisampleBuffer::GetSplitPixelCount() const
+	{
+		return static_cast<int>(m_SampleColours.size() / SampleCount);
+	}
+
+	size_t MultisampleBuffer::GetDepthMemorySize() const
+	{
+		return m_Depths.size() * sizeof(float);
+	}
+
+	size_t MultisampleBuffer::GetColourMemorySize() const
+	{
+		return m_Colours.size() * sizeof(HdrPixel) + m_IsSplit.size() * sizeof(uint8_t) + m_SampleColours.size() * sizeof(HdrPixel);
+	}
+}
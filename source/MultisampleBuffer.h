@@ -0,0 +1,60 @@
+#pragma once
+#include <vector>
+#include <immintrin.h>
+#include "HdrPixel.h"
+
+namespace dae
+{
+	//4x multisampling for the software rasterizer: coverage and depth per sample, the colour once per pixel until a triangle
+	//covers only part of it, then once per sample in a side array; averaged into the render target once the frame is rasterized
+	class MultisampleBuffer final
+	{
+	public:
+		static constexpr int SampleCount{ 4 };
+		static constexpr int FullCoverage{ (1 << SampleCount) - 1 };
+		//Rotated grid around the pixel's own sample point (pixels), the standard D3D 4x pattern
+		static constexpr float SampleOffsetsX[SampleCount]{ -0.125f, 0.375f, -0.375f, 0.125f };
+		static constexpr float SampleOffsetsY[SampleCount]{ -0.375f, -0.125f, 0.125f, 0.375f };
+
+		MultisampleBuffer(int width, int height);
+
+		MultisampleBuffer(const MultisampleBuffer&) = delete;
+		MultisampleBuffer(MultisampleBuffer&&) noexcept = delete;
+		MultisampleBuffer& operator=(const MultisampleBuffer&) = delete;
+		MultisampleBuffer& operator=(MultisampleBuffer&&) noexcept = delete;
+
+		void Resize(int width, int height);
+
+		//Clears the rectangle's samples to the colour, the split pixels of the last frame are forgotten
+		void BeginFrame(bool isEnabled, int left, int top, int right, int bottom, HdrPixel clearColour);
+		bool IsEnabled() const;
+
+		//Depth test of the covered samples (all bits set in their lanes), returns the mask of the ones that passed
+		//After a depth prepass only the samples holding exactly their depth pass, otherwise the passing ones are written
+		//and pixelDepth takes the closest of them
+		int TestDepth(int pixelIndex, __m128 depths, __m128 covered, bool isEqualTest, float& pixelDepth);
+		//The colour into the samples of the mask, a full mask keeps an unsplit pixel one colour
+		void Write(int pixelIndex, int sampleMask, HdrPixel colour);
+
+		//Average of every pixel's samples into pColour, pixels that never split are copied as they are
+		void Resolve(HdrPixel* pColour, int left, int top, int right, int bottom) const;
+
+		//Pixels that got per sample colours in the last frame, one slot each however often they were written
+		int GetSplitPixelCount() const;
+		//Bytes of the sample depths, and of the colours, flags and split pixels' sample colours in use (not the side array's capacity)
+		size_t GetDepthMemorySize() const;
+		size_t GetColourMemorySize() const;
+
+	private:
+		int m_Width{};
+		int m_Height{};
+		bool m_IsEnabled{};
+
+		//SampleCount per pixel
+		std::vector<float> m_Depths{};
+		//The pixel's colour, or for a split pixel the index of its first sample in m_SampleColours
+		std::vector<HdrPixel> m_Colours{};
+		std::vector<uint8_t> m_IsSplit{};
+		std::vector<HdrPixel> m_SampleColours{};
+	};
+}
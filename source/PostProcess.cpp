@@ -0,0 +1,289 @@
+#include "pch.h"
+#include "PostProcess.h"
+#include "FastMath.h"
+#include "JobSystem.h"
+#include <bit>
+
+namespace dae
+{
+	namespace
+	{
+		//A tile and the apron FXAA reads around it, rows padded so every 8 lane load stays inside
+		constexpr int TileStride{ PostProcess::TileSize + 8 };
+		constexpr int TileRows{ PostProcess::TileSize + 2 * PostProcess::Reach };
+
+		//The colour stages' output for one tile, channels and luma in [0, 1]
+		struct TilePlanes
+		{
+			alignas(32) float red[TileStride * TileRows];
+			alignas(32) float green[TileStride * TileRows];
+			alignas(32) float blue[TileStride * TileRows];
+			alignas(32) float luma[TileStride * TileRows];
+		};
+
+		//8 consecutive pixels' half float channels into a float register per channel
+		void LoadPixels(const HdrPixel* pPixels, __m256& red, __m256& green, __m256& blue)
+		{
+			const __m256i first{ _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pPixels)) };
+			const __m256i second{ _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pPixels + 4)) };
+
+			//Two pixels (r, g, b, unused) per register, transposed within the 128 bit halves
+			const __m256 pixels01{ _mm256_cvtph_ps(_mm256_castsi256_si128(first)) };
+			const __m256 pixels23{ _mm256_cvtph_ps(_mm256_extracti128_si256(first, 1)) };
+			const __m256 pixels45{ _mm256_cvtph_ps(_mm256_castsi256_si128(second)) };
+			const __m256 pixels67{ _mm256_cvtph_ps(_mm256_extracti128_si256(second, 1)) };
+			const __m256 redGreen0{ _mm256_unpacklo_ps(pixels01, pixels23) };
+			const __m256 blue0{ _mm256_unpackhi_ps(pixels01, pixels23) };
+			const __m256 redGreen1{ _mm256_unpacklo_ps(pixels45, pixels67) };
+			const __m256 blue1{ _mm256_unpackhi_ps(pixels45, pixels67) };
+
+			//Lanes come out as pixels 0, 2, 4, 6, 1, 3, 5, 7
+			const __m256i order{ _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7) };
+			red = _mm256_permutevar8x32_ps(_mm256_shuffle_ps(redGreen0, redGreen1, _MM_SHUFFLE(1, 0, 1, 0)), order);
+			green = _mm256_permutevar8x32_ps(_mm256_shuffle_ps(redGreen0, redGreen1, _MM_SHUFFLE(3, 2, 3, 2)), order);
+			blue = _mm256_permutevar8x32_ps(_mm256_shuffle_ps(blue0, blue1, _MM_SHUFFLE(1, 0, 1, 0)), order);
+		}
+
+		__m256 Luma(__m256 red, __m256 green, __m256 blue)
+		{
+			return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(red, _mm256_set1_ps(0.299f)), _mm256_mul_ps(green, _mm256_set1_ps(0.587f))),
+				_mm256_mul_ps(blue, _mm256_set1_ps(0.114f)));
+		}
+
+		//Bilinear from the planes at an offset of at most a pixel from the pixels at the indices
+		//Only the offset is rounded, the result does not depend on where the tile lies in the frame
+		void SampleBilinear(const TilePlanes& planes, __m256i indices, __m256 offsetX, __m256 offsetY, __m256& red, __m256& green, __m256& blue)
+		{
+			const __m256 x0{ _mm256_floor_ps(offsetX) };
+			const __m256 y0{ _mm256_floor_ps(offsetY) };
+			const __m256 fractionX{ _mm256_sub_ps(offsetX, x0) };
+			const __m256 fractionY{ _mm256_sub_ps(offsetY, y0) };
+
+			//Clamped for the lanes past the tile's right edge, whose results are never stored
+			const __m256i topLeft{ _mm256_min_epi32(_mm256_add_epi32(indices, _mm256_add_epi32(_mm256_cvtps_epi32(x0), _mm256_mullo_epi32(_mm256_cvtps_epi32(y0), _mm256_set1_epi32(TileStride)))),
+				_mm256_set1_epi32(TileStride * (TileRows - 1) - 2)) };
+			const __m256i topRight{ _mm256_add_epi32(topLeft, _mm256_set1_epi32(1)) };
+			const __m256i bottomLeft{ _mm256_add_epi32(topLeft, _mm256_set1_epi32(TileStride)) };
+			const __m256i bottomRight{ _mm256_add_epi32(topLeft, _mm256_set1_epi32(TileStride + 1)) };
+
+			const auto sample{ [&](const float* pPlane)
+				{
+					const __m256 topLeftValue{ _mm256_i32gather_ps(pPlane, topLeft, 4) };
+					const __m256 bottomLeftValue{ _mm256_i32gather_ps(pPlane, bottomLeft, 4) };
+					const __m256 top{ _mm256_fmadd_ps(_mm256_sub_ps(_mm256_i32gather_ps(pPlane, topRight, 4), topLeftValue), fractionX, topLeftValue) };
+					const __m256 bottom{ _mm256_fmadd_ps(_mm256_sub_ps(_mm256_i32gather_ps(pPlane, bottomRight, 4), bottomLeftValue), fractionX, bottomLeftValue) };
+					return _mm256_fmadd_ps(_mm256_sub_ps(bottom, top), fractionY, top);
+				} };
+
+			red = sample(planes.red);
+			green = sample(planes.green);
+			blue = sample(planes.blue);
+		}
+	}
+
+	void PostProcess::SetSettings(const Settings& settings)
+	{
+		m_Settings = settings;
+	}
+
+	const PostProcess::Settings& PostProcess::GetSettings() const
+	{
+		return m_Settings;
+	}
+
+	int PostProcess::GetReach() const
+	{
+		return m_Settings.isAntiAliased ? Reach : 0;
+	}
+
+	void PostProcess::Apply(const HdrPixel* pSource, uint32_t* pDestination, int width, int height, int left, int top, int right, int bottom,
+		uint32_t redMask, uint32_t greenMask, uint32_t blueMask, uint32_t alphaMask) const
+	{
+		const int tileCountX{ (right - left + TileSize - 1) / TileSize };
+		const int tileCountY{ (bottom - top + TileSize - 1) / TileSize };
+		const int reach{ GetReach() };
+
+		//Where every channel goes in the destination's pixels and its largest value there
+		const uint32_t masks[]{ redMask, greenMask, blueMask };
+		__m128i shifts[3]{};
+		__m256 scales[3]{};
+		for (int channel{}; channel < 3; ++channel)
+		{
+			const int shift{ std::countr_zero(masks[channel]) };
+			shifts[channel] = _mm_cvtsi32_si128(shift);
+			scales[channel] = _mm256_set1_ps(static_cast<float>(masks[channel] >> shift));
+		}
+
+		JobSystem::GetInstance().ParallelFor(tileCountX * tileCountY, 1, [&](int begin, int end)
+			{
+				//One tile at a time per worker, never cleared: every value a tile reads was written for it first
+				thread_local TilePlanes planes{};
+
+				const __m256 exposure{ _mm256_set1_ps(m_Settings.exposure) };
+				const __m256 inverseWhiteSquared{ _mm256_set1_ps(1.0f / (m_Settings.whitePoint * m_Settings.whitePoint)) };
+				const __m256 one{ _mm256_set1_ps(1.0f) };
+				const __m256 zero{ _mm256_setzero_ps() };
+
+				for (int tile{ begin }; tile < end; ++tile)
+				{
+					const int tileLeft{ left + (tile % tileCountX) * TileSize };
+					const int tileTop{ top + (tile / tileCountX) * TileSize };
+					const int tileWidth{ std::min(TileSize, right - tileLeft) };
+					const int tileHeight{ std::min(TileSize, bottom - tileTop) };
+
+					//Colour stages over the tile and its apron, read from the frame clamped to its edges
+					for (int row{ Reach - reach }; row < Reach + tileHeight + reach; ++row)
+					{
+						const int sourceY{ std::clamp(tileTop + row - Reach, 0, height - 1) };
+						const HdrPixel* pSourceRow{ pSource + static_cast<size_t>(sourceY) * width };
+
+						for (int column{ Reach - reach }; column < Reach + tileWidth + reach; column += 8)
+						{
+							const int sourceX{ tileLeft + column - Reach };
+							__m256 channels[3]{};
+							if (sourceX >= 0 && sourceX + 8 <= width)
+							{
+								LoadPixels(pSourceRow + sourceX, channels[0], channels[1], channels[2]);
+							}
+							else
+							{
+								HdrPixel pixels[8]{};
+								for (int lane{}; lane < 8; ++lane)
+								{
+									pixels[lane] = pSourceRow[std::clamp(sourceX + lane, 0, width - 1)];
+								}
+								LoadPixels(pixels, channels[0], channels[1], channels[2]);
+							}
+
+							if (m_Settings.isToneMapped)
+							{
+								for (__m256& value : channels)
+								{
+									//c * (1 + c / white^2) / (1 + c)
+									value = _mm256_mul_ps(value, exposure);
+									value = _mm256_div_ps(_mm256_mul_ps(value, _mm256_fmadd_ps(value, inverseWhiteSquared, one)), _mm256_add_ps(value, one));
+								}
+							}
+							else
+							{
+								//Brought into range like MaxToOne, dividing by max(maxChannel, 1) keeps the hue
+								const __m256 scale{ _mm256_div_ps(exposure,
+									_mm256_max_ps(_mm256_mul_ps(_mm256_max_ps(_mm256_max_ps(channels[0], channels[1]), channels[2]), exposure), one)) };
+								for (__m256& value : channels)
+								{
+									value = _mm256_mul_ps(value, scale);
+								}
+							}
+
+							for (__m256& value : channels)
+							{
+								value = _mm256_min_ps(_mm256_max_ps(value, zero), one);
+
+								if (m_Settings.isSrgbEncoded)
+								{
+									const __m256 curve{ _mm256_fmsub_ps(FastMath::Pow<MathAccuracy::Fast>(_mm256_max_ps(value, _mm256_set1_ps(0.0031308f)), _mm256_set1_ps(1.0f / 2.4f)),
+										_mm256_set1_ps(1.055f), _mm256_set1_ps(0.055f)) };
+									value = _mm256_blendv_ps(_mm256_mul_ps(value, _mm256_set1_ps(12.92f)), curve, _mm256_cmp_ps(value, _mm256_set1_ps(0.0031308f), _CMP_GT_OQ));
+								}
+							}
+
+							const int index{ column + row * TileStride };
+							_mm256_storeu_ps(planes.red + index, channels[0]);
+							_mm256_storeu_ps(planes.green + index, channels[1]);
+							_mm256_storeu_ps(planes.blue + index, channels[2]);
+							_mm256_storeu_ps(planes.luma + index, Luma(channels[0], channels[1], channels[2]));
+						}
+					}
+
+					//FXAA (the console variant: diagonal neighbours, 4 taps along the edge) and packing into the destination
+					for (int row{}; row < tileHeight; ++row)
+					{
+						uint32_t* pDestinationRow{ pDestination + static_cast<size_t>(tileTop + row) * width + tileLeft };
+
+						for (int column{}; column < tileWidth; column += 8)
+						{
+							const int index{ (column + Reach) + (row + Reach) * TileStride };
+							__m256 red{ _mm256_loadu_ps(planes.red + index) };
+							__m256 green{ _mm256_loadu_ps(planes.green + index) };
+							__m256 blue{ _mm256_loadu_ps(planes.blue + index) };
+
+							if (m_Settings.isAntiAliased)
+							{
+								const __m256 lumaM{ _mm256_loadu_ps(planes.luma + index) };
+								const __m256 lumaNW{ _mm256_loadu_ps(planes.luma + index - TileStride - 1) };
+								const __m256 lumaNE{ _mm256_loadu_ps(planes.luma + index - TileStride + 1) };
+								const __m256 lumaSW{ _mm256_loadu_ps(planes.luma + index + TileStride - 1) };
+								const __m256 lumaSE{ _mm256_loadu_ps(planes.luma + index + TileStride + 1) };
+
+								const __m256 lumaMin{ _mm256_min_ps(lumaM, _mm256_min_ps(_mm256_min_ps(lumaNW, lumaNE), _mm256_min_ps(lumaSW, lumaSE))) };
+								const __m256 lumaMax{ _mm256_max_ps(lumaM, _mm256_max_ps(_mm256_max_ps(lumaNW, lumaNE), _mm256_max_ps(lumaSW, lumaSE))) };
+								const __m256 isEdge{ _mm256_cmp_ps(_mm256_sub_ps(lumaMax, lumaMin),
+									_mm256_max_ps(_mm256_set1_ps(EdgeThresholdMin), _mm256_mul_ps(lumaMax, _mm256_set1_ps(EdgeThreshold))), _CMP_GE_OQ) };
+
+								//Most runs of 8 have no edge, they keep their colour
+								if (_mm256_movemask_ps(isEdge) != 0)
+								{
+									//Across the luma gradient, which runs along the edge
+									const __m256 directionX{ _mm256_sub_ps(_mm256_add_ps(lumaSW, lumaSE), _mm256_add_ps(lumaNW, lumaNE)) };
+									const __m256 directionY{ _mm256_sub_ps(_mm256_add_ps(lumaNW, lumaSW), _mm256_add_ps(lumaNE, lumaSE)) };
+									const __m256 directionReduce{ _mm256_max_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(lumaNW, lumaNE), _mm256_add_ps(lumaSW, lumaSE)), _mm256_set1_ps(0.25f / 8.0f)),
+										_mm256_set1_ps(1.0f / 128.0f)) };
+									const __m256 absoluteMask{ _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF)) };
+									const __m256 inverseDirectionMin{ _mm256_div_ps(one, _mm256_add_ps(_mm256_min_ps(_mm256_and_ps(directionX, absoluteMask), _mm256_and_ps(directionY, absoluteMask)), directionReduce)) };
+									const __m256 span{ _mm256_set1_ps(2.0f) };
+									const __m256 stepX{ _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(directionX, inverseDirectionMin), _mm256_sub_ps(zero, span)), span) };
+									const __m256 stepY{ _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(directionY, inverseDirectionMin), _mm256_sub_ps(zero, span)), span) };
+
+									const __m256i indices{ _mm256_add_epi32(_mm256_set1_epi32(index), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)) };
+
+									__m256 tapRed[4]{}, tapGreen[4]{}, tapBlue[4]{};
+									const float tapDistances[4]{ -1.0f / 6.0f, 1.0f / 6.0f, -0.5f, 0.5f };
+									for (int tap{}; tap < 4; ++tap)
+									{
+										const __m256 distance{ _mm256_set1_ps(tapDistances[tap]) };
+										SampleBilinear(planes, indices, _mm256_mul_ps(stepX, distance), _mm256_mul_ps(stepY, distance), tapRed[tap], tapGreen[tap], tapBlue[tap]);
+									}
+
+									//Two close taps, and those with two far ones unless that overshoots the neighbourhood
+									const __m256 half{ _mm256_set1_ps(0.5f) };
+									const __m256 quarter{ _mm256_set1_ps(0.25f) };
+									const __m256 redA{ _mm256_mul_ps(_mm256_add_ps(tapRed[0], tapRed[1]), half) };
+									const __m256 greenA{ _mm256_mul_ps(_mm256_add_ps(tapGreen[0], tapGreen[1]), half) };
+									const __m256 blueA{ _mm256_mul_ps(_mm256_add_ps(tapBlue[0], tapBlue[1]), half) };
+									const __m256 redB{ _mm256_fmadd_ps(redA, half, _mm256_mul_ps(_mm256_add_ps(tapRed[2], tapRed[3]), quarter)) };
+									const __m256 greenB{ _mm256_fmadd_ps(greenA, half, _mm256_mul_ps(_mm256_add_ps(tapGreen[2], tapGreen[3]), quarter)) };
+									const __m256 blueB{ _mm256_fmadd_ps(blueA, half, _mm256_mul_ps(_mm256_add_ps(tapBlue[2], tapBlue[3]), quarter)) };
+
+									const __m256 lumaB{ Luma(redB, greenB, blueB) };
+									const __m256 isBInside{ _mm256_and_ps(_mm256_cmp_ps(lumaB, lumaMin, _CMP_GE_OQ), _mm256_cmp_ps(lumaB, lumaMax, _CMP_LE_OQ)) };
+
+									red = _mm256_blendv_ps(red, _mm256_blendv_ps(redA, redB, isBInside), isEdge);
+									green = _mm256_blendv_ps(green, _mm256_blendv_ps(greenA, greenB, isBInside), isEdge);
+									blue = _mm256_blendv_ps(blue, _mm256_blendv_ps(blueA, blueB, isBInside), isEdge);
+								}
+							}
+
+							//Rounded to the channel's bits and shifted into place
+							const auto pack{ [&](__m256 value, int channel)
+								{
+									return _mm256_sll_epi32(_mm256_cvtps_epi32(_mm256_mul_ps(value, scales[channel])), shifts[channel]);
+								} };
+							const __m256i pixels{ _mm256_or_si256(_mm256_or_si256(pack(red, 0), pack(green, 1)),
+								_mm256_or_si256(pack(blue, 2), _mm256_set1_epi32(static_cast<int>(alphaMask)))) };
+
+							const int count{ std::min(8, tileWidth - column) };
+							if (count == 8)
+							{
+								_mm256_storeu_si256(reinterpret_cast<__m256i*>(pDestinationRow + column), pixels);
+							}
+							else
+							{
+								const __m256i laneMask{ _mm256_cmpgt_epi32(_mm256_set1_epi32(count), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)) };
+								_mm256_maskstore_epi32(reinterpret_cast<int*>(pDestinationRow + column), laneMask, pixels);
+							}
+						}
+					}
+				}
+			});
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+#include "HdrPixel.h"
+
+namespace dae
+{
+	//Resolve and post-processing for the software rasterizer: exposure, tone mapping, sRGB encoding, FXAA and packing into
+	//the back buffer's format fused into one pass over tiles of the finished linear frame, so every pixel is written once
+	//and what FXAA reads around a pixel stays in the cache; with FXAA each tile also reads its Reach pixel apron,
+	//(36 / 32)^2 or about 1.27 reads per pixel, without it every pixel is read once
+	class PostProcess final
+	{
+	public:
+		//The defaults only pack the frame, colours brighter than one scaled down like MaxToOne
+		struct Settings
+		{
+			float exposure{ 1.0f };
+			//Extended Reinhard, the exposed value that maps to 1
+			float whitePoint{ 1.0f };
+			bool isToneMapped{ false };
+			bool isSrgbEncoded{ false };
+			bool isAntiAliased{ false };
+		};
+
+		static constexpr int TileSize{ 32 };
+		//Pixels FXAA reads around the one it filters: its taps reach a pixel along the edge, the bilinear filter one further
+		static constexpr int Reach{ 2 };
+		//FXAA: luma contrast below which a pixel is no edge, relative to its brightest neighbour and absolute
+		static constexpr float EdgeThreshold{ 0.125f };
+		static constexpr float EdgeThresholdMin{ 1.0f / 24.0f };
+
+		PostProcess() = default;
+
+		PostProcess(const PostProcess&) = delete;
+		PostProcess(PostProcess&&) noexcept = delete;
+		PostProcess& operator=(const PostProcess&) = delete;
+		PostProcess& operator=(PostProcess&&) noexcept = delete;
+
+		void SetSettings(const Settings& settings);
+		const Settings& GetSettings() const;
+		//Pixels around a rectangle whose output changes with it
+		int GetReach() const;
+
+		//Runs the chain over the rectangle, from pSource into pDestination (both width x height)
+		//The masks are the destination format's, every channel is scaled to its mask's bits; alphaMask is set in every pixel
+		void Apply(const HdrPixel* pSource, uint32_t* pDestination, int width, int height, int left, int top, int right, int bottom,
+			uint32_t redMask, uint32_t greenMask, uint32_t blueMask, uint32_t alphaMask) const;
+
+	private:
+		Settings m_Settings{};
+	};
+}
@@ -3,12 +3,18 @@
 #include "DataTypes.h"
 #include "Utils.h"
 #include "Mesh.h"
+#include "VirtualTexture.h"
+#include <random>
 
 namespace dae {
 
-	Renderer::Renderer(SDL_Window* pWindow) :
+	Renderer::Renderer(SDL_Window* pWindow, const RendererSettings& settings) :
 		m_pWindow(pWindow)
 		, m_ShadingMode{ShadingMode::Combined}
+		, m_Settings{ settings }
+		, m_GovernResolution{ settings.governResolution }
+		, m_ResolutionGovernor{ settings.frameBudgetMs / 1000.0f }
+		, m_PostProcessing{ settings.postProcessing }
 	{
 		SDL_GetWindowSize(pWindow, &m_Width, &m_Height);
 
@@ -19,12 +25,25 @@ namespace dae {
 		m_pCamera->Initialize((float)m_Width / (float)m_Height, 45.f, { 0.0f,0.0f,0.0f });
 
 		m_pSoftwareRenderer = new SoftwareRenderer(m_pWindow, m_pCamera, m_Width, m_Height, m_pMeshes);
+		m_pSoftwareRenderer->SetMathAccuracy(m_Settings.mathAccuracy);
+		m_pSoftwareRenderer->SetPostProcessSettings(PostProcess::Settings{ m_Settings.exposure, m_Settings.whitePoint, true, m_Settings.srgbOutput, true });
+
+		const char* accuracyNames[]{ "EXACT", "FAST", "FASTEST" };
+		std::cout << "\033[35m";
+		std::cout << "**(SOFTWARE) Shading math accuracy: " << accuracyNames[static_cast<int>(m_Settings.mathAccuracy)];
+		std::cout << '\n';
 		m_pHardwareRenderer = new HardwareRenderer(m_pWindow, m_pCamera, m_Width, m_Height, m_pMeshes);
+		ReleasePackedSourceMaps();
+
+		std::cout << "\033[33m";
+		std::cout << "**(SHARED) " << m_TextureRegistry.GetTextureCount() << " unique textures loaded, " << m_TextureRegistry.GetMemorySize() / (1024 * 1024) << " MiB of cpu memory";
+		std::cout << '\n';
 
 		std::cout << "\033[33m";
 		std::cout << "[Key Bindings - SHARED]\n";
 		std::cout << "\t[F1] Toggle Rasterizer Mode (HARDWARE/SOFTWARE)\n";
 		std::cout << "\t[F2] Toggle Vehicle Rotation (ON/OFF)\n";
+		std::cout << "\t[F4] Cycle Sampler State (POINT / BILINEAR / LINEAR / ANISOTROPIC)\n";
 		std::cout << "\t[F9] Cycle CullMode (BACK/FRONT/NONE)\n";
 		std::cout << "\t[F10] Toggle Uniform ClearColor (ON/OFF)\n";
 		std::cout << "\t[F11] Toggle Print FPS (ON/OFF)\n";
@@ -33,7 +52,6 @@ namespace dae {
 		std::cout << "\033[32m";
 		std::cout << "[Key Bindings - HARDWARE]\n";
 		std::cout << "\t[F3] Toggle FireFX (ON / OFF)\n";
-		std::cout << "\t[F4] Cycle Sampler State (POINT / LINEAR / ANISOTROPIC)\n";
 		std::cout << '\n';
 
 		std::cout << "\033[35m";
@@ -42,6 +60,22 @@ namespace dae {
 		std::cout << "\t[F6] Toggle NormalMap (ON / OFF\n";
 		std::cout << "\t[F7] Toggle DepthBuffer Visualization (ON / OFF)\n";
 		std::cout << "\t[F8] Toggle BoundingBox Visualization (ON / OFF)\n";
+		std::cout << "\t[A] Toggle Texture Addressing (WRAP / CLAMP)\n";
+		std::cout << "\t[T] Toggle Tangent Space Lighting (ON / OFF)\n";
+		std::cout << "\t[B] Toggle Batched Shading (ON / OFF)\n";
+		std::cout << "\t[I] Toggle Fixed Point Shading (ON / OFF)\n";
+		std::cout << "\t[L] Cycle Local Lights (0 / 16 / 256)\n";
+		std::cout << "\t[H] Toggle Shadows (ON / OFF)\n";
+		std::cout << "\t[K] Toggle Shading LOD (ON / OFF)\n";
+		std::cout << "\t[J] Toggle Shading LOD View (green FULL / yellow NO NORMAL MAP / red GOURAUD)\n";
+		std::cout << "\t[U] Toggle Texture Space Shading (ON / OFF)\n";
+		std::cout << "\t[O] Cycle Temporal Reuse (OFF / REFRESH EVERY 2 / REFRESH EVERY 4 FRAMES)\n";
+		std::cout << "\t[P] Toggle Dirty Regions, skipping unchanged frames and pixels (ON / OFF)\n";
+		std::cout << "\t[V] Toggle Coarse Shading, flat tiles shaded per 2x2 / 4x4 pixels (ON / OFF)\n";
+		std::cout << "\t[C] Toggle Checkerboard Rendering, half the pixels per frame (ON / OFF)\n";
+		std::cout << "\t[M] Toggle 4x MSAA (ON / OFF)\n";
+		std::cout << "\t[X] Toggle Post-Processing, exposure " << m_Settings.exposure << ", tone map to white at " << m_Settings.whitePoint << (m_Settings.srgbOutput ? ", sRGB and FXAA" : " and FXAA") << " (ON / OFF)\n";
+		std::cout << "\t[G] Toggle Resolution Governor, " << m_Settings.frameBudgetMs << " ms frame budget (ON / OFF)\n";
 		std::cout << "\033[0m";
 		std::cout << '\n';
 		std::cout << '\n';
@@ -52,22 +86,70 @@ namespace dae {
 		delete m_pHardwareRenderer;
 		delete m_pSoftwareRenderer;
 		delete m_pCamera;
-
-		for (auto& texture : m_pTextureMap)
-		{
-			delete texture.second;
-		}
 	}
 
 	void Renderer::Update(const Timer* pTimer)
 	{
 		if (m_UseSoftware)
 		{
-			m_pSoftwareRenderer->Update(pTimer, m_ShouldRotate, m_ShadingMode, m_ShowDepthBuffer, m_UniformColor, m_ShowBounding, m_RenderNormal, m_CullMode);
+			if (m_MultisampleReportDelay > 0 && --m_MultisampleReportDelay == 0 && m_Multisampling)
+			{
+				const int pixelCount{ m_pSoftwareRenderer->GetRenderWidth() * m_pSoftwareRenderer->GetRenderHeight() };
+				const size_t colourBytes{ m_pSoftwareRenderer->GetMultisampleColourMemorySize() };
+				std::cout << "\033[35m";
+				std::cout << "**(SOFTWARE) 4x MSAA memory: depth +" << m_pSoftwareRenderer->GetMultisampleDepthMemorySize() / 1024 << " KiB (4x the "
+					<< pixelCount * sizeof(float) / 1024 << " KiB depth buffer), colour +" << colourBytes / 1024 << " KiB ("
+					<< m_pSoftwareRenderer->GetMultisampleSplitPixelCount() << " of " << pixelCount << " pixels split into samples, sample colours in use, one slot per split pixel)";
+				std::cout << '\n';
+			}
+
+			//A skipped frame only waited, it says nothing about what rendering costs
+			if (m_GovernResolution && !m_pSoftwareRenderer->IsFrameSkipped() && m_ResolutionGovernor.Update(pTimer->GetElapsed()))
+			{
+				const float averageMs{ std::round(m_ResolutionGovernor.GetAverageFrameTime() * 10000.0f) / 10.0f };
+				const char* filterNames[]{ "POINT", "BILINEAR", "TRILINEAR" };
+				ApplyResolutionGovernor();
+				std::cout << "\033[35m";
+				std::cout << "**(SOFTWARE) Resolution Governor: " << averageMs << " ms against a "
+					<< m_Settings.frameBudgetMs << " ms budget, stepped " << (averageMs > m_Settings.frameBudgetMs ? "DOWN" : "UP") << " to ";
+				std::cout << m_pSoftwareRenderer->GetRenderWidth() << "x" << m_pSoftwareRenderer->GetRenderHeight() << ", shading LOD thresholds x"
+					<< m_ResolutionGovernor.GetShadingLodScale() << ", texture filter up to " << filterNames[static_cast<int>(m_ResolutionGovernor.GetTextureFilterLimit())];
+				std::cout << '\n';
+			}
+
+			SoftwareShadingSettings settings{};
+			settings.shouldRotate = m_ShouldRotate;
+			settings.shadingMode = m_ShadingMode;
+			settings.showDepthBuffer = m_ShowDepthBuffer;
+			settings.uniformColor = m_UniformColor;
+			settings.showBounding = m_ShowBounding;
+			settings.renderNormal = m_RenderNormal;
+			settings.cullMode = m_CullMode;
+			settings.sampleMode = m_SampleMode;
+			settings.addressMode = m_TextureAddressMode;
+			settings.tangentSpaceLighting = m_TangentSpaceLighting;
+			settings.batchedShading = m_BatchedShading;
+			settings.fixedPointShading = m_FixedPointShading;
+			settings.shadows = m_Shadows;
+			settings.shadingLod = m_ShadingLod;
+			settings.showShadingLod = m_ShowShadingLod;
+			settings.textureSpaceShading = m_TextureSpaceShading;
+			settings.temporalRefreshInterval = TemporalRefreshIntervals[m_TemporalRefreshIndex];
+			settings.dirtyRegions = m_DirtyRegions;
+			settings.coarseShading = m_CoarseShading;
+			settings.checkerboard = m_Checkerboard;
+			settings.multisampling = m_Multisampling;
+			settings.postProcessing = m_PostProcessing;
+			m_pSoftwareRenderer->Update(pTimer, settings);
+
+			if (m_FixedPointShading && (!m_FixedPointChecked || m_pSoftwareRenderer->GetShadingSettings() != m_FixedPointCheckedSettings))
+			{
+				ValidateFixedPointShading();
+			}
 		}
 		else
 		{
-			m_pHardwareRenderer->Update(pTimer, m_ShouldRotate, m_ShowFire, m_UniformColor, m_CullMode);
+			m_pHardwareRenderer->Update(pTimer, m_ShouldRotate, m_ShowFire, m_UniformColor, m_CullMode, m_SampleMode);
 		}
 	}
 
@@ -96,9 +178,21 @@ namespace dae {
 		return m_PrintFPS;
 	}
 
+	bool Renderer::HasPresentedFrame() const
+	{
+		return !m_UseSoftware || !m_pSoftwareRenderer->IsFrameSkipped();
+	}
+
+	void Renderer::InvalidateFrame()
+	{
+		m_pSoftwareRenderer->Invalidate();
+	}
+
 	void Renderer::ToggleRenderer()
 	{
 		m_UseSoftware = !m_UseSoftware;
+		//The hardware rasterizer drew over the window since the software one last presented
+		m_pSoftwareRenderer->Invalidate();
 		std::cout << "\033[33m";
 		m_UseSoftware ? std::cout << "**(SHARED) Rasterizer Mode = SOFTWARE" : std::cout << "**(SHARED) Rasterizer Mode = HARDWARE";
 		std::cout << '\n';
@@ -196,12 +290,280 @@ namespace dae {
 		}
 	}
 
+	void Renderer::ToggleTangentSpaceLighting()
+	{
+		if (m_UseSoftware)
+		{
+			m_TangentSpaceLighting = !m_TangentSpaceLighting;
+			std::cout << "\033[35m";
+			m_TangentSpaceLighting ? std::cout << "**(SOFTWARE) Tangent Space Lighting ON" : std::cout << "**(SOFTWARE) Tangent Space Lighting OFF";
+			std::cout << '\n';
+		}
+	}
+
+	void Renderer::ToggleBatchedShading()
+	{
+		if (m_UseSoftware)
+		{
+			m_BatchedShading = !m_BatchedShading;
+			std::cout << "\033[35m";
+			m_BatchedShading ? std::cout << "**(SOFTWARE) Batched Shading ON" : std::cout << "**(SOFTWARE) Batched Shading OFF";
+			std::cout << '\n';
+		}
+	}
+
+	void Renderer::ToggleFixedPointShading()
+	{
+		if (m_UseSoftware)
+		{
+			m_FixedPointShading = !m_FixedPointShading;
+
+			//Checked by the next update, once the software rasterizer holds the settings it will render with
+			m_FixedPointChecked = false;
+
+			if (!m_FixedPointShading)
+			{
+				std::cout << "\033[35m";
+				std::cout << "**(SOFTWARE) Fixed Point Shading OFF";
+				std::cout << '\n';
+			}
+		}
+	}
+
+	void Renderer::CycleLocalLights()
+	{
+		if (m_UseSoftware)
+		{
+			constexpr int lightCounts[]{ 0, 16, 256 };
+			m_LocalLightCountIndex = (m_LocalLightCountIndex + 1) % static_cast<int>(std::size(lightCounts));
+			const int lightCount{ lightCounts[m_LocalLightCountIndex] };
+
+			//Same lights every time, scattered around the vehicle, every fourth one a spot light shining down
+			std::mt19937 random{ 1 };
+			std::uniform_real_distribution<float> horizontal{ -25.0f, 25.0f };
+			std::uniform_real_distribution<float> vertical{ -2.0f, 12.0f };
+			std::uniform_real_distribution<float> unit{ 0.0f, 1.0f };
+
+			m_pSoftwareRenderer->ClearLights();
+			for (int i{}; i < lightCount; ++i)
+			{
+				Light light{};
+				light.type = i % 4 == 3 ? LightType::Spot : LightType::Point;
+				light.position = Vector3{ horizontal(random), vertical(random), 50.0f + horizontal(random) };
+				light.color = ColorRGB{ unit(random), unit(random), unit(random) };
+				light.intensity = 40.0f + 40.0f * unit(random);
+				light.range = 6.0f + 8.0f * unit(random);
+				light.innerConeCos = 0.9f;
+				light.outerConeCos = 0.7f;
+				m_pSoftwareRenderer->AddLight(light);
+			}
+
+			std::cout << "\033[35m";
+			std::cout << "**(SOFTWARE) Local Lights: " << lightCount;
+			std::cout << '\n';
+		}
+	}
+
+	void Renderer::ToggleShadows()
+	{
+		if (m_UseSoftware)
+		{
+			m_Shadows = !m_Shadows;
+			std::cout << "\033[35m";
+			m_Shadows ? std::cout << "**(SOFTWARE) Shadows ON" : std::cout << "**(SOFTWARE) Shadows OFF";
+			std::cout << '\n';
+		}
+	}
+
+	void Renderer::ToggleShadingLod()
+	{
+		if (m_UseSoftware)
+		{
+			m_ShadingLod = !m_ShadingLod;
+			std::cout << "\033[35m";
+			m_ShadingLod ? std::cout << "**(SOFTWARE) Shading LOD ON" : std::cout << "**(SOFTWARE) Shading LOD OFF";
+			std::cout << '\n';
+		}
+	}
+
+	void Renderer::ToggleShadingLodView()
+	{
+		if (m_UseSoftware)
+		{
+			m_ShowShadingLod = !m_ShowShadingLod;
+			std::cout << "\033[35m";
+			m_ShowShadingLod ? std::cout << "**(SOFTWARE) Shading LOD View ON" : std::cout << "**(SOFTWARE) Shading LOD View OFF";
+
+			//Picked in the last update, from the size the vehicle had on screen then
+			constexpr const char* lodNames[]{ "FULL", "NO NORMAL MAP", "GOURAUD" };
+			std::cout << " (current " << lodNames[static_cast<int>(m_pSoftwareRenderer->GetShadingLod())] << ", " << m_pSoftwareRenderer->GetProjectedSize() << " px)";
+			std::cout << '\n';
+		}
+	}
+
+	void Renderer::ToggleTextureSpaceShading()
+	{
+		if (m_UseSoftware)
+		{
+			m_TextureSpaceShading = !m_TextureSpaceShading;
+			std::cout << "\033[35m";
+			m_TextureSpaceShading ? std::cout << "**(SOFTWARE) Texture Space Shading ON" : std::cout << "**(SOFTWARE) Texture Space Shading OFF";
+			std::cout << '\n';
+		}
+	}
+
+	void Renderer::CycleTemporalReuse()
+	{
+		if (m_UseSoftware)
+		{
+			m_TemporalRefreshIndex = (m_TemporalRefreshIndex + 1) % static_cast<int>(std::size(TemporalRefreshIntervals));
+			const int refreshInterval{ TemporalRefreshIntervals[m_TemporalRefreshIndex] };
+
+			std::cout << "\033[35m";
+			refreshInterval > 0 ? std::cout << "**(SOFTWARE) Temporal Reuse ON, every pixel shaded at least every " << refreshInterval << " frames" : std::cout << "**(SOFTWARE) Temporal Reuse OFF";
+			std::cout << '\n';
+		}
+	}
+
+	void Renderer::ToggleDirtyRegions()
+	{
+		if (m_UseSoftware)
+		{
+			m_DirtyRegions = !m_DirtyRegions;
+			std::cout << "\033[35m";
+			m_DirtyRegions ? std::cout << "**(SOFTWARE) Dirty Regions ON" : std::cout << "**(SOFTWARE) Dirty Regions OFF";
+			std::cout << '\n';
+		}
+	}
+
+	void Renderer::ToggleCoarseShading()
+	{
+		if (m_UseSoftware)
+		{
+			m_CoarseShading = !m_CoarseShading;
+			std::cout << "\033[35m";
+			m_CoarseShading ? std::cout << "**(SOFTWARE) Coarse Shading ON" : std::cout << "**(SOFTWARE) Coarse Shading OFF";
+			std::cout << '\n';
+		}
+	}
+
+	void Renderer::ToggleCheckerboard()
+	{
+		if (m_UseSoftware)
+		{
+			m_Checkerboard = !m_Checkerboard;
+			std::cout << "\033[35m";
+			m_Checkerboard ? std::cout << "**(SOFTWARE) Checkerboard Rendering ON" : std::cout << "**(SOFTWARE) Checkerboard Rendering OFF";
+			std::cout << '\n';
+		}
+	}
+
+	void Renderer::ToggleResolutionGovernor()
+	{
+		if (m_UseSoftware)
+		{
+			m_GovernResolution = !m_GovernResolution;
+			//Off renders at full quality again, on starts from it
+			m_ResolutionGovernor.Reset();
+			ApplyResolutionGovernor();
+			std::cout << "\033[35m";
+			m_GovernResolution ? std::cout << "**(SOFTWARE) Resolution Governor ON" : std::cout << "**(SOFTWARE) Resolution Governor OFF";
+			std::cout << '\n';
+		}
+	}
+
+	void Renderer::ToggleMultisampling()
+	{
+		if (m_UseSoftware)
+		{
+			m_Multisampling = !m_Multisampling;
+			m_MultisampleReportDelay = m_Multisampling ? 2 : 0;
+			std::cout << "\033[35m";
+			m_Multisampling ? std::cout << "**(SOFTWARE) 4x MSAA ON" : std::cout << "**(SOFTWARE) 4x MSAA OFF";
+			std::cout << '\n';
+		}
+	}
+
+	void Renderer::TogglePostProcessing()
+	{
+		if (m_UseSoftware)
+		{
+			m_PostProcessing = !m_PostProcessing;
+			std::cout << "\033[35m";
+			m_PostProcessing ? std::cout << "**(SOFTWARE) Post-Processing ON" : std::cout << "**(SOFTWARE) Post-Processing OFF";
+			std::cout << '\n';
+		}
+	}
+
+	void Renderer::ApplyResolutionGovernor()
+	{
+		const float lodScale{ m_ResolutionGovernor.GetShadingLodScale() };
+		m_pSoftwareRenderer->SetRenderScale(m_ResolutionGovernor.GetRenderScale());
+		m_pSoftwareRenderer->SetShadingLodThresholds(SoftwareRenderer::DefaultNoNormalMapLodSize * lodScale, SoftwareRenderer::DefaultGouraudLodSize * lodScale);
+		m_pSoftwareRenderer->SetTextureFilterLimit(m_ResolutionGovernor.GetTextureFilterLimit());
+	}
+
+	void Renderer::ValidateFixedPointShading()
+	{
+		m_FixedPointChecked = true;
+		m_FixedPointCheckedSettings = m_pSoftwareRenderer->GetShadingSettings();
+
+		std::cout << "\033[35m";
+
+		//Only keep it when the current view still looks like the float shading
+		float psnr{};
+		if (!m_pSoftwareRenderer->MeasureFixedPointPSNR(psnr))
+		{
+			std::cout << "**(SOFTWARE) Fixed Point Shading PENDING (the current settings shade in float, checked once they change)";
+			std::cout << '\n';
+			return;
+		}
+
+		m_FixedPointShading = psnr >= SoftwareRenderer::FixedPointMinPSNR;
+		m_pSoftwareRenderer->SetFixedPointShading(m_FixedPointShading);
+
+		m_FixedPointShading ? std::cout << "**(SOFTWARE) Fixed Point Shading ON" : std::cout << "**(SOFTWARE) Fixed Point Shading REJECTED";
+		std::cout << " (PSNR " << psnr << " dB against float, minimum " << SoftwareRenderer::FixedPointMinPSNR << " dB)";
+		std::cout << '\n';
+	}
+
 	void Renderer::ToggleSampleMode()
 	{
-		if (!m_UseSoftware)
+		std::cout << "\033[33m";
+
+		//The software sampler has no anisotropic filter, it falls back to trilinear for that mode
+		switch (m_SampleMode)
 		{
-			m_pHardwareRenderer->ToggleSampleState();
+		case dae::SampleMode::Point:
+			m_SampleMode = SampleMode::Bilinear;
+			std::cout << "**(SHARED) Sampler Filter = BILINEAR";
+			break;
+		case dae::SampleMode::Bilinear:
+			m_SampleMode = SampleMode::Linear;
+			std::cout << "**(SHARED) Sampler Filter = LINEAR";
+			break;
+		case dae::SampleMode::Linear:
+			m_SampleMode = SampleMode::Anisotropic;
+			std::cout << "**(SHARED) Sampler Filter = ANISOTROPIC";
+			break;
+		case dae::SampleMode::Anisotropic:
+			m_SampleMode = SampleMode::Point;
+			std::cout << "**(SHARED) Sampler Filter = POINT";
+			break;
+		default:
+			break;
 		}
+
+		std::cout << '\n';
+	}
+
+	void Renderer::ToggleTextureAddressing()
+	{
+		m_TextureAddressMode = m_TextureAddressMode == TextureAddressMode::Wrap ? TextureAddressMode::Clamp : TextureAddressMode::Wrap;
+
+		std::cout << "\033[35m";
+		std::cout << "**(SOFTWARE) Texture Addressing = " << (m_TextureAddressMode == TextureAddressMode::Wrap ? "WRAP" : "CLAMP");
+		std::cout << '\n';
 	}
 
 	void Renderer::ToggleCulling()
@@ -245,14 +607,78 @@ namespace dae {
 		pMesh->worldMatrix = pMesh->scaleMatrix * pMesh->rotationMatrix * pMesh->transformMatrix;
 		pMesh->primitiveTopology = PrimitiveTopology::TriangleList;
 
-		pMesh->m_pTextureMap.insert(std::make_pair("DiffuseMap", Texture::LoadFromFile("Resources/vehicle_diffuse.png")));
-		pMesh->m_pTextureMap.insert(std::make_pair("NormalMap", Texture::LoadFromFile("Resources/vehicle_normal.png")));
-		pMesh->m_pTextureMap.insert(std::make_pair("SpecularMap", Texture::LoadFromFile("Resources/vehicle_specular.png")));
-		pMesh->m_pTextureMap.insert(std::make_pair("GlossyMap", Texture::LoadFromFile("Resources/vehicle_gloss.png")));
+		const TextureFormat colorFormat{ m_Settings.compressTextures ? TextureFormat::BC1 : TextureFormat::RGBA8 };
+		const TextureFormat normalFormat{ m_Settings.compressTextures ? TextureFormat::BC5 : TextureFormat::NormalSNorm8 };
+		const TextureFormat scalarFormat{ m_Settings.compressTextures ? TextureFormat::BC4 : TextureFormat::R8 };
+
+		Material& material{ pMesh->material };
+		material.pDiffuseMap = m_TextureRegistry.Load("Resources/vehicle_diffuse.png", colorFormat, TextureLayout::Tiled4x4);
+		material.pNormalMap = m_TextureRegistry.Load("Resources/vehicle_normal.png", normalFormat, TextureLayout::Tiled4x4);
+		material.pSpecularMap = m_TextureRegistry.Load("Resources/vehicle_specular.png", scalarFormat, TextureLayout::Tiled4x4);
+		material.pGlossyMap = m_TextureRegistry.Load("Resources/vehicle_gloss.png", scalarFormat, TextureLayout::Tiled4x4);
+
+		//The software rasterizer fetches all four maps at once from an interleaved copy
+		//Compressed and virtual maps are sampled separately instead, an uncompressed packed copy would undo the memory savings
+		if (!m_Settings.compressTextures && !m_Settings.useVirtualTextures)
+		{
+			material.pPackedMap = m_TextureRegistry.LoadPackedMaterial("Resources/vehicle_diffuse.png", "Resources/vehicle_normal.png",
+				"Resources/vehicle_gloss.png", "Resources/vehicle_specular.png", TextureLayout::Tiled4x4);
+		}
+
+		//The page file is baked once and again whenever the image changed, other runs stream straight from it
+		if (m_Settings.useVirtualTextures)
+		{
+			const std::string imagePath{ "Resources/vehicle_diffuse.png" };
+			const std::string pageFilePath{ "Resources/vehicle_diffuse.vtex" };
+			if (!VirtualTexture::IsBakeCurrent(imagePath, pageFilePath))
+			{
+				VirtualTexture::Bake(imagePath, pageFilePath);
+			}
+
+			material.pVirtualDiffuseMap = std::make_unique<VirtualTexture>(pageFilePath, m_Settings.virtualTextureBudget);
+
+			std::cout << "\033[35m";
+			std::cout << "**(SOFTWARE) Virtual DiffuseMap: " << material.pVirtualDiffuseMap->GetPageCount() << " pages, budget "
+				<< material.pVirtualDiffuseMap->GetBudgetBytes() / (1024 * 1024) << " MiB";
+			std::cout << '\n';
+		}
+
+		std::cout << "\033[33m";
+		std::cout << "**(SHARED) Vehicle textures use " << material.GetMemorySize() / (1024 * 1024) << " MiB of cpu memory" << (m_Settings.compressTextures ? " (BLOCK COMPRESSED)" : "");
+		std::cout << '\n';
 
 		m_pMeshes.push_back(pMesh);
 	}
 
+	void Renderer::ReleasePackedSourceMaps()
+	{
+		//The software rasterizer samples the packed copy instead of them, the effects sample the uploaded copies
+		for (MeshData* pMesh : m_pMeshes)
+		{
+			const Material& material{ pMesh->material };
+			if (!material.pPackedMap)
+			{
+				continue;
+			}
+
+			//Only maps this material owns alone are freed, and they leave the registry first so a later load of the same file gets its texels back
+			size_t releasedSize{};
+			for (const std::shared_ptr<Texture>* pMap : { &material.pDiffuseMap, &material.pNormalMap, &material.pSpecularMap, &material.pGlossyMap })
+			{
+				if (*pMap && pMap->use_count() == 1)
+				{
+					m_TextureRegistry.Evict(pMap->get());
+					releasedSize += (*pMap)->GetMemorySize();
+					(*pMap)->ReleaseTexels();
+				}
+			}
+
+			std::cout << "\033[35m";
+			std::cout << "**(SOFTWARE) Packed material built, its source maps' " << releasedSize / (1024 * 1024) << " MiB of cpu memory released";
+			std::cout << '\n';
+		}
+	}
+
 	void Renderer::LoadThrusterOBJ()
 	{
 		std::vector<Vertex_In> vertices{};
@@ -269,7 +695,7 @@ namespace dae {
 		pMesh->worldMatrix = pMesh->scaleMatrix * pMesh->rotationMatrix * pMesh->transformMatrix;
 		pMesh->primitiveTopology = PrimitiveTopology::TriangleList;
 
-		pMesh->m_pTextureMap.insert(std::make_pair("fireFX", Texture::LoadFromFile("Resources/fireFX_diffuse.png")));
+		pMesh->material.pDiffuseMap = m_TextureRegistry.Load("Resources/fireFX_diffuse.png");
 
 		m_pMeshes.push_back(pMesh);
 	}
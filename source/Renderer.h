@@ -4,6 +4,8 @@
 #include "HardwareRenderer.h"
 #include <map>
 #include "Texture.h"
+#include "TextureRegistry.h"
+#include "ResolutionGovernor.h"
 
 
 struct SDL_Window;
@@ -11,10 +13,27 @@ struct SDL_Surface;
 
 namespace dae
 {
+	//Startup options, filled in from the command line
+	struct RendererSettings
+	{
+		bool compressTextures{ false };					//--compressed-textures, vehicle maps stored as BC1/BC4/BC5
+		bool useVirtualTextures{ false };				//--virtual-textures, software diffuse streamed from a page file
+		size_t virtualTextureBudget{ 8 * 1024 * 1024 };	//--virtual-texture-budget=<MiB>
+		MathAccuracy mathAccuracy{ MathAccuracy::Fast };	//--math-accuracy=exact|fast|fastest, pow and normalize in the software shading
+		float frameBudgetMs{ 16.6f };					//--frame-budget=<ms>, what the resolution governor holds the software frame time to
+		bool governResolution{ false };					//Starts the governor, set by --frame-budget
+		float exposure{ 1.0f };							//--exposure=<multiplier>, applied by the software post-processing before tone mapping
+		float whitePoint{ 2.0f };						//--white-point=<linear>, the exposed linear value the software tone mapping takes to white
+		bool srgbOutput{ false };						//--srgb-output, the software post-processing encodes the frame to sRGB
+		bool postProcessing{ false };					//Starts the software post-processing, set by --exposure, --white-point and --srgb-output
+		//With the post-processing off the software frame is written out linear, as the hardware one: colours brighter than one are
+		//scaled down like MaxToOne and packed, without exposure, tone mapping or sRGB encoding
+	};
+
 	class Renderer final
 	{
 	public:
-		Renderer(SDL_Window* pWindow);
+		Renderer(SDL_Window* pWindow, const RendererSettings& settings = {});
 		~Renderer();
 
 		Renderer(const Renderer&) = delete;
@@ -27,6 +46,10 @@ namespace dae
 
 		void ToggleFPS();
 		bool ShouldPrintFPS() const;
+		//False when the software rasterizer found nothing changed and kept the last frame on screen
+		bool HasPresentedFrame() const;
+		//Everything is drawn again next frame, for when the window lost its contents
+		void InvalidateFrame();
 
 		void ToggleRenderer();
 		void ToggleShadingMode();
@@ -37,14 +60,39 @@ namespace dae
 		void ToggleBounding();
 		void ToggleNormal();
 		void ToggleSampleMode();
+		void ToggleTextureAddressing();
 		void ToggleCulling();
+		void ToggleTangentSpaceLighting();
+		void ToggleBatchedShading();
+		void ToggleFixedPointShading();
+		void CycleLocalLights();
+		void ToggleShadows();
+		void ToggleShadingLod();
+		void ToggleShadingLodView();
+		void ToggleTextureSpaceShading();
+		void CycleTemporalReuse();
+		void ToggleDirtyRegions();
+		void ToggleCoarseShading();
+		void ToggleCheckerboard();
+		void ToggleResolutionGovernor();
+		void ToggleMultisampling();
+		void TogglePostProcessing();
 
 	private:
 		void LoadVehicleOBJ();
 		void LoadThrusterOBJ();
+		//Once the effects have their copies, the maps a packed material was built from are only read on the gpu
+		void ReleasePackedSourceMaps();
+		//Hands the governor's current step to the software rasterizer
+		void ApplyResolutionGovernor();
+		//Compares the fixed point shading against float for the current settings, turns it off when it falls short
+		void ValidateFixedPointShading();
 		
 		ShadingMode m_ShadingMode{};
 		CullMode m_CullMode{};
+		SampleMode m_SampleMode{};
+		//Software only, the effects always wrap
+		TextureAddressMode m_TextureAddressMode{};
 
 		SDL_Window* m_pWindow{};
 
@@ -52,6 +100,7 @@ namespace dae
 		int m_Height{};
 
 		bool m_IsInitialized{ false };
+		RendererSettings m_Settings{};
 
 		bool m_PrintFPS{ false };
 
@@ -62,6 +111,29 @@ namespace dae
 		bool m_UniformColor{ false };
 		bool m_ShowBounding{ false };
 		bool m_RenderNormal{ true };
+		bool m_TangentSpaceLighting{ true };
+		bool m_BatchedShading{ true };
+		bool m_FixedPointShading{ false };
+		//Shading settings the fixed point shading was last checked under, any other settings check it again
+		bool m_FixedPointChecked{ false };
+		uint32_t m_FixedPointCheckedSettings{};
+		int m_LocalLightCountIndex{};
+		bool m_Shadows{ true };
+		bool m_ShadingLod{ true };
+		bool m_ShowShadingLod{ false };
+		bool m_TextureSpaceShading{ false };
+		//Frames between two shadings of a pixel with temporal reuse, 0 is off
+		static constexpr int TemporalRefreshIntervals[]{ 0, 2, 4 };
+		int m_TemporalRefreshIndex{};
+		bool m_DirtyRegions{ true };
+		bool m_CoarseShading{ false };
+		bool m_Checkerboard{ false };
+		bool m_GovernResolution{ false };
+		bool m_Multisampling{ false };
+		//Updates until the first frame with multisampling has been rendered and its memory can be reported
+		int m_MultisampleReportDelay{};
+		ResolutionGovernor m_ResolutionGovernor;
+		bool m_PostProcessing{ false };
 
 		Camera* m_pCamera{};
 
@@ -70,7 +142,8 @@ namespace dae
 
 		std::vector<MeshData*> m_pMeshes{};
 
-		std::map<std::string, Texture*> m_pTextureMap{};
+		//Loads every texture file once, the meshes keep them alive through the handles it returns
+		TextureRegistry m_TextureRegistry{};
 
 		//DIRECTX
 		//HRESULT InitializeDirectX();
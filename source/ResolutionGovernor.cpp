@@ -0,0 +1,80 @@
+#include "pch.h"
+#include "ResolutionGovernor.h"
+
+namespace dae
+{
+	ResolutionGovernor::ResolutionGovernor(float frameBudget)
+		: m_FrameBudget{ frameBudget }
+	{
+	}
+
+	bool ResolutionGovernor::Update(float frameTime)
+	{
+		if (m_SettleCount > 0)
+		{
+			--m_SettleCount;
+			return false;
+		}
+
+		m_FrameTimeSum += frameTime;
+		if (++m_FrameCount < WindowFrames)
+		{
+			return false;
+		}
+
+		m_AverageFrameTime = m_FrameTimeSum / m_FrameCount;
+		m_FrameTimeSum = 0.0f;
+		m_FrameCount = 0;
+
+		const int previousStep{ m_Step };
+		if (m_AverageFrameTime > m_FrameBudget * StepDownRatio)
+		{
+			m_Step = std::min(m_Step + 1, StepCount - 1);
+		}
+		else if (m_AverageFrameTime < m_FrameBudget * StepUpRatio)
+		{
+			m_Step = std::max(m_Step - 1, 0);
+		}
+
+		if (m_Step == previousStep)
+		{
+			return false;
+		}
+
+		m_SettleCount = SettleFrames;
+		return true;
+	}
+
+	void ResolutionGovernor::Reset()
+	{
+		m_Step = 0;
+		m_FrameTimeSum = 0.0f;
+		m_FrameCount = 0;
+		m_SettleCount = 0;
+	}
+
+	float ResolutionGovernor::GetRenderScale() const
+	{
+		return Steps[m_Step].renderScale;
+	}
+
+	float ResolutionGovernor::GetShadingLodScale() const
+	{
+		return Steps[m_Step].shadingLodScale;
+	}
+
+	TextureFilter ResolutionGovernor::GetTextureFilterLimit() const
+	{
+		return Steps[m_Step].textureFilterLimit;
+	}
+
+	float ResolutionGovernor::GetFrameBudget() const
+	{
+		return m_FrameBudget;
+	}
+
+	float ResolutionGovernor::GetAverageFrameTime() const
+	{
+		return m_AverageFrameTime;
+	}
+}
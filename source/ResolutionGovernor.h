@@ -0,0 +1,72 @@
+#pragma once
+#include "DataTypes.h"
+
+namespace dae
+{
+	//Holds the software rasterizer's frame time to a budget: steps down the quality while the average frame time is over it
+	//and back up while it is well under it, first the render resolution, below half of it the shading LOD, then the texture filter
+	class ResolutionGovernor final
+	{
+	public:
+		//Frames averaged for one decision
+		static constexpr int WindowFrames{ 15 };
+		//Frames ignored after a step, they re-render in full and rebuild the histories
+		static constexpr int SettleFrames{ 5 };
+		//Steps down above budget * StepDownRatio, up below budget * StepUpRatio; the gap keeps it from swinging between two steps
+		static constexpr float StepDownRatio{ 1.05f };
+		static constexpr float StepUpRatio{ 0.75f };
+
+		//Budget in seconds
+		explicit ResolutionGovernor(float frameBudget);
+
+		ResolutionGovernor(const ResolutionGovernor&) = delete;
+		ResolutionGovernor(ResolutionGovernor&&) noexcept = delete;
+		ResolutionGovernor& operator=(const ResolutionGovernor&) = delete;
+		ResolutionGovernor& operator=(ResolutionGovernor&&) noexcept = delete;
+
+		//Takes the time (seconds) of a rendered frame, true when it stepped
+		bool Update(float frameTime);
+		//Back to full quality
+		void Reset();
+
+		float GetRenderScale() const;
+		//Multiplier for the shading LOD thresholds, the cheaper shading kicks in at that many times the projected size
+		float GetShadingLodScale() const;
+		TextureFilter GetTextureFilterLimit() const;
+
+		float GetFrameBudget() const;
+		//Average of the window the last decision was made on
+		float GetAverageFrameTime() const;
+
+	private:
+		struct Step
+		{
+			float renderScale;
+			float shadingLodScale;
+			TextureFilter textureFilterLimit;
+		};
+
+		//Cheapest last
+		static constexpr Step Steps[]
+		{
+			{ 1.0f, 1.0f, TextureFilter::Trilinear },
+			{ 0.875f, 1.0f, TextureFilter::Trilinear },
+			{ 0.75f, 1.0f, TextureFilter::Trilinear },
+			{ 0.625f, 1.0f, TextureFilter::Trilinear },
+			{ 0.5f, 1.0f, TextureFilter::Trilinear },
+			{ 0.5f, 2.0f, TextureFilter::Trilinear },
+			{ 0.5f, 2.0f, TextureFilter::Bilinear },
+			{ 0.5f, 4.0f, TextureFilter::Bilinear },
+			{ 0.5f, 4.0f, TextureFilter::Point }
+		};
+		static constexpr int StepCount{ sizeof(Steps) / sizeof(Steps[0]) };
+
+		float m_FrameBudget{};
+		int m_Step{};
+
+		float m_FrameTimeSum{};
+		int m_FrameCount{};
+		int m_SettleCount{};
+		float m_AverageFrameTime{};
+	};
+}
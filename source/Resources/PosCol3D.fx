@@ -10,11 +10,13 @@ float4x4 gWorld: WORLD;
 SamplerState gSamplerState: ExternalSamplerState;
 RasterizerState gRasterizerState: ExternalRasterizerState;
 
+// Material constants, the defaults are overwritten by Effect::SetMaterial
+float gLightIntensity: LightIntensity = float(7.0);
+float gShininess: Shininess = float(25.0);
+float3 gAmbient: Ambient = float3(0.025, 0.025, 0.025);
+
 // Constants
 float PI = float(3.14159);
-float INTENSITY = float(7.0);
-float SHININESS = float(25.0);
-float3 AMBIENT = float3(0.025, 0.025, 0.025);
 
 BlendState gBlendState
 {
@@ -101,8 +103,10 @@ float4 PS(VS_OUTPUT input): SV_TARGET
 {
 	float3 binormal = normalize(cross(input.Normal, input.Tangent));
 	float3x3 tangentSpaceAxis = float3x3(normalize(input.Tangent), binormal, normalize(input.Normal));
-	float3 normalMapSample = gNormalMap.Sample(gSamplerState, input.Uv).xyz;
-	float3 mappedNormal = 2.f * normalMapSample - 1.f;
+	// The normal map is uploaded as snorm, it is already in [-1, 1]
+	// z is rebuilt from x and y, BC5 normal maps only store those two
+	float3 mappedNormal = gNormalMap.Sample(gSamplerState, input.Uv).xyz;
+	mappedNormal.z = sqrt(saturate(1.f - dot(mappedNormal.xy, mappedNormal.xy)));
 	float3 tangentSpaceNormal = normalize(mul(mappedNormal, tangentSpaceAxis));
 
 	float observedArea = dot(tangentSpaceNormal, -gLightDir);
@@ -114,12 +118,12 @@ float4 PS(VS_OUTPUT input): SV_TARGET
 	float3 glossinessMapSample = gGlossinessMap.Sample(gSamplerState, input.Uv).xyz;
 	float3 diffuseMapSample = gDiffuseMap.Sample(gSamplerState, input.Uv).xyz;
 
-	float phongValue = CalculatePhong(specularMapSample, glossinessMapSample.x * SHININESS, gLightDir, viewDirection, tangentSpaceNormal);
+	float phongValue = CalculatePhong(specularMapSample, glossinessMapSample.x * gShininess, gLightDir, viewDirection, tangentSpaceNormal);
 	float3 diffuse = CalculateLambert(1.f, diffuseMapSample);
 
 	// ((diffuse * int) + phong + ambient) * obser
 	//float3 finalColor = INTENSITY * (AMBIENT + diffuse + phongValue) * observedArea;
-	float3 finalColor = ((diffuse * INTENSITY) + phongValue + AMBIENT) * observedArea;
+	float3 finalColor = ((diffuse * gLightIntensity) + phongValue + gAmbient) * observedArea;
 
 	return float4(finalColor, 1);
 }
@@ -0,0 +1,309 @@
+#include "pch.h"
+#include "ShadingAtlas.h"
+#include "JobSystem.h"
+#include "Mesh.h"
+#include <cassert>
+
+namespace dae
+{
+	ShadingAtlas::ShadingAtlas(int size)
+		: m_Size{ size }
+		, m_TilesPerRow{ size / TileSize }
+	{
+		//Sample wraps with a mask and the tiles have to fit the rows exactly
+		assert(size >= TileSize && (size & (size - 1)) == 0 && "ERROR: the shading atlas size is not a power of two!");
+	}
+
+	void ShadingAtlas::Bake(const MeshData& mesh)
+	{
+		const size_t texelCount{ static_cast<size_t>(m_Size) * m_Size };
+		m_Texels.assign(texelCount, Texel{});
+		m_IsCovered.assign(texelCount, 0);
+		m_Colours.assign(texelCount, ColorRGB{});
+
+		//Texels whose centre lies in a uv triangle, either winding, uvs outside [0, 1) wrap around
+		const bool isStrip{ mesh.primitiveTopology == PrimitiveTopology::TriangleStrip };
+		const int triangleCount{ static_cast<int>(isStrip ? mesh.indices.size() - 2 : mesh.indices.size() / 3) };
+		const float size{ static_cast<float>(m_Size) };
+
+		//Triangle each texel was last rasterized for, the one it was taken from loses it
+		std::vector<int> owners(texelCount, -1);
+		m_HasSharedTexels.assign(triangleCount, 0);
+
+		for (int triangle{}; triangle < triangleCount; ++triangle)
+		{
+			const int first{ isStrip ? triangle : triangle * 3 };
+			const Vertex_In& v0{ mesh.vertices[mesh.indices[first]] };
+			const Vertex_In& v1{ mesh.vertices[mesh.indices[first + 1]] };
+			const Vertex_In& v2{ mesh.vertices[mesh.indices[first + 2]] };
+
+			const Vector2 p0{ v0.uv * size };
+			const Vector2 p1{ v1.uv * size };
+			const Vector2 p2{ v2.uv * size };
+
+			const float area{ Vector2::Cross(p1 - p0, p2 - p0) };
+			if (area == 0.0f)
+			{
+				m_HasSharedTexels[triangle] = 1;
+				continue;
+			}
+
+			bool hasTexels{};
+
+			const int xMin{ static_cast<int>(std::floor(std::min({ p0.x, p1.x, p2.x }))) };
+			const int xMax{ static_cast<int>(std::ceil(std::max({ p0.x, p1.x, p2.x }))) };
+			const int yMin{ static_cast<int>(std::floor(std::min({ p0.y, p1.y, p2.y }))) };
+			const int yMax{ static_cast<int>(std::ceil(std::max({ p0.y, p1.y, p2.y }))) };
+
+			for (int y{ yMin }; y < yMax; ++y)
+			{
+				for (int x{ xMin }; x < xMax; ++x)
+				{
+					const Vector2 centre{ x + 0.5f, y + 0.5f };
+					const float w0{ Vector2::Cross(p2 - p1, centre - p1) / area };
+					const float w1{ Vector2::Cross(p0 - p2, centre - p2) / area };
+					const float w2{ 1.0f - w0 - w1 };
+					if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+					{
+						continue;
+					}
+
+					const int index{ ((x % m_Size + m_Size) % m_Size) + ((y % m_Size + m_Size) % m_Size) * m_Size };
+					//A centre on the edge two triangles of a chart share is no overlap
+					const bool isInside{ w0 > 0.0f && w1 > 0.0f && w2 > 0.0f };
+					if (isInside && owners[index] >= 0 && owners[index] != triangle)
+					{
+						m_HasSharedTexels[owners[index]] = 1;
+					}
+					owners[index] = triangle;
+					hasTexels = true;
+
+					m_Texels[index].position = v0.position * w0 + v1.position * w1 + v2.position * w2;
+					m_Texels[index].normal = (v0.normal * w0 + v1.normal * w1 + v2.normal * w2).Normalized();
+					m_Texels[index].tangent = (v0.tangent * w0 + v1.tangent * w1 + v2.tangent * w2).Normalized();
+					m_IsCovered[index] = 1;
+				}
+			}
+
+			//Too thin to hold a texel centre, its pixels would read the neighbouring triangles' texels
+			if (!hasTexels)
+			{
+				m_HasSharedTexels[triangle] = 1;
+			}
+		}
+
+		//Grow the charts: every uncovered texel next to a covered one copies it, one ring per pass
+		std::vector<std::pair<int, int>> grown{};
+		for (int pass{}; pass < GutterTexels; ++pass)
+		{
+			grown.clear();
+			for (int y{}; y < m_Size; ++y)
+			{
+				for (int x{}; x < m_Size; ++x)
+				{
+					const int index{ x + y * m_Size };
+					if (m_IsCovered[index])
+					{
+						continue;
+					}
+
+					const int neighbours[]{ (x + 1) % m_Size + y * m_Size, (x + m_Size - 1) % m_Size + y * m_Size,
+						x + ((y + 1) % m_Size) * m_Size, x + ((y + m_Size - 1) % m_Size) * m_Size };
+					for (int neighbour : neighbours)
+					{
+						if (m_IsCovered[neighbour])
+						{
+							grown.emplace_back(index, neighbour);
+							break;
+						}
+					}
+				}
+			}
+
+			for (const auto& [index, source] : grown)
+			{
+				m_Texels[index] = m_Texels[source];
+				m_IsCovered[index] = 1;
+			}
+		}
+
+		m_Tiles.assign(static_cast<size_t>(m_TilesPerRow) * m_TilesPerRow, Tile{});
+		m_IsTileSeen.assign(m_Tiles.size(), 0);
+
+		for (int tile{}; tile < static_cast<int>(m_Tiles.size()); ++tile)
+		{
+			const int tileX{ (tile % m_TilesPerRow) * TileSize };
+			const int tileY{ (tile / m_TilesPerRow) * TileSize };
+
+			Vector3 positionSum{};
+			int coveredCount{};
+			for (int y{ tileY }; y < tileY + TileSize; ++y)
+			{
+				for (int x{ tileX }; x < tileX + TileSize; ++x)
+				{
+					if (m_IsCovered[x + y * m_Size])
+					{
+						positionSum += m_Texels[x + y * m_Size].position;
+						++coveredCount;
+					}
+				}
+			}
+
+			m_Tiles[tile].hasGeometry = coveredCount > 0;
+			m_Tiles[tile].center = coveredCount > 0 ? positionSum / static_cast<float>(coveredCount) : Vector3{};
+		}
+
+		m_IsBaked = true;
+	}
+
+	bool ShadingAtlas::IsBaked() const
+	{
+		return m_IsBaked;
+	}
+
+	bool ShadingAtlas::HasSharedTexels(int triangle) const
+	{
+		return m_HasSharedTexels[triangle];
+	}
+
+	int ShadingAtlas::GetSharedTriangleCount() const
+	{
+		return static_cast<int>(std::count(m_HasSharedTexels.begin(), m_HasSharedTexels.end(), uint8_t{ 1 }));
+	}
+
+	bool ShadingAtlas::Sample(const Vector2& uv, ColorRGB& colour) const
+	{
+		const float u{ (uv.x - std::floor(uv.x)) * m_Size - 0.5f };
+		const float v{ (uv.y - std::floor(uv.y)) * m_Size - 0.5f };
+		const int x0{ static_cast<int>(std::floor(u)) };
+		const int y0{ static_cast<int>(std::floor(v)) };
+		const float fractionX{ u - x0 };
+		const float fractionY{ v - y0 };
+
+		//x0 and y0 are at least -1, the size is a power of two
+		const int mask{ m_Size - 1 };
+		const int xs[]{ (x0 + m_Size) & mask, (x0 + 1) & mask };
+		const int ys[]{ (y0 + m_Size) & mask, (y0 + 1) & mask };
+
+		bool isShaded{ true };
+		ColorRGB texels[4]{};
+		for (int i{}; i < 4; ++i)
+		{
+			const int x{ xs[i & 1] };
+			const int y{ ys[i >> 1] };
+			const int index{ x + y * m_Size };
+			const int tile{ x / TileSize + (y / TileSize) * m_TilesPerRow };
+
+			m_IsTileSeen[tile] = 1;
+			isShaded = isShaded && m_IsCovered[index] && m_Tiles[tile].isShaded;
+			texels[i] = m_Colours[index];
+		}
+
+		if (!isShaded)
+		{
+			return false;
+		}
+
+		colour = ColorRGB::Lerp(ColorRGB::Lerp(texels[0], texels[1], fractionX), ColorRGB::Lerp(texels[2], texels[3], fractionX), fractionY);
+		return true;
+	}
+
+	int ShadingAtlas::Refresh(const Vector3& objectLightDirection, const Vector3& objectEye, float maxStaleAngle, int maxTiles, const ShadeFunction& shade)
+	{
+		const float minCosine{ std::cos(maxStaleAngle) };
+
+		//Urgency and tile, unshaded tiles rank above any stale one (1 - cosine is at most 2)
+		std::vector<std::pair<float, int>> candidates{};
+		for (int tile{}; tile < static_cast<int>(m_Tiles.size()); ++tile)
+		{
+			if (!m_IsTileSeen[tile])
+			{
+				continue;
+			}
+			m_IsTileSeen[tile] = 0;
+
+			const Tile& state{ m_Tiles[tile] };
+			if (!state.hasGeometry)
+			{
+				continue;
+			}
+
+			if (!state.isShaded)
+			{
+				candidates.emplace_back(3.0f, tile);
+				continue;
+			}
+
+			const float lightCosine{ Vector3::Dot(state.lightDirection, objectLightDirection) };
+			const float viewCosine{ Vector3::Dot((state.eye - state.center).Normalized(), (objectEye - state.center).Normalized()) };
+			const float cosine{ std::min(lightCosine, viewCosine) };
+			if (cosine < minCosine)
+			{
+				candidates.emplace_back(1.0f - cosine, tile);
+			}
+		}
+
+		if (static_cast<int>(candidates.size()) > maxTiles)
+		{
+			std::nth_element(candidates.begin(), candidates.begin() + maxTiles, candidates.end(), std::greater<>{});
+			candidates.resize(maxTiles);
+		}
+
+		JobSystem::GetInstance().ParallelFor(static_cast<int>(candidates.size()), 1, [&](int begin, int end)
+			{
+				for (int i{ begin }; i < end; ++i)
+				{
+					const int tile{ candidates[i].second };
+					ShadeTile(tile, shade);
+
+					m_Tiles[tile].isShaded = true;
+					m_Tiles[tile].lightDirection = objectLightDirection;
+					m_Tiles[tile].eye = objectEye;
+				}
+			});
+
+		return static_cast<int>(candidates.size());
+	}
+
+	void ShadingAtlas::ShadeTile(int tile, const ShadeFunction& shade)
+	{
+		const int tileX{ (tile % m_TilesPerRow) * TileSize };
+		const int tileY{ (tile / m_TilesPerRow) * TileSize };
+		const float inverseSize{ 1.0f / m_Size };
+
+		for (int y{ tileY }; y < tileY + TileSize; ++y)
+		{
+			for (int x{ tileX }; x < tileX + TileSize; ++x)
+			{
+				const int index{ x + y * m_Size };
+				if (m_IsCovered[index])
+				{
+					m_Colours[index] = shade(m_Texels[index], Vector2{ (x + 0.5f) * inverseSize, (y + 0.5f) * inverseSize });
+				}
+			}
+		}
+	}
+
+	void ShadingAtlas::Invalidate()
+	{
+		for (Tile& tile : m_Tiles)
+		{
+			tile.isShaded = false;
+		}
+	}
+
+	int ShadingAtlas::GetSize() const
+	{
+		return m_Size;
+	}
+
+	float ShadingAtlas::GetUvLod() const
+	{
+		return -std::log2(static_cast<float>(m_Size));
+	}
+
+	int ShadingAtlas::GetShadedTileCount() const
+	{
+		return static_cast<int>(std::count_if(m_Tiles.begin(), m_Tiles.end(), [](const Tile& tile) { return tile.isShaded; }));
+	}
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include <functional>
+#include <vector>
+#include "ColorRGB.h"
+#include "Math.h"
+
+namespace dae
+{
+	class MeshData;
+
+	//Shaded colour of a mesh cached in texture space, for the software rasterizer's texture space shading
+	//The mesh's uv charts are baked once into a position, normal and tangent per texel, so texels can be shaded
+	//without rasterizing anything; tiles of texels are shaded when they are first seen and again once they went stale
+	class ShadingAtlas final
+	{
+	public:
+		static constexpr int TileSize{ 16 };
+		//Texels the charts are grown by, so the bilinear lookups at their edges never reach an unbaked texel
+		static constexpr int GutterTexels{ 2 };
+
+		//Object space
+		struct Texel
+		{
+			Vector3 position{};
+			Vector3 normal{};
+			Vector3 tangent{};
+		};
+
+		//Shades one texel, uv is the texel's centre
+		using ShadeFunction = std::function<ColorRGB(const Texel& texel, const Vector2& uv)>;
+
+		//Size is a power of two
+		explicit ShadingAtlas(int size);
+
+		ShadingAtlas(const ShadingAtlas&) = delete;
+		ShadingAtlas(ShadingAtlas&&) noexcept = delete;
+		ShadingAtlas& operator=(const ShadingAtlas&) = delete;
+		ShadingAtlas& operator=(ShadingAtlas&&) noexcept = delete;
+
+		//Rasterizes the mesh's uv triangles (wrapped into [0, 1)) into the texels, every tile starts unshaded
+		//Where uv charts overlap (mirrored halves, reused details) a texel keeps the triangle rasterized last
+		void Bake(const MeshData& mesh);
+		bool IsBaked() const;
+
+		//True when another triangle took over some of the triangle's texels, or it has none, so the atlas holds another surface's colours for it
+		//Triangles are numbered in index order, as the rasterizer walks them
+		bool HasSharedTexels(int triangle) const;
+		int GetSharedTriangleCount() const;
+
+		//Bilinear lookup of the cached colour, false when one of the four texels has not been shaded yet
+		//Marks the tiles it read as seen, Refresh only ever shades seen tiles
+		bool Sample(const Vector2& uv, ColorRGB& colour) const;
+
+		//Shades up to maxTiles of the tiles seen since the last call: never shaded ones first, then the stalest
+		//A tile is stale once the light or the direction to the eye (both in object space) turned by more than maxStaleAngle (radians)
+		//since it was shaded, returns the number of tiles shaded
+		int Refresh(const Vector3& objectLightDirection, const Vector3& objectEye, float maxStaleAngle, int maxTiles, const ShadeFunction& shade);
+
+		//Every tile needs shading again, for changes the staleness test does not see (shading mode, maps, ...)
+		void Invalidate();
+
+		int GetSize() const;
+		//Mip the texels are shaded at, one texel of the atlas per texel of the material
+		float GetUvLod() const;
+		int GetShadedTileCount() const;
+
+	private:
+		struct Tile
+		{
+			bool hasGeometry{};
+			bool isShaded{};
+			Vector3 center{};
+			//What the tile was shaded with
+			Vector3 lightDirection{};
+			Vector3 eye{};
+		};
+
+		void ShadeTile(int tile, const ShadeFunction& shade);
+
+		int m_Size{};
+		int m_TilesPerRow{};
+
+		//Allocated by Bake, an atlas that is never used costs nothing
+		std::vector<Texel> m_Texels{};
+		std::vector<uint8_t> m_IsCovered{};
+		std::vector<ColorRGB> m_Colours{};
+		std::vector<Tile> m_Tiles{};
+		std::vector<uint8_t> m_HasSharedTexels{};
+		bool m_IsBaked{};
+
+		//Feedback from Sample, cleared by Refresh
+		mutable std::vector<uint8_t> m_IsTileSeen{};
+	};
+}
@@ -0,0 +1,160 @@
+#include "pch.h"
+#include "ShadingRateMap.h"
+#include "JobSystem.h"
+
+namespace dae
+{
+	ShadingRateMap::ShadingRateMap(int width, int height)
+	{
+		Resize(width, height);
+	}
+
+	void ShadingRateMap::Resize(int width, int height)
+	{
+		m_Width = width;
+		m_Height = height;
+		m_TileCountX = (width + TileSize - 1) / TileSize;
+		m_TileCountY = (height + TileSize - 1) / TileSize;
+		m_BlockCountX = (width + 1) / 2;
+
+		m_Rates.assign(static_cast<size_t>(m_TileCountX) * m_TileCountY, 1);
+		m_Blocks.assign(static_cast<size_t>(m_BlockCountX) * ((height + 1) / 2), Block{});
+	}
+
+	void ShadingRateMap::Update(const HdrPixel* pColour, const float* pDepth, const Matrix& projection)
+	{
+		//Stored depth d = A + B / viewZ
+		const float depthA{ projection[2].z };
+		const float depthB{ projection[3].z };
+
+		JobSystem::GetInstance().ParallelFor(m_TileCountX * m_TileCountY, 1, [&](int begin, int end)
+			{
+				for (int tile{ begin }; tile < end; ++tile)
+				{
+					const int left{ (tile % m_TileCountX) * TileSize };
+					const int top{ (tile / m_TileCountX) * TileSize };
+					const int right{ std::min(left + TileSize, m_Width) };
+					const int bottom{ std::min(top + TileSize, m_Height) };
+
+					bool hasEdge{};
+					int coveredCount{};
+					float luminanceSum{};
+					float luminanceSquareSum{};
+
+					for (int py{ top }; py < bottom && !hasEdge; ++py)
+					{
+						for (int px{ left }; px < right; ++px)
+						{
+							const int index{ px + py * m_Width };
+							const float depth{ pDepth[index] };
+							const bool isCovered{ depth != FLT_MAX };
+
+							//Against the right and the lower neighbour, inside the tile
+							for (const int neighbour : { px + 1 < right ? index + 1 : -1, py + 1 < bottom ? index + m_Width : -1 })
+							{
+								if (neighbour < 0)
+								{
+									continue;
+								}
+
+								const float neighbourDepth{ pDepth[neighbour] };
+								if (isCovered != (neighbourDepth != FLT_MAX))
+								{
+									hasEdge = true;
+								}
+								else if (isCovered)
+								{
+									const float viewDepth{ depthB / (depth - depthA) };
+									const float neighbourViewDepth{ depthB / (neighbourDepth - depthA) };
+									hasEdge = hasEdge || std::abs(viewDepth - neighbourViewDepth) > DepthTolerance * viewDepth;
+								}
+							}
+
+							if (isCovered)
+							{
+								//In display range, as the resolve brings it there, the variances were tuned on those colours
+								ColorRGB colour{ ToColorRGB(pColour[index]) };
+								colour.MaxToOne();
+								const float luminance{ 0.299f * colour.r + 0.587f * colour.g + 0.114f * colour.b };
+								luminanceSum += luminance;
+								luminanceSquareSum += luminance * luminance;
+								++coveredCount;
+							}
+						}
+					}
+
+					//Empty tiles stay at full rate, whatever moves into them is unknown
+					uint8_t rate{ 1 };
+					if (!hasEdge && coveredCount > 0)
+					{
+						//The coarse tiles' pixels are copies of real shaded samples, so their variance still measures the content
+						const float mean{ luminanceSum / coveredCount };
+						const float variance{ luminanceSquareSum / coveredCount - mean * mean };
+						rate = variance < QuarterRateVariance ? 4 : variance < HalfRateVariance ? 2 : 1;
+					}
+
+					m_Rates[tile] = rate;
+				}
+			});
+	}
+
+	void ShadingRateMap::Reset()
+	{
+		std::fill(m_Rates.begin(), m_Rates.end(), uint8_t{ 1 });
+	}
+
+	void ShadingRateMap::BeginFrame()
+	{
+		++m_Frame;
+	}
+
+	int ShadingRateMap::GetRate(int px, int py) const
+	{
+		return m_Rates[px / TileSize + (py / TileSize) * m_TileCountX];
+	}
+
+	int ShadingRateMap::GetBlockIndex(int px, int py) const
+	{
+		//Blocks never straddle tiles, the tile size is a multiple of every rate
+		const int rate{ GetRate(px, py) };
+		return (px / rate * rate) / 2 + ((py / rate * rate) / 2) * m_BlockCountX;
+	}
+
+	bool ShadingRateMap::Lookup(int px, int py, float viewDepth, ColorRGB& colour) const
+	{
+		const Block& block{ m_Blocks[GetBlockIndex(px, py)] };
+		if (block.frame != m_Frame || block.queuedLane >= 0 || std::abs(block.viewDepth - viewDepth) > DepthTolerance * viewDepth)
+		{
+			return false;
+		}
+
+		colour = block.colour;
+		return true;
+	}
+
+	void ShadingRateMap::Store(int px, int py, float viewDepth, const ColorRGB& colour)
+	{
+		m_Blocks[GetBlockIndex(px, py)] = Block{ colour, viewDepth, m_Frame };
+	}
+
+	void ShadingRateMap::Queue(int px, int py, float viewDepth, int lane)
+	{
+		m_Blocks[GetBlockIndex(px, py)] = Block{ ColorRGB{}, viewDepth, m_Frame, lane };
+	}
+
+	int ShadingRateMap::GetQueuedLane(int px, int py, float viewDepth) const
+	{
+		const Block& block{ m_Blocks[GetBlockIndex(px, py)] };
+		if (block.frame != m_Frame || block.queuedLane < 0 || std::abs(block.viewDepth - viewDepth) > DepthTolerance * viewDepth)
+		{
+			return -1;
+		}
+
+		return block.queuedLane;
+	}
+
+	int ShadingRateMap::GetTileCount(int rate) const
+	{
+		return static_cast<int>(std::count(m_Rates.begin(), m_Rates.end(), static_cast<uint8_t>(rate)));
+	}
+}
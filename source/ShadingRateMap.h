@@ -0,0 +1,77 @@
+#pragma once
+#include <vector>
+#include "ColorRGB.h"
+#include "Math.h"
+#include "HdrPixel.h"
+
+namespace dae
+{
+	//Coarse shading for the software rasterizer: a shading rate per screen tile, picked from the last finished frame,
+	//and a cache of one shaded colour per block of rate x rate pixels
+	//Coverage and depth stay per pixel, a fragment takes its block's colour when the block was shaded on the same surface
+	class ShadingRateMap final
+	{
+	public:
+		static constexpr int TileSize{ 16 };
+		//Relative difference in view depth above which two pixels lie on different surfaces
+		static constexpr float DepthTolerance{ 0.02f };
+		//Luminance variances of a tile below which it is shaded once per 4x4 and once per 2x2 pixels
+		static constexpr float QuarterRateVariance{ 0.0004f };
+		static constexpr float HalfRateVariance{ 0.0025f };
+
+		ShadingRateMap(int width, int height);
+
+		ShadingRateMap(const ShadingRateMap&) = delete;
+		ShadingRateMap(ShadingRateMap&&) noexcept = delete;
+		ShadingRateMap& operator=(const ShadingRateMap&) = delete;
+		ShadingRateMap& operator=(ShadingRateMap&&) noexcept = delete;
+
+		//For another render resolution, every tile starts at full rate
+		void Resize(int width, int height);
+
+		//Picks the next frame's rates from a finished frame: full rate wherever the depth jumps or the coverage ends,
+		//elsewhere by the luminance variance
+		void Update(const HdrPixel* pColour, const float* pDepth, const Matrix& projection);
+		//Every tile back to full rate
+		void Reset();
+
+		//Forgets the blocks shaded in the last frame
+		void BeginFrame();
+
+		//Pixels per side of the block the pixel is shaded with, 1, 2 or 4
+		int GetRate(int px, int py) const;
+		//The colour of the pixel's block, when it was shaded this frame on a surface at about the same view depth
+		bool Lookup(int px, int py, float viewDepth, ColorRGB& colour) const;
+		void Store(int px, int py, float viewDepth, const ColorRGB& colour);
+		//Batched shading: the block's fragment waits in a lane of a batch, its colour is stored once the batch is shaded
+		void Queue(int px, int py, float viewDepth, int lane);
+		//The lane the pixel's block waits in, on a surface at about the same view depth, -1 when it is not queued
+		int GetQueuedLane(int px, int py, float viewDepth) const;
+
+		//Tiles at the rate
+		int GetTileCount(int rate) const;
+
+	private:
+		struct Block
+		{
+			ColorRGB colour{};
+			float viewDepth{};
+			uint32_t frame{};
+			int queuedLane{ -1 };
+		};
+
+		//Blocks are stored at 2x2 granularity, a 4x4 block uses the entry of its top left 2x2 block
+		int GetBlockIndex(int px, int py) const;
+
+		int m_Width{};
+		int m_Height{};
+		int m_TileCountX{};
+		int m_TileCountY{};
+
+		std::vector<uint8_t> m_Rates{};
+		std::vector<Block> m_Blocks{};
+		int m_BlockCountX{};
+		//Blocks stored in another frame are stale
+		uint32_t m_Frame{ 1 };
+	};
+}
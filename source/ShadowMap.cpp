@@ -0,0 +1,305 @@
+#include "pch.h"
+#include "ShadowMap.h"
+#include "JobSystem.h"
+#include "Mesh.h"
+#include <immintrin.h>
+
+namespace dae
+{
+	namespace
+	{
+		//Rows of the map one job rasterizes, every job walks all triangles and skips the ones outside its rows
+		constexpr int BandHeight{ 32 };
+
+		//Depth-only rasterization of one triangle into the rows [rowBegin, rowEnd), keeps the nearest depth
+		//Vertices are in map space: x and y in texels, z in [0, 1], depth interpolates linearly (orthographic)
+		//Both windings are drawn, so thin casters still cast from behind
+		void RasterizeDepth(Vector3 v0, Vector3 v1, Vector3 v2, float* pDepth, int size, int rowBegin, int rowEnd)
+		{
+			float area{ (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x) };
+			if (area == 0.0f)
+			{
+				return;
+			}
+			if (area < 0.0f)
+			{
+				std::swap(v1, v2);
+				area = -area;
+			}
+
+			const int xMin{ std::max(0, static_cast<int>(std::floor(std::min({ v0.x, v1.x, v2.x })))) };
+			const int xMax{ std::min(size - 1, static_cast<int>(std::ceil(std::max({ v0.x, v1.x, v2.x })))) };
+			const int yMin{ std::max(rowBegin, static_cast<int>(std::floor(std::min({ v0.y, v1.y, v2.y })))) };
+			const int yMax{ std::min(rowEnd - 1, static_cast<int>(std::ceil(std::max({ v0.y, v1.y, v2.y })))) };
+			if (xMin > xMax || yMin > yMax)
+			{
+				return;
+			}
+
+			//Edge functions at the first pixel centre, their steps per pixel and per row
+			const auto edge{ [](const Vector3& a, const Vector3& b, float x, float y) { return (b.x - a.x) * (y - a.y) - (b.y - a.y) * (x - a.x); } };
+			const float startX{ xMin + 0.5f };
+			const float startY{ yMin + 0.5f };
+
+			const float w0Start{ edge(v1, v2, startX, startY) };
+			const float w1Start{ edge(v2, v0, startX, startY) };
+			const float w2Start{ edge(v0, v1, startX, startY) };
+			const float w0StepX{ v1.y - v2.y }, w0StepY{ v2.x - v1.x };
+			const float w1StepX{ v2.y - v0.y }, w1StepY{ v0.x - v2.x };
+			const float w2StepX{ v0.y - v1.y }, w2StepY{ v1.x - v0.x };
+
+			//Depth is a plane over the triangle: z = zStart + x * zStepX + y * zStepY
+			const float inverseArea{ 1.0f / area };
+			const float zStart{ (w0Start * v0.z + w1Start * v1.z + w2Start * v2.z) * inverseArea };
+			const float zStepX{ (w0StepX * v0.z + w1StepX * v1.z + w2StepX * v2.z) * inverseArea };
+			const float zStepY{ (w0StepY * v0.z + w1StepY * v1.z + w2StepY * v2.z) * inverseArea };
+
+			//8 pixels of a row per step
+			const __m256 laneOffsets{ _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7) };
+			const __m256 zero{ _mm256_setzero_ps() };
+
+			for (int py{ yMin }; py <= yMax; ++py)
+			{
+				const float rowOffset{ static_cast<float>(py - yMin) };
+				const float w0Row{ w0Start + rowOffset * w0StepY };
+				const float w1Row{ w1Start + rowOffset * w1StepY };
+				const float w2Row{ w2Start + rowOffset * w2StepY };
+				const float zRow{ zStart + rowOffset * zStepY };
+				float* pRow{ pDepth + py * size };
+
+				for (int px{ xMin }; px <= xMax; px += 8)
+				{
+					const __m256 x{ _mm256_add_ps(_mm256_set1_ps(static_cast<float>(px - xMin)), laneOffsets) };
+
+					const __m256 w0{ _mm256_add_ps(_mm256_set1_ps(w0Row), _mm256_mul_ps(x, _mm256_set1_ps(w0StepX))) };
+					const __m256 w1{ _mm256_add_ps(_mm256_set1_ps(w1Row), _mm256_mul_ps(x, _mm256_set1_ps(w1StepX))) };
+					const __m256 w2{ _mm256_add_ps(_mm256_set1_ps(w2Row), _mm256_mul_ps(x, _mm256_set1_ps(w2StepX))) };
+
+					const __m256i inRow{ _mm256_cmpgt_epi32(_mm256_set1_epi32(xMax - px + 1), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)) };
+					const __m256 isInside{ _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(w0, zero, _CMP_GE_OQ), _mm256_cmp_ps(w1, zero, _CMP_GE_OQ)),
+						_mm256_and_ps(_mm256_cmp_ps(w2, zero, _CMP_GE_OQ), _mm256_castsi256_ps(inRow))) };
+					if (_mm256_testz_ps(isInside, isInside))
+					{
+						continue;
+					}
+
+					//Masked so the lanes past the end of the row never touch memory
+					const __m256i mask{ _mm256_castps_si256(isInside) };
+					const __m256 depth{ _mm256_add_ps(_mm256_set1_ps(zRow), _mm256_mul_ps(x, _mm256_set1_ps(zStepX))) };
+					const __m256 stored{ _mm256_maskload_ps(pRow + px, mask) };
+					_mm256_maskstore_ps(pRow + px, mask, _mm256_min_ps(stored, depth));
+				}
+			}
+		}
+	}
+
+	ShadowMap::ShadowMap(int size)
+		: m_Size{ size }
+		, m_Depth(static_cast<size_t>(size) * size, FLT_MAX)
+	{
+	}
+
+	bool ShadowMap::Update(const std::vector<MeshData*>& pCasters, const Vector3& lightDirection)
+	{
+		bool isDirty{ !m_IsValid || pCasters.size() != m_CasterWorldMatrices.size() ||
+			lightDirection.x != m_LightDirection.x || lightDirection.y != m_LightDirection.y || lightDirection.z != m_LightDirection.z };
+
+		for (size_t i{}; i < pCasters.size() && !isDirty; ++i)
+		{
+			isDirty = !(pCasters[i]->worldMatrix == m_CasterWorldMatrices[i]);
+		}
+
+		if (!isDirty)
+		{
+			return false;
+		}
+
+		Render(pCasters, lightDirection);
+
+		m_IsValid = true;
+		m_LightDirection = lightDirection;
+		m_CasterWorldMatrices.clear();
+		for (const MeshData* pCaster : pCasters)
+		{
+			m_CasterWorldMatrices.push_back(pCaster->worldMatrix);
+		}
+
+		return true;
+	}
+
+	void ShadowMap::Render(const std::vector<MeshData*>& pCasters, const Vector3& lightDirection)
+	{
+		//Light view at the world origin looking along the light, with any up that is not parallel to it
+		const Vector3 up{ std::abs(lightDirection.y) < 0.99f ? Vector3::UnitY : Vector3::UnitX };
+		const Matrix lightView{ Matrix::CreateLookAtLH(Vector3{}, lightDirection, up) };
+
+		//Casters in light view space, their bounds become the orthographic frustum
+		std::vector<std::vector<Vector3>> positions(pCasters.size());
+		Vector3 minimum{ FLT_MAX, FLT_MAX, FLT_MAX };
+		Vector3 maximum{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+		for (size_t i{}; i < pCasters.size(); ++i)
+		{
+			const Matrix worldLightView{ pCasters[i]->worldMatrix * lightView };
+
+			positions[i].reserve(pCasters[i]->vertices.size());
+			for (const Vertex_In& vertex : pCasters[i]->vertices)
+			{
+				const Vector3 position{ worldLightView.TransformPoint(vertex.position) };
+				minimum = Vector3{ std::min(minimum.x, position.x), std::min(minimum.y, position.y), std::min(minimum.z, position.z) };
+				maximum = Vector3{ std::max(maximum.x, position.x), std::max(maximum.y, position.y), std::max(maximum.z, position.z) };
+				positions[i].push_back(position);
+			}
+		}
+
+		if (minimum.x > maximum.x)
+		{
+			std::fill(m_Depth.begin(), m_Depth.end(), FLT_MAX);
+			m_LightViewProjection = Matrix{};
+			return;
+		}
+
+		//A little room around the casters so the outermost texels are never cut off
+		const Vector3 padding{ (maximum - minimum) * 0.01f + Vector3{ 0.01f, 0.01f, 0.01f } };
+		minimum -= padding;
+		maximum += padding;
+		const Vector3 extent{ maximum - minimum };
+		const Vector3 center{ (minimum + maximum) * 0.5f };
+
+		m_LightViewProjection = lightView * Matrix::CreateTranslation(-center.x, -center.y, 0.0f) * Matrix::CreateOrthographicLH(extent.x, extent.y, minimum.z, maximum.z);
+
+		//Same mapping as the matrix, straight to texels: x and y in [0, size], z in [0, 1]
+		const float size{ static_cast<float>(m_Size) };
+		for (std::vector<Vector3>& meshPositions : positions)
+		{
+			for (Vector3& position : meshPositions)
+			{
+				position = Vector3{ (position.x - minimum.x) / extent.x * size, (maximum.y - position.y) / extent.y * size, (position.z - minimum.z) / extent.z };
+			}
+		}
+
+		const int bandCount{ (m_Size + BandHeight - 1) / BandHeight };
+		JobSystem::GetInstance().ParallelFor(bandCount, 1, [&](int begin, int end)
+			{
+				for (int band{ begin }; band < end; ++band)
+				{
+					const int rowBegin{ band * BandHeight };
+					const int rowEnd{ std::min(rowBegin + BandHeight, m_Size) };
+					std::fill(m_Depth.begin() + rowBegin * m_Size, m_Depth.begin() + rowEnd * m_Size, FLT_MAX);
+
+					for (size_t i{}; i < pCasters.size(); ++i)
+					{
+						const MeshData* pCaster{ pCasters[i] };
+						const std::vector<Vector3>& meshPositions{ positions[i] };
+						const bool isStrip{ pCaster->primitiveTopology == PrimitiveTopology::TriangleStrip };
+						const int triangleCount{ static_cast<int>(isStrip ? pCaster->indices.size() - 2 : pCaster->indices.size() / 3) };
+
+						for (int triangle{}; triangle < triangleCount; ++triangle)
+						{
+							const int first{ isStrip ? triangle : triangle * 3 };
+							RasterizeDepth(meshPositions[pCaster->indices[first]], meshPositions[pCaster->indices[first + 1]], meshPositions[pCaster->indices[first + 2]],
+								m_Depth.data(), m_Size, rowBegin, rowEnd);
+						}
+					}
+				}
+			});
+
+		++m_RenderCount;
+	}
+
+	float ShadowMap::Sample(const Vector3& worldPosition) const
+	{
+		if (!m_IsValid)
+		{
+			return 1.0f;
+		}
+
+		const Vector3 position{ m_LightViewProjection.TransformPoint(worldPosition) };
+		const float u{ (position.x + 1.0f) * 0.5f * m_Size - 0.5f };
+		const float v{ (1.0f - position.y) * 0.5f * m_Size - 0.5f };
+		const float receiverDepth{ position.z - DepthBias };
+
+		const int x0{ static_cast<int>(std::floor(u)) };
+		const int y0{ static_cast<int>(std::floor(v)) };
+		const float fractionX{ u - x0 };
+		const float fractionY{ v - y0 };
+
+		const auto isLit{ [&](int x, int y)
+			{
+				x = Clamp(x, 0, m_Size - 1);
+				y = Clamp(y, 0, m_Size - 1);
+				return receiverDepth <= m_Depth[x + y * m_Size] ? 1.0f : 0.0f;
+			} };
+
+		const float top{ Lerpf(isLit(x0, y0), isLit(x0 + 1, y0), fractionX) };
+		const float bottom{ Lerpf(isLit(x0, y0 + 1), isLit(x0 + 1, y0 + 1), fractionX) };
+		return Lerpf(top, bottom, fractionY);
+	}
+
+	void ShadowMap::SampleBatch(const float* pX, const float* pY, const float* pZ, float* pVisibility) const
+	{
+		if (!m_IsValid)
+		{
+			_mm256_storeu_ps(pVisibility, _mm256_set1_ps(1.0f));
+			return;
+		}
+
+		const __m256 worldX{ _mm256_loadu_ps(pX) };
+		const __m256 worldY{ _mm256_loadu_ps(pY) };
+		const __m256 worldZ{ _mm256_loadu_ps(pZ) };
+
+		//TransformPoint for 8 positions, row vectors times the rows of the matrix
+		const auto transform{ [&](float (Vector4::* component))
+			{
+				return _mm256_add_ps(_mm256_add_ps(
+					_mm256_mul_ps(worldX, _mm256_set1_ps(m_LightViewProjection[0].*component)),
+					_mm256_mul_ps(worldY, _mm256_set1_ps(m_LightViewProjection[1].*component))), _mm256_add_ps(
+					_mm256_mul_ps(worldZ, _mm256_set1_ps(m_LightViewProjection[2].*component)),
+					_mm256_set1_ps(m_LightViewProjection[3].*component)));
+			} };
+
+		const __m256 half{ _mm256_set1_ps(0.5f) };
+		const __m256 one{ _mm256_set1_ps(1.0f) };
+		const __m256 size{ _mm256_set1_ps(static_cast<float>(m_Size)) };
+		const __m256 u{ _mm256_sub_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_add_ps(transform(&Vector4::x), one), half), size), half) };
+		const __m256 v{ _mm256_sub_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_sub_ps(one, transform(&Vector4::y)), half), size), half) };
+		const __m256 receiverDepth{ _mm256_sub_ps(transform(&Vector4::z), _mm256_set1_ps(DepthBias)) };
+
+		const __m256 floorU{ _mm256_floor_ps(u) };
+		const __m256 floorV{ _mm256_floor_ps(v) };
+		const __m256 fractionX{ _mm256_sub_ps(u, floorU) };
+		const __m256 fractionY{ _mm256_sub_ps(v, floorV) };
+
+		//Clamp in float first, positions far outside the map would overflow the int conversion
+		const __m256 maxTexel{ _mm256_set1_ps(static_cast<float>(m_Size - 1)) };
+		const auto texel{ [&](__m256 coordinate, float offset)
+			{
+				return _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_add_ps(coordinate, _mm256_set1_ps(offset)), _mm256_setzero_ps()), maxTexel));
+			} };
+		const __m256i x0{ texel(floorU, 0.0f) };
+		const __m256i x1{ texel(floorU, 1.0f) };
+		const __m256i row0{ _mm256_mullo_epi32(texel(floorV, 0.0f), _mm256_set1_epi32(m_Size)) };
+		const __m256i row1{ _mm256_mullo_epi32(texel(floorV, 1.0f), _mm256_set1_epi32(m_Size)) };
+
+		const auto isLit{ [&](__m256i x, __m256i row)
+			{
+				const __m256 stored{ _mm256_i32gather_ps(m_Depth.data(), _mm256_add_epi32(x, row), 4) };
+				return _mm256_and_ps(_mm256_cmp_ps(receiverDepth, stored, _CMP_LE_OQ), one);
+			} };
+		const auto lerp{ [](__m256 a, __m256 b, __m256 t) { return _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), t)); } };
+
+		const __m256 top{ lerp(isLit(x0, row0), isLit(x1, row0), fractionX) };
+		const __m256 bottom{ lerp(isLit(x0, row1), isLit(x1, row1), fractionX) };
+		_mm256_storeu_ps(pVisibility, lerp(top, bottom, fractionY));
+	}
+
+	int ShadowMap::GetSize() const
+	{
+		return m_Size;
+	}
+
+	int ShadowMap::GetRenderCount() const
+	{
+		return m_RenderCount;
+	}
+}
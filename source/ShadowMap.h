@@ -0,0 +1,52 @@
+#pragma once
+#include <vector>
+#include "Math.h"
+
+namespace dae
+{
+	class MeshData;
+
+	//Depth of the directional light's view over the shadow casters, for the software rasterizer
+	//Rendered by a depth-only rasterizer (positions only, no attributes, no shading) and kept until the light
+	//or a caster's world matrix changes
+	class ShadowMap final
+	{
+	public:
+		//Depth units (the casters' depth range is [0, 1]) a receiver may lie behind the stored depth and still be lit
+		static constexpr float DepthBias{ 0.004f };
+
+		explicit ShadowMap(int size);
+
+		ShadowMap(const ShadowMap&) = delete;
+		ShadowMap(ShadowMap&&) noexcept = delete;
+		ShadowMap& operator=(const ShadowMap&) = delete;
+		ShadowMap& operator=(ShadowMap&&) noexcept = delete;
+
+		//Re-renders only when something it depends on changed since the last render, returns whether it did
+		bool Update(const std::vector<MeshData*>& pCasters, const Vector3& lightDirection);
+
+		//How much of the light reaches a world space position, 0 is fully shadowed
+		//Bilinear PCF: the 2x2 nearest depth comparisons, weighted like a bilinear fetch
+		float Sample(const Vector3& worldPosition) const;
+		//Sample for 8 positions at once, inputs and output are SoA arrays of 8 floats
+		void SampleBatch(const float* pX, const float* pY, const float* pZ, float* pVisibility) const;
+
+		int GetSize() const;
+		int GetRenderCount() const;
+
+	private:
+		void Render(const std::vector<MeshData*>& pCasters, const Vector3& lightDirection);
+
+		int m_Size{};
+		std::vector<float> m_Depth{};
+
+		Matrix m_LightViewProjection{};
+
+		//What the current contents were rendered with
+		bool m_IsValid{};
+		Vector3 m_LightDirection{};
+		std::vector<Matrix> m_CasterWorldMatrices{};
+
+		int m_RenderCount{};
+	};
+}
@@ -3,6 +3,9 @@
 #include "SDL_surface.h"
 #include "Mesh.h"
 #include "Texture.h"
+#include "VirtualTexture.h"
+#include "FastMath.h"
+#include "JobSystem.h"
 #include "Utils.h"
 
 namespace dae
@@ -12,13 +15,36 @@ namespace dae
 		, m_pCamera{pCamera}
 		, m_Width{width}
 		, m_Height{height}
+		, m_OutputWidth{width}
+		, m_OutputHeight{height}
 		, m_pMeshes{pMeshes}
+		, m_TemporalCache{width, height}
+		, m_ShadingRateMap{width, height}
+		, m_Checkerboard{width, height}
+		, m_Multisample{width, height}
 	{
 		m_pFrontBuffer = SDL_GetWindowSurface(pWindow);
 		m_pBackBuffer = SDL_CreateRGBSurface(0, m_Width, m_Height, 32, 0, 0, 0, 0);
-		m_pBackBufferPixels = (uint32_t*)m_pBackBuffer->pixels;
+		UpdateRenderTarget();
 
 		m_pDepthBufferPixels = new float[m_Width * m_Height];
+
+		ResizeLightTiles();
+
+		//Bounding sphere of the rendered mesh in model space, around the centre of its box
+		Vector3 minimum{ FLT_MAX, FLT_MAX, FLT_MAX };
+		Vector3 maximum{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (const Vertex_In& vertex : m_pMeshes[0]->vertices)
+		{
+			minimum = Vector3{ std::min(minimum.x, vertex.position.x), std::min(minimum.y, vertex.position.y), std::min(minimum.z, vertex.position.z) };
+			maximum = Vector3{ std::max(maximum.x, vertex.position.x), std::max(maximum.y, vertex.position.y), std::max(maximum.z, vertex.position.z) };
+		}
+
+		m_BoundsCenter = (minimum + maximum) * 0.5f;
+		for (const Vertex_In& vertex : m_pMeshes[0]->vertices)
+		{
+			m_BoundsRadius = std::max(m_BoundsRadius, (vertex.position - m_BoundsCenter).Magnitude());
+		}
 	}
 
 	SoftwareRenderer::~SoftwareRenderer()
@@ -31,46 +57,524 @@ namespace dae
 		}
 	}
 
-	void SoftwareRenderer::Update(const Timer* pTimer, bool shouldRotate, ShadingMode shadingMode, bool showDepthBuffer, bool uniformColor, bool showBounding, bool renderNormal, CullMode cullMode)
+	void SoftwareRenderer::SetMathAccuracy(MathAccuracy accuracy)
 	{
-		m_pCamera->Update(pTimer);
+		m_MathAccuracy = accuracy;
+	}
+
+	void SoftwareRenderer::SetRenderScale(float scale)
+	{
+		const int width{ std::clamp(static_cast<int>(m_OutputWidth * scale + 0.5f), LightTileSize, m_OutputWidth) };
+		const int height{ std::clamp(static_cast<int>(m_OutputHeight * scale + 0.5f), LightTileSize, m_OutputHeight) };
+		if (width == m_Width && height == m_Height)
+		{
+			return;
+		}
+
+		m_Width = width;
+		m_Height = height;
+
+		UpdateRenderTarget();
+		ResizeLightTiles();
+		m_TemporalCache.Resize(width, height);
+		m_ShadingRateMap.Resize(width, height);
+		m_Checkerboard.Resize(width, height);
+		m_Multisample.Resize(width, height);
+		m_IsInvalidated = true;
+	}
+
+	void SoftwareRenderer::UpdateRenderTarget()
+	{
+		const bool isScaled{ m_Width != m_OutputWidth || m_Height != m_OutputHeight };
+		const size_t pixelCount{ static_cast<size_t>(m_Width) * m_Height };
+
+		m_ColourBuffer.assign(pixelCount, HdrPixel{});
+		m_ResolvedPixels.assign(isScaled ? pixelCount : 0, 0);
+
+		//Whatever the new buffers hold is not the last frame
+		m_IsInvalidated = true;
+	}
+
+	void SoftwareRenderer::SetPostProcessSettings(const PostProcess::Settings& settings)
+	{
+		m_PostProcessSettings = settings;
+		m_IsInvalidated = true;
+	}
+
+	int SoftwareRenderer::GetRenderWidth() const
+	{
+		return m_Width;
+	}
+
+	int SoftwareRenderer::GetRenderHeight() const
+	{
+		return m_Height;
+	}
+
+	size_t SoftwareRenderer::GetMultisampleDepthMemorySize() const
+	{
+		return m_Multisample.GetDepthMemorySize();
+	}
+
+	size_t SoftwareRenderer::GetMultisampleColourMemorySize() const
+	{
+		return m_Multisample.GetColourMemorySize();
+	}
+
+	int SoftwareRenderer::GetMultisampleSplitPixelCount() const
+	{
+		return m_Multisample.GetSplitPixelCount();
+	}
+
+	void SoftwareRenderer::SetTextureFilterLimit(TextureFilter filter)
+	{
+		m_TextureFilterLimit = filter;
+	}
+
+	void SoftwareRenderer::ResizeLightTiles()
+	{
+		m_TileCountX = (m_Width + LightTileSize - 1) / LightTileSize;
+		m_TileCountY = (m_Height + LightTileSize - 1) / LightTileSize;
+		m_TileLightIndices.resize(m_TileCountX * m_TileCountY * MaxLightsPerTile);
+		m_TileLightCounts.resize(m_TileCountX * m_TileCountY);
+	}
+
+	void SoftwareRenderer::SetShadingLodThresholds(float noNormalMapBelow, float gouraudBelow)
+	{
+		m_NoNormalMapLodSize = noNormalMapBelow;
+		m_GouraudLodSize = gouraudBelow;
+	}
+
+	ShadingLod SoftwareRenderer::GetShadingLod() const
+	{
+		return m_ShadingLod;
+	}
+
+	float SoftwareRenderer::GetProjectedSize() const
+	{
+		return m_ProjectedSize;
+	}
+
+	int SoftwareRenderer::GetShadingAtlasTileCount() const
+	{
+		return m_ShadingAtlas.GetShadedTileCount();
+	}
+
+	int SoftwareRenderer::GetShadingAtlasRefreshCount() const
+	{
+		return m_ShadingAtlasRefreshCount;
+	}
+
+	int SoftwareRenderer::GetTemporalReusedCount() const
+	{
+		return m_TemporalCache.GetReusedCount();
+	}
+
+	int SoftwareRenderer::GetTemporalShadedCount() const
+	{
+		return m_TemporalCache.GetShadedCount();
+	}
+
+	uint32_t SoftwareRenderer::GetShadingSettings() const
+	{
+		return static_cast<uint32_t>(m_ShadingMode) | static_cast<uint32_t>(m_SamplerState.filter) << 4 | static_cast<uint32_t>(m_SamplerState.addressMode) << 6 |
+			static_cast<uint32_t>(m_MathAccuracy) << 8 | static_cast<uint32_t>(m_ShadingLod) << 12 |
+			static_cast<uint32_t>(m_NormalMapEnabled) << 16 | static_cast<uint32_t>(m_TangentSpaceLighting) << 17 | static_cast<uint32_t>(m_ShadowsEnabled) << 18 |
+			static_cast<uint32_t>(m_FixedPointShading) << 19 | static_cast<uint32_t>(m_Lights.size()) << 20;
+	}
+
+	void SoftwareRenderer::Invalidate()
+	{
+		m_IsInvalidated = true;
+	}
+
+	bool SoftwareRenderer::IsFrameSkipped() const
+	{
+		return m_DirtyRect.left >= m_DirtyRect.right || m_DirtyRect.top >= m_DirtyRect.bottom;
+	}
+
+	int SoftwareRenderer::GetDirtyPixelCount() const
+	{
+		return IsFrameSkipped() ? 0 : (m_DirtyRect.right - m_DirtyRect.left) * (m_DirtyRect.bottom - m_DirtyRect.top);
+	}
+
+	bool SoftwareRenderer::GetScreenBounds(const Matrix& worldMatrix, ScreenRect& bounds) const
+	{
+		const Matrix worldViewProjection{ worldMatrix * m_pCamera->viewMatrix * m_pCamera->projectionMatrix };
+
+		float xMin{ FLT_MAX };
+		float xMax{ -FLT_MAX };
+		float yMin{ FLT_MAX };
+		float yMax{ -FLT_MAX };
+
+		//Corners of the cube around the bounding sphere, any transform keeps the mesh inside their hull
+		for (int corner{}; corner < 8; ++corner)
+		{
+			const Vector3 offset{ (corner & 1) ? m_BoundsRadius : -m_BoundsRadius, (corner & 2) ? m_BoundsRadius : -m_BoundsRadius, (corner & 4) ? m_BoundsRadius : -m_BoundsRadius };
+			const Vector4 clip{ worldViewProjection.TransformPoint(Vector4{ m_BoundsCenter + offset, 1.0f }) };
+			if (clip.w <= 0.0f)
+			{
+				return false;
+			}
+
+			const float x{ (clip.x / clip.w + 1.0f) * 0.5f * m_Width };
+			const float y{ (1.0f - clip.y / clip.w) * 0.5f * m_Height };
+			xMin = std::min(xMin, x);
+			xMax = std::max(xMax, x);
+			yMin = std::min(yMin, y);
+			yMax = std::max(yMax, y);
+		}
+
+		//A pixel of margin, the rasterizer's loops run up to the ceiling of the vertices' bounds
+		bounds.left = std::clamp(static_cast<int>(std::floor(xMin)) - 1, 0, m_Width);
+		bounds.top = std::clamp(static_cast<int>(std::floor(yMin)) - 1, 0, m_Height);
+		bounds.right = std::clamp(static_cast<int>(std::ceil(xMax)) + 1, 0, m_Width);
+		bounds.bottom = std::clamp(static_cast<int>(std::ceil(yMax)) + 1, 0, m_Height);
+		return true;
+	}
+
+	void SoftwareRenderer::UpdateDirtyRegion()
+	{
+		const MeshData* pMesh{ m_pMeshes[0] };
+		const Matrix& worldMatrix{ pMesh->worldMatrix };
+
+		//The shading settings and the views' ones, any change shows everywhere on screen
+		const uint64_t settings{ static_cast<uint64_t>(GetShadingSettings()) |
+			static_cast<uint64_t>(m_ShowDepthBuffer) << 32 | static_cast<uint64_t>(m_UniformColor) << 33 | static_cast<uint64_t>(m_ShowBounding) << 34 |
+			static_cast<uint64_t>(m_ShowShadingLod) << 35 | static_cast<uint64_t>(m_BatchedShading) << 36 | static_cast<uint64_t>(m_TextureSpaceShading) << 37 | static_cast<uint64_t>(m_CoarseShading) << 38 | static_cast<uint64_t>(m_CheckerboardRendering) << 39 |
+			static_cast<uint64_t>(m_CullMode) << 40 | static_cast<uint64_t>(m_Multisampling) << 42 | static_cast<uint64_t>(m_PostProcessing) << 43 | static_cast<uint64_t>(m_TemporalRefreshInterval) << 48 };
+
+		//Shading atlas tiles that were shaded and pages that streamed in change the mesh's colours without moving it
+		const bool isShadingSettled{ m_ShadingAtlasRefreshCount == 0 && (!pMesh->material.pVirtualDiffuseMap || pMesh->material.pVirtualDiffuseMap->IsSettled()) };
+		const bool isViewUnchanged{ m_DirtyRegionsEnabled && !m_IsInvalidated && isShadingSettled && settings == m_RenderedSettings &&
+			m_pCamera->viewMatrix == m_RenderedViewMatrix && m_pCamera->projectionMatrix == m_RenderedProjectionMatrix };
+
+		ScreenRect bounds{};
+		const bool hasBounds{ GetScreenBounds(worldMatrix, bounds) };
+
+		m_DirtyRect = ScreenRect{ 0, 0, m_Width, m_Height };
+		bool isPending{};
+		if (isViewUnchanged && worldMatrix == m_RenderedWorldMatrix)
+		{
+			//Without checkerboard rendering or temporal reuse there is nothing pending and the frame is skipped
+			const ScreenRect& checkerboard{ m_CheckerboardPendingRect };
+			const ScreenRect temporal{ m_TemporalPendingFrames > 0 ? m_TemporalPendingRect : ScreenRect{} };
+			const bool hasCheckerboard{ checkerboard.left < checkerboard.right && checkerboard.top < checkerboard.bottom };
+			const bool hasTemporal{ temporal.left < temporal.right && temporal.top < temporal.bottom };
+
+			m_DirtyRect = hasCheckerboard ? checkerboard : temporal;
+			if (hasCheckerboard && hasTemporal)
+			{
+				m_DirtyRect = ScreenRect{ std::min(checkerboard.left, temporal.left), std::min(checkerboard.top, temporal.top),
+					std::max(checkerboard.right, temporal.right), std::max(checkerboard.bottom, temporal.bottom) };
+			}
+			isPending = true;
+		}
+		else if (isViewUnchanged && hasBounds && m_HasRenderedBounds)
+		{
+			//Where the mesh was, to clear it, and where it is now
+			m_DirtyRect = ScreenRect{ std::min(bounds.left, m_RenderedBounds.left), std::min(bounds.top, m_RenderedBounds.top),
+				std::max(bounds.right, m_RenderedBounds.right), std::max(bounds.bottom, m_RenderedBounds.bottom) };
+		}
+
+		m_CheckerboardPendingRect = m_CheckerboardRendering && !isPending ? m_DirtyRect : ScreenRect{};
+
+		//Every pixel is shaded at least once per refresh interval, that many full frames after a change the history is all fresh
+		if (!isPending)
+		{
+			m_TemporalPendingRect = m_DirtyRect;
+			m_TemporalPendingFrames = m_TemporalCache.IsEnabled() ? m_TemporalRefreshInterval : 0;
+		}
+		else if (m_TemporalPendingFrames > 0)
+		{
+			--m_TemporalPendingFrames;
+		}
+
+		m_RenderedViewMatrix = m_pCamera->viewMatrix;
+		m_RenderedProjectionMatrix = m_pCamera->projectionMatrix;
+		m_RenderedWorldMatrix = worldMatrix;
+		m_RenderedSettings = settings;
+		m_RenderedBounds = bounds;
+		m_HasRenderedBounds = hasBounds;
+		m_IsInvalidated = false;
+	}
+
+	void SoftwareRenderer::UpdateShadingAtlas()
+	{
+		const MeshData* pMesh{ m_pMeshes[0] };
+		if (!m_ShadingAtlas.IsBaked())
+		{
+			m_ShadingAtlas.Bake(*pMesh);
+		}
+
+		const uint32_t settings{ GetShadingSettings() };
+		if (settings != m_ShadingAtlasSettings)
+		{
+			m_ShadingAtlas.Invalidate();
+			m_ShadingAtlasSettings = settings;
+		}
+
+		//The mesh turns under the light, so staleness is measured in object space
+		const Matrix& worldMatrix{ pMesh->worldMatrix };
+		const Matrix worldToObject{ Matrix::Inverse(worldMatrix) };
+		const Vector3 objectLightDirection{ worldToObject.TransformVector(m_LightDirection).Normalized() };
+		const Vector3 objectEye{ worldToObject.TransformPoint(m_pCamera->origin) };
+
+		const MaterialBinding material{ pMesh->material.Bind() };
+		const Vector3 eye{ m_pCamera->origin };
+
+		//Builds what the rasterizer would have interpolated for a pixel on this texel
+		m_ShadingAtlasRefreshCount = m_ShadingAtlas.Refresh(objectLightDirection, objectEye, ShadingAtlasMaxStaleAngle, ShadingAtlasTilesPerUpdate,
+			[&](const ShadingAtlas::Texel& texel, const Vector2& uv)
+			{
+				Vertex_Out vertexOut{};
+				vertexOut.uv = uv;
+				vertexOut.worldPosition = worldMatrix.TransformPoint(texel.position);
+				vertexOut.normal = worldMatrix.TransformVector(texel.normal).Normalized();
+				vertexOut.tangent = worldMatrix.TransformVector(texel.tangent).Normalized();
+				vertexOut.viewDirection = (vertexOut.worldPosition - eye).Normalized();
+
+				if (m_TangentSpaceLighting)
+				{
+					const Vector3 biNormal{ Vector3::Cross(vertexOut.normal, vertexOut.tangent).Normalized() };
+					const Vector3& viewDirection{ vertexOut.viewDirection };
+
+					vertexOut.tangentLightDirection = Vector3{ Vector3::Dot(m_LightDirection, vertexOut.tangent), Vector3::Dot(m_LightDirection, biNormal), Vector3::Dot(m_LightDirection, vertexOut.normal) }.Normalized();
+					vertexOut.tangentViewDirection = Vector3{ Vector3::Dot(viewDirection, vertexOut.tangent), Vector3::Dot(viewDirection, biNormal), Vector3::Dot(viewDirection, vertexOut.normal) }.Normalized();
+				}
+
+				return ShadePixel(vertexOut, m_ShadingAtlas.GetUvLod(), material);
+			});
+	}
+
+	void SoftwareRenderer::UpdateShadingLod()
+	{
+		const Matrix& worldMatrix{ m_pMeshes[0]->worldMatrix };
+
+		//Diameter of the bounding sphere on screen, the largest axis scale keeps it a bound
+		const float scale{ std::max({ worldMatrix[0].GetXYZ().Magnitude(), worldMatrix[1].GetXYZ().Magnitude(), worldMatrix[2].GetXYZ().Magnitude() }) };
+		const float radius{ m_BoundsRadius * scale };
+		const float viewDepth{ m_pCamera->viewMatrix.TransformPoint(worldMatrix.TransformPoint(m_BoundsCenter)).z };
+
+		//With the camera inside the sphere it covers the screen
+		m_ProjectedSize = viewDepth > radius ? radius * m_pCamera->projectionMatrix[1].y * m_OutputHeight / viewDepth : FLT_MAX;
+
+		m_ShadingLod = ShadingLod::Full;
+		if (m_ShadingLodEnabled && m_ProjectedSize < m_GouraudLodSize)
+		{
+			m_ShadingLod = ShadingLod::Gouraud;
+		}
+		else if (m_ShadingLodEnabled && m_ProjectedSize < m_NoNormalMapLodSize)
+		{
+			m_ShadingLod = ShadingLod::NoNormalMap;
+		}
+
+		//Local lights are culled per tile after the depth prepass, the vertices are lit before there are tiles
+		if (m_ShadingLod == ShadingLod::Gouraud && !m_Lights.empty())
+		{
+			m_ShadingLod = ShadingLod::NoNormalMap;
+		}
+
+		//The whole uv chart spread over the projected size, in the pixels that are rendered
+		const float renderedSize{ m_ProjectedSize * m_Height / m_OutputHeight };
+		m_GouraudUvLod = -std::log2(std::max(renderedSize, 1.0f));
+	}
+
+	void SoftwareRenderer::AddLight(const Light& light)
+	{
+		m_Lights.push_back(light);
+		m_IsInvalidated = true;
+	}
+
+	void SoftwareRenderer::ClearLights()
+	{
+		m_Lights.clear();
+		m_IsInvalidated = true;
+	}
+
+	int SoftwareRenderer::GetLightCount() const
+	{
+		return static_cast<int>(m_Lights.size());
+	}
 
-		m_ShadingMode = shadingMode;
-		m_ShowDepthBuffer = showDepthBuffer;
-		m_UniformColor = uniformColor;
-		m_ShowBounding = showBounding;
-		m_NormalMapEnabled = renderNormal;
-		m_CullMode = cullMode;
+	void SoftwareRenderer::Update(const Timer* pTimer, const SoftwareShadingSettings& settings)
+	{
+		m_pCamera->Update(pTimer);
 
-		if (shouldRotate)
+		m_ShadingMode = settings.shadingMode;
+		m_ShowDepthBuffer = settings.showDepthBuffer;
+		m_UniformColor = settings.uniformColor;
+		m_ShowBounding = settings.showBounding;
+		m_NormalMapEnabled = settings.renderNormal;
+		//Local lights need world space normals, the tangent frame only holds the directional light
+		m_TangentSpaceLighting = settings.tangentSpaceLighting && m_Lights.empty();
+		m_BatchedShading = settings.batchedShading;
+		m_FixedPointShading = settings.fixedPointShading;
+		m_ShadowsEnabled = settings.shadows;
+		m_ShadingLodEnabled = settings.shadingLod;
+		m_ShowShadingLod = settings.showShadingLod;
+		m_TextureSpaceShading = settings.textureSpaceShading;
+		m_TemporalRefreshInterval = settings.temporalRefreshInterval;
+		m_DirtyRegionsEnabled = settings.dirtyRegions;
+		//Rates picked before it was turned off are about another view
+		if (settings.coarseShading != m_CoarseShading)
+		{
+			m_ShadingRateMap.Reset();
+		}
+		m_CoarseShading = settings.coarseShading;
+		m_CheckerboardRendering = settings.checkerboard;
+		m_Multisampling = settings.multisampling;
+		m_PostProcessing = settings.postProcessing;
+		m_PostProcess.SetSettings(m_PostProcessing ? m_PostProcessSettings : PostProcess::Settings{});
+		UpdateSpecularTable(m_pMeshes[0]->material.shininess);
+		m_CullMode = settings.cullMode;
+		m_SamplerState = SamplerState::FromSampleMode(settings.sampleMode, settings.addressMode);
+		m_SamplerState.filter = std::min(m_SamplerState.filter, m_TextureFilterLimit);
+
+		if (settings.shouldRotate)
 		{
 			for (auto pMesh : m_pMeshes)
 			{
 				const float degPerSec{ 25.0f };
 				pMesh->AddRotationY((degPerSec * pTimer->GetElapsed()) * TO_RADIANS);
 			}
-		}		
+		}
+
+		UpdateShadingLod();
+
+		//Only re-rendered when the mesh turned or the light moved since the last frame
+		if (m_ShadowsEnabled)
+		{
+			m_ShadowMap.Update({ m_pMeshes[0] }, m_LightDirection);
+		}
+
+		//Last, the texels are shaded with this frame's rotation, shading LOD and shadow map
+		m_ShadingAtlasRefreshCount = 0;
+		if (m_TextureSpaceShading && m_Lights.empty() && m_ShadingLod != ShadingLod::Gouraud)
+		{
+			UpdateShadingAtlas();
+		}
+
+		//The history only holds shaded colours, not the debug views' ones
+		const bool isTemporalReused{ m_TemporalRefreshInterval > 0 && m_ShadingLod != ShadingLod::Gouraud && !m_ShowDepthBuffer && !m_ShowShadingLod && !m_ShowBounding };
+		m_TemporalCache.BeginFrame(isTemporalReused ? m_TemporalRefreshInterval : 0, GetShadingSettings());
+
+		UpdateDirtyRegion();
 	}
 
 	void SoftwareRenderer::Render() const
 	{
+		//Nothing changed since the last frame, what is on screen is still right
+		if (IsFrameSkipped())
+		{
+			return;
+		}
+
 		SDL_LockSurface(m_pBackBuffer);
 
-		VertexTransformationFunction();
+		Rasterize(m_DirtyRect, true);
+
+		//The linear frame into the back buffer's format, once; FXAA reads around every pixel, the ones next to the dirty
+		//rectangle change with it
+		const int reach{ m_PostProcess.GetReach() };
+		const ScreenRect resolvedRect{ std::max(m_DirtyRect.left - reach, 0), std::max(m_DirtyRect.top - reach, 0),
+			std::min(m_DirtyRect.right + reach, m_Width), std::min(m_DirtyRect.bottom + reach, m_Height) };
+		const bool isScaled{ !m_ResolvedPixels.empty() };
+		uint32_t* pResolvedPixels{ isScaled ? m_ResolvedPixels.data() : static_cast<uint32_t*>(m_pBackBuffer->pixels) };
+		const SDL_PixelFormat* pFormat{ m_pBackBuffer->format };
+		m_PostProcess.Apply(m_ColourBuffer.data(), pResolvedPixels, m_Width, m_Height, resolvedRect.left, resolvedRect.top, resolvedRect.right, resolvedRect.bottom,
+			pFormat->Rmask, pFormat->Gmask, pFormat->Bmask, pFormat->Amask);
+
+		SDL_Rect dirtyRect{ resolvedRect.left, resolvedRect.top, resolvedRect.right - resolvedRect.left, resolvedRect.bottom - resolvedRect.top };
+		if (isScaled)
+		{
+			Upscale(pResolvedPixels, resolvedRect, dirtyRect);
+		}
 
-		std::fill_n(m_pDepthBufferPixels, m_Width * m_Height, FLT_MAX);
+		SDL_UnlockSurface(m_pBackBuffer);
+		//The blit clips the destination rectangle in place
+		SDL_Rect presentRect{ dirtyRect };
+		SDL_BlitSurface(m_pBackBuffer, &dirtyRect, m_pFrontBuffer, &presentRect);
+		SDL_UpdateWindowSurfaceRects(m_pWindow, &dirtyRect, 1);
+	}
 
-		if (!m_UniformColor)
+	void SoftwareRenderer::Rasterize(const ScreenRect& rect, bool isPresented) const
+	{
+		//Before the vertices, they only carry their last position when something needs the motion
+		if (isPresented)
 		{
-			SDL_FillRect(m_pBackBuffer, NULL, SDL_MapRGB(m_pBackBuffer->format, 100, 100, 100));
+			m_Checkerboard.BeginFrame(m_CheckerboardRendering && !m_ShowBounding);
 		}
-		else
+		const bool isCheckerboard{ isPresented && m_Checkerboard.IsEnabled() };
+		const int pixelStep{ isCheckerboard ? 2 : 1 };
+
+		VertexTransformationFunction();
+
+		//Outside of the rectangle the last frame's colours and depths are still right
+		const int rectWidth{ rect.right - rect.left };
+		const HdrPixel clearColor{ !m_UniformColor ? ToHdrPixel(ColorRGB{ 100.0f, 100.0f, 100.0f } / 255.0f) : ToHdrPixel(ColorRGB{ 25.0f, 25.0f, 25.0f } / 255.0f) };
+		for (int py{ rect.top }; py < rect.bottom; ++py)
 		{
-			SDL_FillRect(m_pBackBuffer, NULL, SDL_MapRGB(m_pBackBuffer->format, 25, 25, 25));
+			std::fill_n(m_pDepthBufferPixels + rect.left + (py * m_Width), rectWidth, FLT_MAX);
+			std::fill_n(m_ColourBuffer.data() + rect.left + (py * m_Width), rectWidth, clearColor);
 		}
 
+		m_Multisample.BeginFrame(m_Multisampling, rect.left, rect.top, rect.right, rect.bottom, clearColor);
+		const bool isMultisampled{ m_Multisample.IsEnabled() };
+		//The samples reach past the pixel's own sample point, so do the pixels a triangle touches
+		const float sampleReach{ isMultisampled ? 0.5f : 0.0f };
+
 		auto pMesh{ m_pMeshes[0] };
 
+		//Resolve the texture slots once, the pixel shader only follows raw pointers
+		const MaterialBinding material{ pMesh->material.Bind() };
+
+		//Covered pixels are queued here and shaded once the batch is full, the fixed point shading only exists batched
+		FragmentBatch batch{};
+		//Debug views only exist in the per pixel path, gouraud shading has nothing left to shade
+		const bool isGouraud{ m_ShadingLod == ShadingLod::Gouraud && !m_ShowDepthBuffer };
+		const bool isBatched{ (m_BatchedShading || m_FixedPointShading) && !m_ShowDepthBuffer && !m_ShowShadingLod && !isGouraud };
+		//Same conditions Update refreshed the atlas under, a frame that is not presented shades every fragment itself
+		const bool isTextureSpaceShaded{ isPresented && m_TextureSpaceShading && m_Lights.empty() && !isGouraud && !m_ShowDepthBuffer };
+		//Update decided whether this frame reuses the last one
+		const bool isTemporalReused{ isPresented && m_TemporalCache.IsEnabled() };
+		const bool isCoarseShaded{ isPresented && m_CoarseShading && !isGouraud && !m_ShowDepthBuffer && !m_ShowShadingLod && !m_ShowBounding };
+		if (isCoarseShaded)
+		{
+			m_ShadingRateMap.BeginFrame();
+		}
+
+		//Batched coarse shading: the first fragment of every block is queued here, the block's other pixels wait for its lane
+		struct CoarseCopy
+		{
+			int pixelIndex{};
+			int sampleMask{};
+			int lane{};
+		};
+		FragmentBatch coarseBatch{};
+		HdrPixel coarseColours[FragmentBatch::Size]{};
+		float coarseViewDepths[FragmentBatch::Size]{};
+		std::vector<CoarseCopy> coarseCopies{};
+		coarseBatch.pShadedPixels = coarseColours;
+
+		const auto shadeCoarseBatch{ [&]()
+			{
+				const int count{ coarseBatch.count };
+				ShadeBatch(coarseBatch, material);
+
+				for (int lane{}; lane < count; ++lane)
+				{
+					const int pixelIndex{ coarseBatch.pixelIndices[lane] };
+					m_ShadingRateMap.Store(pixelIndex % m_Width, pixelIndex / m_Width, coarseViewDepths[lane], ToColorRGB(coarseColours[lane]));
+				}
+
+				for (const CoarseCopy& copy : coarseCopies)
+				{
+					WritePixel(copy.pixelIndex, coarseColours[copy.lane], copy.sampleMask);
+				}
+				coarseCopies.clear();
+			} };
+
 		//Change how the for loop advances based on the primitive topology
 		int size = 0;
 		std::vector<Vertex_Out> transformedVertices{ pMesh->vertices_out };
@@ -84,244 +588,564 @@ namespace dae
 			size = (int)pMesh->indices.size() - 2;
 		}
 
-		for (int i{}; i < size;)
-		{
-			int evenIndex{};
-			if (pMesh->primitiveTopology == PrimitiveTopology::TriangleStrip)
-			{
-				evenIndex = i % 2;
-			}
-
-			int index0{ (int)pMesh->indices[i] };
-			int index1{ (int)pMesh->indices[i + 1 + evenIndex] };
-			int index2{ (int)pMesh->indices[i + 2 - evenIndex] };
+		//With local lights the depths go in first, so every tile knows its depth range before its lights are culled
+		//and every pixel is shaded once, by the fragment that won the prepass
+		const bool hasDepthPrepass{ !m_Lights.empty() };
 
-			//Increase i based on primitiveTopology
-			if (pMesh->primitiveTopology == PrimitiveTopology::TriangleList)
-			{
-				i += 3;
-			}
-			else if (pMesh->primitiveTopology == PrimitiveTopology::TriangleStrip)
+		for (int pass{ hasDepthPrepass ? 0 : 1 }; pass < 2; ++pass)
+		{
+			const bool isDepthPass{ pass == 0 };
+			if (hasDepthPrepass && !isDepthPass)
 			{
-				++i;
+				CullLights();
 			}
 
-			//Calculate the points of the triangle
-			Vector4 v0{ transformedVertices[index0].position };
-			Vector4 v1{ transformedVertices[index1].position };
-			Vector4 v2{ transformedVertices[index2].position };
-
-			//Frustum Culling
-			if (v0.x < -1.0f || v0.x > 1.0f || v0.y < -1.0f || v0.y > 1.0f || v0.z < 0.0f || v0.z > 1.0f ||
-				v1.x < -1.0f || v1.x > 1.0f || v1.y < -1.0f || v1.y > 1.0f || v1.z < 0.0f || v1.z > 1.0f ||
-				v2.x < -1.0f || v2.x > 1.0f || v2.y < -1.0f || v2.y > 1.0f || v2.z < 0.0f || v2.z > 1.0f)
+			for (int i{}; i < size;)
 			{
-				continue;
-			}
-
-			//Pre-calculate value for the depth buffer -> depth buffer will not be linear anymore
-			float v0InvDepth{ 1 / v0.w };
-			float v1InvDepth{ 1 / v1.w };
-			float v2InvDepth{ 1 / v2.w };
-
-			//Convert from NDC to raster space
-			//Go from [-1,1] range to [0,1] range, taking screen size into acount
-			v0.x = ((v0.x + 1) / 2.0f) * m_Width;
-			v0.y = ((1 - v0.y) / 2.0f) * m_Height;
+				int evenIndex{};
+				if (pMesh->primitiveTopology == PrimitiveTopology::TriangleStrip)
+				{
+					evenIndex = i % 2;
+				}
 
-			v1.x = ((v1.x + 1) / 2.0f) * m_Width;
-			v1.y = ((1 - v1.y) / 2.0f) * m_Height;
+				int index0{ (int)pMesh->indices[i] };
+				int index1{ (int)pMesh->indices[i + 1 + evenIndex] };
+				int index2{ (int)pMesh->indices[i + 2 - evenIndex] };
 
-			v2.x = ((v2.x + 1) / 2.0f) * m_Width;
-			v2.y = ((1 - v2.y) / 2.0f) * m_Height;
+				//Triangles whose texels the atlas holds another surface's colours for are shaded per pixel
+				const int triangle{ pMesh->primitiveTopology == PrimitiveTopology::TriangleStrip ? i : i / 3 };
+				const bool isAtlasShaded{ isTextureSpaceShaded && !m_ShadingAtlas.HasSharedTexels(triangle) };
 
-			//Calculate the bounding box
-			float xMin = std::min(std::min(v0.x, v1.x), v2.x);
-			float xMax = std::max(std::max(v0.x, v1.x), v2.x);
+				//Increase i based on primitiveTopology
+				if (pMesh->primitiveTopology == PrimitiveTopology::TriangleList)
+				{
+					i += 3;
+				}
+				else if (pMesh->primitiveTopology == PrimitiveTopology::TriangleStrip)
+				{
+					++i;
+				}
 
-			float yMin = std::min(std::min(v0.y, v1.y), v2.y);
-			float yMax = std::max(std::max(v0.y, v1.y), v2.y);
+				//Calculate the points of the triangle
+				Vector4 v0{ transformedVertices[index0].position };
+				Vector4 v1{ transformedVertices[index1].position };
+				Vector4 v2{ transformedVertices[index2].position };
 
-			for (int py{ (int)yMin }; py < yMax; ++py)
-			{
-				for (int px{ (int)xMin }; px < xMax; ++px)
+				//Frustum Culling
+				if (v0.x < -1.0f || v0.x > 1.0f || v0.y < -1.0f || v0.y > 1.0f || v0.z < 0.0f || v0.z > 1.0f ||
+					v1.x < -1.0f || v1.x > 1.0f || v1.y < -1.0f || v1.y > 1.0f || v1.z < 0.0f || v1.z > 1.0f ||
+					v2.x < -1.0f || v2.x > 1.0f || v2.y < -1.0f || v2.y > 1.0f || v2.z < 0.0f || v2.z > 1.0f)
 				{
-					ColorRGB finalColor{ 0.f, 0.f, 0.f };
+					continue;
+				}
 
-					if (m_ShowBounding)
-					{
-						finalColor = { 1.0f,1.0f,1.0f };
+				//Pre-calculate value for the depth buffer -> depth buffer will not be linear anymore
+				float v0InvDepth{ 1 / v0.w };
+				float v1InvDepth{ 1 / v1.w };
+				float v2InvDepth{ 1 / v2.w };
 
-						finalColor.MaxToOne();
+				//Convert from NDC to raster space
+				//Go from [-1,1] range to [0,1] range, taking screen size into acount
+				v0.x = ((v0.x + 1) / 2.0f) * m_Width;
+				v0.y = ((1 - v0.y) / 2.0f) * m_Height;
 
-						m_pBackBufferPixels[px + (py * m_Width)] = SDL_MapRGB(m_pBackBuffer->format,
-							static_cast<uint8_t>(finalColor.r * 255),
-							static_cast<uint8_t>(finalColor.g * 255),
-							static_cast<uint8_t>(finalColor.b * 255));
+				v1.x = ((v1.x + 1) / 2.0f) * m_Width;
+				v1.y = ((1 - v1.y) / 2.0f) * m_Height;
 
-						continue;
-					}
+				v2.x = ((v2.x + 1) / 2.0f) * m_Width;
+				v2.y = ((1 - v2.y) / 2.0f) * m_Height;
 
-					//Current pixel
-					Vector2 pixel{ (float)px,(float)py };
+				//Calculate the bounding box
+				float xMin = std::min(std::min(v0.x, v1.x), v2.x);
+				float xMax = std::max(std::max(v0.x, v1.x), v2.x);
 
-					//Check if the current pixel overlaps the triangle formed by the vertices
-				//2D cross product gives a float, based on sign we know if the point is inside the triangle
-					Vector2 edge0{ {v1.x - v0.x}, {v1.y - v0.y} };
-					Vector2 pointToEdge0{ Vector2{v0.x, v0.y }, pixel };
-					float cross0{ Vector2::Cross(edge0, pointToEdge0) };
+				float yMin = std::min(std::min(v0.y, v1.y), v2.y);
+				float yMax = std::max(std::max(v0.y, v1.y), v2.y);
 
-					Vector2 edge1{ {v2.x - v1.x}, {v2.y - v1.y} };
-					Vector2 pointToEdge1{ Vector2{v1.x, v1.y }, pixel };
-					float cross1{ Vector2::Cross(edge1, pointToEdge1) };
+				//Multisampling: how much every edge function changes from the pixel's sample point to each of its samples,
+				//and the perspective depth weights the edge functions are multiplied by
+				__m128 sampleSteps0{}, sampleSteps1{}, sampleSteps2{};
+				__m128 sampleDepthWeight0{}, sampleDepthWeight1{}, sampleDepthWeight2{};
+				if (isMultisampled)
+				{
+					const __m128 offsetX{ _mm_loadu_ps(MultisampleBuffer::SampleOffsetsX) };
+					const __m128 offsetY{ _mm_loadu_ps(MultisampleBuffer::SampleOffsetsY) };
+					const auto edgeSteps{ [&](const Vector4& from, const Vector4& to)
+						{
+							return _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(to.x - from.x), offsetY), _mm_mul_ps(_mm_set1_ps(to.y - from.y), offsetX));
+						} };
+					sampleSteps0 = edgeSteps(v0, v1);
+					sampleSteps1 = edgeSteps(v1, v2);
+					sampleSteps2 = edgeSteps(v2, v0);
+
+					//Weight of v0 is edge function 1 over the area, of v1 edge function 2 and of v2 edge function 0
+					const float area{ Vector2::Cross(Vector2{ v1.x - v0.x, v1.y - v0.y }, Vector2{ v2.x - v1.x, v2.y - v1.y }) };
+					sampleDepthWeight0 = _mm_set1_ps(1.0f / (v2.z * area));
+					sampleDepthWeight1 = _mm_set1_ps(1.0f / (v0.z * area));
+					sampleDepthWeight2 = _mm_set1_ps(1.0f / (v1.z * area));
+				}
 
-					Vector2 edge2{ {v0.x - v2.x}, {v0.y - v2.y} };
-					Vector2 pointToEdge2{ Vector2{v2.x, v2.y }, pixel };
-					float cross2{ Vector2::Cross(edge2, pointToEdge2) };
+				//Mip selection: log2 of the uv distance covered by one pixel, kept constant over the triangle
+				float uvLod{};
+				{
+					const Vector2& uv0{ transformedVertices[index0].uv };
+					const Vector2& uv1{ transformedVertices[index1].uv };
+					const Vector2& uv2{ transformedVertices[index2].uv };
 
-					bool isPointInTriangle{};
+					const float screenArea{ std::abs(Vector2::Cross(Vector2{ v1.x - v0.x, v1.y - v0.y }, Vector2{ v2.x - v0.x, v2.y - v0.y })) };
+					const float uvArea{ std::abs(Vector2::Cross(uv1 - uv0, uv2 - uv0)) };
 
-					switch (m_CullMode)
+					if (screenArea > 0.0f && uvArea > 0.0f)
 					{
-					case dae::CullMode::BackFace:
-						isPointInTriangle = cross0 > 0.0f && cross1 > 0.0f && cross2 > 0.0f;
-						break;
-					case dae::CullMode::FrontFace:
-						isPointInTriangle = cross0 < 0.0f && cross1 < 0.0f && cross2 < 0.0f;
-						break;
-					case dae::CullMode::DoubleFace:
-						isPointInTriangle = cross0 >= 0.0f && cross1 >= 0.0f && cross2 >= 0.0f;
-						break;
-					default:
-						break;
+						uvLod = 0.5f * std::log2f(uvArea / screenArea);
 					}
+				}
 
-					if (isPointInTriangle)
+				for (int py{ std::max((int)(yMin - sampleReach), rect.top) }; py < yMax + sampleReach && py < rect.bottom; ++py)
+				{
+					//With checkerboard rendering, only this frame's half of the row
+					const int firstPixel{ std::max((int)(xMin - sampleReach), rect.left) };
+					for (int px{ isCheckerboard ? m_Checkerboard.GetFirstRendered(firstPixel, py) : firstPixel }; px < xMax + sampleReach && px < rect.right; px += pixelStep)
 					{
-						//Calculate the barycentric coordinates
-						//2D cross product of V1V0 and V2V0
-						float areaOfparallelogram{ Vector2::Cross(edge0, edge1) };
-
-						//Calculate the weights
-						float w0{ Vector2::Cross(edge1, pointToEdge1) / areaOfparallelogram };
-						float w1{ Vector2::Cross(edge2, pointToEdge2) / areaOfparallelogram };
-						float w2{ Vector2::Cross(edge0, pointToEdge0) / areaOfparallelogram };
+						ColorRGB finalColor{ 0.f, 0.f, 0.f };
 
-						if (w0 >= 0.0f && w1 >= 0.0f && w2 >= 0.0f)
+						if (m_ShowBounding)
 						{
-							//Do the depth buffer test
-							float zBuffer0{ (1.0f / v0.z) * w0 };
-							float zBuffer1{ (1.0f / v1.z) * w1 };
-							float zBuffer2{ (1.0f / v2.z) * w2 };
-
-							float zBuffer{ zBuffer0 + zBuffer1 + zBuffer2 };
-							float invZBuffer{ 1.0f / zBuffer };
-
-							if (invZBuffer < 0.0f || invZBuffer > 1.0f)
-							{
-								break;
-							}
-
-							if (invZBuffer < m_pDepthBufferPixels[px + (py * m_Width)])
-							{
-								//Write value of invZbuffer to the depthBuffer
-								m_pDepthBufferPixels[px + (py * m_Width)] = invZBuffer;
+							finalColor = { 1.0f,1.0f,1.0f };
 
-								//Interpolated the depth value
-								float wInterpolated{ 1.0f / ((w0 / v0.w) + (w1 / v1.w) + (w2 / v2.w)) };
+							WritePixel(px + (py * m_Width), ToHdrPixel(finalColor), MultisampleBuffer::FullCoverage);
 
-								//Interpolated colour
-								ColorRGB interpolatedColour{ transformedVertices[index0].color * (w0 / v0.w) +
-															transformedVertices[index1].color * (w1 / v1.w) +
-															transformedVertices[index2].color * (w2 / v2.w) };
-								interpolatedColour *= wInterpolated;
+							continue;
+						}
 
+						//Current pixel
+						Vector2 pixel{ (float)px,(float)py };
 
+						//Check if the current pixel overlaps the triangle formed by the vertices
+					//2D cross product gives a float, based on sign we know if the point is inside the triangle
+						Vector2 edge0{ {v1.x - v0.x}, {v1.y - v0.y} };
+						Vector2 pointToEdge0{ Vector2{v0.x, v0.y }, pixel };
+						float cross0{ Vector2::Cross(edge0, pointToEdge0) };
 
-								//Interpolated uv
-								Vector2 interpolatedUV{ transformedVertices[index0].uv * (w0 / v0.w) +
-														transformedVertices[index1].uv * (w1 / v1.w) +
-														transformedVertices[index2].uv * (w2 / v2.w) };
-								interpolatedUV *= wInterpolated;
+						Vector2 edge1{ {v2.x - v1.x}, {v2.y - v1.y} };
+						Vector2 pointToEdge1{ Vector2{v1.x, v1.y }, pixel };
+						float cross1{ Vector2::Cross(edge1, pointToEdge1) };
 
+						Vector2 edge2{ {v0.x - v2.x}, {v0.y - v2.y} };
+						Vector2 pointToEdge2{ Vector2{v2.x, v2.y }, pixel };
+						float cross2{ Vector2::Cross(edge2, pointToEdge2) };
 
+						bool isPointInTriangle{};
 
-								//Interpolated normal
-								Vector3 interpolatedNormal{ transformedVertices[index0].normal * (w0 / v0.w) +
-															transformedVertices[index1].normal * (w1 / v1.w) +
-															transformedVertices[index2].normal * (w2 / v2.w) };
-								interpolatedNormal *= wInterpolated;
-								//Normalize direction vectors!
-								interpolatedNormal.Normalize();
+						switch (m_CullMode)
+						{
+						case dae::CullMode::BackFace:
+							isPointInTriangle = cross0 > 0.0f && cross1 > 0.0f && cross2 > 0.0f;
+							break;
+						case dae::CullMode::FrontFace:
+							isPointInTriangle = cross0 < 0.0f && cross1 < 0.0f && cross2 < 0.0f;
+							break;
+						case dae::CullMode::DoubleFace:
+							isPointInTriangle = cross0 >= 0.0f && cross1 >= 0.0f && cross2 >= 0.0f;
+							break;
+						default:
+							break;
+						}
 
+						//Multisampling replaces the test at the pixel's sample point by the same test at each of its samples
+						__m128 coveredSamples{};
+						__m128 sampleDepths{};
+						if (isMultisampled)
+						{
+							const __m128 sampleCross0{ _mm_add_ps(_mm_set1_ps(cross0), sampleSteps0) };
+							const __m128 sampleCross1{ _mm_add_ps(_mm_set1_ps(cross1), sampleSteps1) };
+							const __m128 sampleCross2{ _mm_add_ps(_mm_set1_ps(cross2), sampleSteps2) };
+							const __m128 zero{ _mm_setzero_ps() };
 
+							switch (m_CullMode)
+							{
+							case dae::CullMode::BackFace:
+								coveredSamples = _mm_and_ps(_mm_and_ps(_mm_cmpgt_ps(sampleCross0, zero), _mm_cmpgt_ps(sampleCross1, zero)), _mm_cmpgt_ps(sampleCross2, zero));
+								break;
+							case dae::CullMode::FrontFace:
+								coveredSamples = _mm_and_ps(_mm_and_ps(_mm_cmplt_ps(sampleCross0, zero), _mm_cmplt_ps(sampleCross1, zero)), _mm_cmplt_ps(sampleCross2, zero));
+								break;
+							case dae::CullMode::DoubleFace:
+								coveredSamples = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(sampleCross0, zero), _mm_cmpge_ps(sampleCross1, zero)), _mm_cmpge_ps(sampleCross2, zero));
+								break;
+							default:
+								break;
+							}
 
-								//Interpolated tangent
-								Vector3 interpolatedTangent{ transformedVertices[index0].tangent * (w0 / v0.w) +
-															transformedVertices[index1].tangent * (w1 / v1.w) +
-															transformedVertices[index2].tangent * (w2 / v2.w) };
-								interpolatedTangent *= wInterpolated;
-								//Normalize direction vectors!
-								interpolatedTangent.Normalize();
+							//Same depth as below, from the edge functions instead of the weights
+							sampleDepths = _mm_div_ps(_mm_set1_ps(1.0f), _mm_add_ps(_mm_add_ps(_mm_mul_ps(sampleCross0, sampleDepthWeight0),
+								_mm_mul_ps(sampleCross1, sampleDepthWeight1)), _mm_mul_ps(sampleCross2, sampleDepthWeight2)));
+							coveredSamples = _mm_and_ps(coveredSamples, _mm_and_ps(_mm_cmpge_ps(sampleDepths, zero), _mm_cmple_ps(sampleDepths, _mm_set1_ps(1.0f))));
+							isPointInTriangle = _mm_movemask_ps(coveredSamples) != 0;
+						}
 
+						if (isPointInTriangle)
+						{
+							//Calculate the barycentric coordinates
+							//2D cross product of V1V0 and V2V0
+							float areaOfparallelogram{ Vector2::Cross(edge0, edge1) };
 
+							//Calculate the weights
+							float w0{ Vector2::Cross(edge1, pointToEdge1) / areaOfparallelogram };
+							float w1{ Vector2::Cross(edge2, pointToEdge2) / areaOfparallelogram };
+							float w2{ Vector2::Cross(edge0, pointToEdge0) / areaOfparallelogram };
 
-								//Interpolated viewDirection
-								Vector3 interpolatedViewDirection{ transformedVertices[index0].viewDirection * (w0 / v0.w) +
-																	transformedVertices[index1].viewDirection * (w1 / v1.w) +
-																	transformedVertices[index2].viewDirection * (w2 / v2.w) };
-								interpolatedViewDirection *= wInterpolated;
-								//Normalize direction vectors!
-								interpolatedViewDirection.Normalize();
+							//With multisampling the pixel's sample point may lie outside, its attributes are extrapolated
+							if (isMultisampled || (w0 >= 0.0f && w1 >= 0.0f && w2 >= 0.0f))
+							{
+								//Do the depth buffer test
+								float zBuffer0{ (1.0f / v0.z) * w0 };
+								float zBuffer1{ (1.0f / v1.z) * w1 };
+								float zBuffer2{ (1.0f / v2.z) * w2 };
 
+								float zBuffer{ zBuffer0 + zBuffer1 + zBuffer2 };
+								float invZBuffer{ 1.0f / zBuffer };
 
-								Vertex_Out pixelInfo{};
-								pixelInfo.position = Vector4{ pixel.x, pixel.y, invZBuffer, wInterpolated };
-								pixelInfo.uv = interpolatedUV;
-								pixelInfo.normal = interpolatedNormal;
-								pixelInfo.tangent = interpolatedTangent;
-								pixelInfo.viewDirection = interpolatedViewDirection;
+								if (!isMultisampled && (invZBuffer < 0.0f || invZBuffer > 1.0f))
+								{
+									break;
+								}
 
+								if (isDepthPass)
+								{
+									if (isMultisampled)
+									{
+										m_Multisample.TestDepth(px + (py * m_Width), sampleDepths, coveredSamples, false, m_pDepthBufferPixels[px + (py * m_Width)]);
+									}
+									else
+									{
+										m_pDepthBufferPixels[px + (py * m_Width)] = std::min(m_pDepthBufferPixels[px + (py * m_Width)], invZBuffer);
+									}
+									continue;
+								}
 
-								//Render the pixel
-								if (!m_ShowDepthBuffer)
+								int sampleMask{ MultisampleBuffer::FullCoverage };
+								bool isVisible{};
+								if (isMultisampled)
 								{
-									finalColor = ShadePixel(pixelInfo);
+									sampleMask = m_Multisample.TestDepth(px + (py * m_Width), sampleDepths, coveredSamples, hasDepthPrepass, m_pDepthBufferPixels[px + (py * m_Width)]);
+									isVisible = sampleMask != 0;
 								}
 								else
 								{
-									float depth{ (invZBuffer - 0.985f) / (1.0f - 0.985f) };
-									finalColor = { depth, depth, depth };
+									isVisible = hasDepthPrepass ?
+										invZBuffer == m_pDepthBufferPixels[px + (py * m_Width)] :
+										invZBuffer < m_pDepthBufferPixels[px + (py * m_Width)];
 								}
 
-								//Update Color in Buffer
-								finalColor.MaxToOne();
-
-								m_pBackBufferPixels[px + (py * m_Width)] = SDL_MapRGB(m_pBackBuffer->format,
-									static_cast<uint8_t>(finalColor.r * 255),
-									static_cast<uint8_t>(finalColor.g * 255),
-									static_cast<uint8_t>(finalColor.b * 255));
+								if (isVisible)
+								{
+									//Write value of invZbuffer to the depthBuffer, the sample test wrote it already
+									if (!isMultisampled)
+									{
+										m_pDepthBufferPixels[px + (py * m_Width)] = invZBuffer;
+									}
+
+									//Interpolated the depth value
+									float wInterpolated{ 1.0f / ((w0 / v0.w) + (w1 / v1.w) + (w2 / v2.w)) };
+
+									//Interpolated uv, gouraud shading only needs the vertices' colours
+									Vector2 interpolatedUV{};
+									if (!isGouraud)
+									{
+										interpolatedUV = (transformedVertices[index0].uv * (w0 / v0.w) +
+														transformedVertices[index1].uv * (w1 / v1.w) +
+														transformedVertices[index2].uv * (w2 / v2.w)) * wInterpolated;
+									}
+
+									//Where the fragment was in the last frame, clip space interpolates like any other attribute
+									Vector4 previousPosition{};
+									if (isTemporalReused || isCheckerboard)
+									{
+										previousPosition = (transformedVertices[index0].previousPosition * (w0 / v0.w) +
+															transformedVertices[index1].previousPosition * (w1 / v1.w) +
+															transformedVertices[index2].previousPosition * (w2 / v2.w)) * wInterpolated;
+									}
+
+									if (isCheckerboard)
+									{
+										m_Checkerboard.StoreMotion(px, py, previousPosition);
+									}
+
+									const int shadingRate{ isCoarseShaded ? m_ShadingRateMap.GetRate(px, py) : 1 };
+									const int queuedLane{ shadingRate > 1 && isBatched ? m_ShadingRateMap.GetQueuedLane(px, py, wInterpolated) : -1 };
+
+									HdrPixel historyColour{};
+									if (isGouraud)
+									{
+										//Interpolated colour
+										ColorRGB interpolatedColour{ transformedVertices[index0].color * (w0 / v0.w) +
+																	transformedVertices[index1].color * (w1 / v1.w) +
+																	transformedVertices[index2].color * (w2 / v2.w) };
+										interpolatedColour *= wInterpolated;
+										finalColor = interpolatedColour;
+									}
+									else if (isTemporalReused && m_TemporalCache.Reproject(px, py, previousPosition, historyColour))
+									{
+										//Already a colour buffer pixel
+										WritePixel(px + (py * m_Width), historyColour, sampleMask);
+										continue;
+									}
+									else if (isAtlasShaded && m_ShadingAtlas.Sample(interpolatedUV, finalColor))
+									{
+										//Shaded in texture space already, the cached colour is all there is to it
+									}
+									else if (queuedLane >= 0)
+									{
+										//The block's fragment still waits in the coarse batch, its colour is copied here once it is shaded
+										coarseCopies.push_back(CoarseCopy{ px + (py * m_Width), sampleMask, queuedLane });
+										continue;
+									}
+									else if (shadingRate > 1 && m_ShadingRateMap.Lookup(px, py, wInterpolated, finalColor))
+									{
+										//The block was shaded on this surface already
+									}
+									else
+									{
+										Vertex_Out pixelInfo{};
+										pixelInfo.position = Vector4{ pixel.x, pixel.y, invZBuffer, wInterpolated };
+										pixelInfo.uv = interpolatedUV;
+
+										if (!m_Lights.empty() || m_ShadowsEnabled)
+										{
+											//Interpolated world position, local lights and the shadow map are evaluated in world space
+											Vector3 interpolatedPosition{ transformedVertices[index0].worldPosition * (w0 / v0.w) +
+																		transformedVertices[index1].worldPosition * (w1 / v1.w) +
+																		transformedVertices[index2].worldPosition * (w2 / v2.w) };
+											interpolatedPosition *= wInterpolated;
+											pixelInfo.worldPosition = interpolatedPosition;
+										}
+
+										if (m_TangentSpaceLighting)
+										{
+											//Interpolated tangent space light direction
+											Vector3 interpolatedLightDirection{ transformedVertices[index0].tangentLightDirection * (w0 / v0.w) +
+																				transformedVertices[index1].tangentLightDirection * (w1 / v1.w) +
+																				transformedVertices[index2].tangentLightDirection * (w2 / v2.w) };
+											interpolatedLightDirection *= wInterpolated;
+											pixelInfo.tangentLightDirection = FastMath::Normalized(interpolatedLightDirection, m_MathAccuracy);
+
+											//Interpolated tangent space viewDirection
+											Vector3 interpolatedViewDirection{ transformedVertices[index0].tangentViewDirection * (w0 / v0.w) +
+																				transformedVertices[index1].tangentViewDirection * (w1 / v1.w) +
+																				transformedVertices[index2].tangentViewDirection * (w2 / v2.w) };
+											interpolatedViewDirection *= wInterpolated;
+											pixelInfo.tangentViewDirection = FastMath::Normalized(interpolatedViewDirection, m_MathAccuracy);
+										}
+										else
+										{
+											//Interpolated normal
+											Vector3 interpolatedNormal{ transformedVertices[index0].normal * (w0 / v0.w) +
+																		transformedVertices[index1].normal * (w1 / v1.w) +
+																		transformedVertices[index2].normal * (w2 / v2.w) };
+											interpolatedNormal *= wInterpolated;
+											//Normalize direction vectors!
+											interpolatedNormal = FastMath::Normalized(interpolatedNormal, m_MathAccuracy);
+
+
+
+											//Interpolated tangent
+											Vector3 interpolatedTangent{ transformedVertices[index0].tangent * (w0 / v0.w) +
+																		transformedVertices[index1].tangent * (w1 / v1.w) +
+																		transformedVertices[index2].tangent * (w2 / v2.w) };
+											interpolatedTangent *= wInterpolated;
+											//Normalize direction vectors!
+											interpolatedTangent = FastMath::Normalized(interpolatedTangent, m_MathAccuracy);
+
+
+
+											//Interpolated viewDirection
+											Vector3 interpolatedViewDirection{ transformedVertices[index0].viewDirection * (w0 / v0.w) +
+																				transformedVertices[index1].viewDirection * (w1 / v1.w) +
+																				transformedVertices[index2].viewDirection * (w2 / v2.w) };
+											interpolatedViewDirection *= wInterpolated;
+											//Normalize direction vectors!
+											interpolatedViewDirection = FastMath::Normalized(interpolatedViewDirection, m_MathAccuracy);
+
+											pixelInfo.normal = interpolatedNormal;
+											pixelInfo.tangent = interpolatedTangent;
+											pixelInfo.viewDirection = interpolatedViewDirection;
+										}
+
+
+										//Render the pixel
+										if (shadingRate > 1 && isBatched)
+										{
+											//First fragment of its block on this surface, shaded with the same path as the full rate pixels
+											//The textures are sampled a mip per halving of the rate coarser, as the block covers that much more
+											m_ShadingRateMap.Queue(px, py, wInterpolated, coarseBatch.count);
+											coarseViewDepths[coarseBatch.count] = wInterpolated;
+											coarseBatch.Push(px + (py * m_Width), pixelInfo, uvLod + (shadingRate == 4 ? 2.0f : 1.0f), sampleMask);
+											if (coarseBatch.IsFull())
+											{
+												shadeCoarseBatch();
+											}
+
+											continue;
+										}
+										else if (shadingRate > 1)
+										{
+											//Shaded right away for the others to copy
+											finalColor = ShadePixel(pixelInfo, uvLod + (shadingRate == 4 ? 2.0f : 1.0f), material);
+											m_ShadingRateMap.Store(px, py, wInterpolated, finalColor);
+										}
+										else if (isBatched)
+										{
+											batch.Push(px + (py * m_Width), pixelInfo, uvLod, sampleMask);
+											if (batch.IsFull())
+											{
+												ShadeBatch(batch, material);
+											}
+
+											continue;
+										}
+										else if (!m_ShowDepthBuffer)
+										{
+											finalColor = ShadePixel(pixelInfo, uvLod, material);
+										}
+										else
+										{
+											float depth{ (invZBuffer - 0.985f) / (1.0f - 0.985f) };
+											finalColor = { depth, depth, depth };
+										}
+									}
+
+									//Update Color in Buffer, unclamped: the resolve brings it into range
+									if (m_ShowShadingLod)
+									{
+										//Half the shaded colour, half green (full), yellow (no normal map) or red (gouraud)
+										constexpr ColorRGB lodTints[]{ { 0.0f, 1.0f, 0.0f }, { 1.0f, 1.0f, 0.0f }, { 1.0f, 0.0f, 0.0f } };
+										finalColor = finalColor * 0.5f + lodTints[static_cast<int>(m_ShadingLod)] * 0.5f;
+									}
+
+									WritePixel(px + (py * m_Width), ToHdrPixel(finalColor), sampleMask);
+								}
 							}
 						}
 					}
 				}
+
+				//Before another triangle's fragments can land on the pixels waiting for this one's blocks
+				if (coarseBatch.count > 0)
+				{
+					shadeCoarseBatch();
+				}
 			}
 		}
 
-		SDL_UnlockSurface(m_pBackBuffer);
-		SDL_BlitSurface(m_pBackBuffer, 0, m_pFrontBuffer, 0);
-		SDL_UpdateWindowSurface(m_pWindow);
-	}
+		//Shade what is left in the last, partial batch
+		if (batch.count > 0)
+		{
+			ShadeBatch(batch, material);
+		}
 
-	void SoftwareRenderer::VertexTransformationFunction() const
-	{
-		Matrix worldViewProjectionMatrix{};
+		//The frame's feedback is complete, stream in what it was missing
+		if (isPresented && pMesh->material.pVirtualDiffuseMap)
+		{
+			pMesh->material.pVirtualDiffuseMap->Update();
+		}
 
-		for (auto& pMesh : m_pMeshes)
+		//The samples into pixels, before anything reads the frame
+		if (isMultisampled)
+		{
+			m_Multisample.Resolve(m_ColourBuffer.data(), rect.left, rect.top, rect.right, rect.bottom);
+		}
+
+		//The skipped half of the pixels, before anything reads the frame
+		if (isCheckerboard)
+		{
+			m_Checkerboard.Resolve(m_ColourBuffer.data(), m_pDepthBufferPixels, rect.left, rect.top, rect.right, rect.bottom);
+		}
+
+		//The finished frame picks the next one's shading rates
+		if (isCoarseShaded)
+		{
+			m_ShadingRateMap.Update(m_ColourBuffer.data(), m_pDepthBufferPixels, m_pCamera->projectionMatrix);
+		}
+
+		//The finished frame is the next one's history
+		if (isPresented)
+		{
+			m_TemporalCache.EndFrame(m_ColourBuffer.data(), m_pDepthBufferPixels, m_pCamera->projectionMatrix);
+			m_PreviousWorldViewProjection = pMesh->worldMatrix * m_pCamera->viewMatrix * m_pCamera->projectionMatrix;
+		}
+	}
+
+
+	namespace
+	{
+		//Every byte of the pixels from a towards b by weight / 256, two bytes at a time in the halves of a word, whatever the format
+		uint32_t LerpPixel(uint32_t a, uint32_t b, uint32_t weight)
+		{
+			const uint32_t evenBytes{ (((a & 0x00FF00FF) * (256 - weight) + (b & 0x00FF00FF) * weight) >> 8) & 0x00FF00FF };
+			const uint32_t oddBytes{ (((a >> 8) & 0x00FF00FF) * (256 - weight) + ((b >> 8) & 0x00FF00FF) * weight) & 0xFF00FF00 };
+			return evenBytes | oddBytes;
+		}
+	}
+
+	void SoftwareRenderer::Upscale(const uint32_t* pSource, const ScreenRect& rect, SDL_Rect& upscaledRect) const
+	{
+		//The rasterizer samples pixels at their integer coordinates, back buffer pixel x lies at scale * x in the render target
+		const float scaleX{ static_cast<float>(m_Width) / m_OutputWidth };
+		const float scaleY{ static_cast<float>(m_Height) / m_OutputHeight };
+
+		//The filter reaches one render pixel past the rectangle
+		const int left{ std::clamp(static_cast<int>(std::floor((rect.left - 1) / scaleX)), 0, m_OutputWidth) };
+		const int top{ std::clamp(static_cast<int>(std::floor((rect.top - 1) / scaleY)), 0, m_OutputHeight) };
+		const int right{ std::clamp(static_cast<int>(std::ceil((rect.right + 1) / scaleX)), 0, m_OutputWidth) };
+		const int bottom{ std::clamp(static_cast<int>(std::ceil((rect.bottom + 1) / scaleY)), 0, m_OutputHeight) };
+		upscaledRect = SDL_Rect{ left, top, right - left, bottom - top };
+
+		//Every row uses the same columns and weights
+		std::vector<int> columns(right - left);
+		std::vector<uint32_t> columnWeights(right - left);
+		for (int x{ left }; x < right; ++x)
+		{
+			const float renderX{ std::clamp(scaleX * x, 0.0f, m_Width - 1.0f) };
+			columns[x - left] = std::min(static_cast<int>(renderX), m_Width - 2);
+			columnWeights[x - left] = static_cast<uint32_t>((renderX - columns[x - left]) * 256.0f + 0.5f);
+		}
+
+		uint32_t* pOutput{ static_cast<uint32_t*>(m_pBackBuffer->pixels) };
+		JobSystem::GetInstance().ParallelFor(bottom - top, 8, [&](int begin, int end)
+			{
+				for (int y{ top + begin }; y < top + end; ++y)
+				{
+					const float renderY{ std::clamp(scaleY * y, 0.0f, m_Height - 1.0f) };
+					const int row{ std::min(static_cast<int>(renderY), m_Height - 2) };
+					const uint32_t rowWeight{ static_cast<uint32_t>((renderY - row) * 256.0f + 0.5f) };
+					const uint32_t* pTop{ pSource + row * m_Width };
+					const uint32_t* pBottom{ pTop + m_Width };
+
+					for (int x{ left }; x < right; ++x)
+					{
+						const int column{ columns[x - left] };
+						const uint32_t weight{ columnWeights[x - left] };
+						pOutput[x + y * m_OutputWidth] = LerpPixel(LerpPixel(pTop[column], pTop[column + 1], weight),
+							LerpPixel(pBottom[column], pBottom[column + 1], weight), rowWeight);
+					}
+				}
+			});
+	}
+
+	void SoftwareRenderer::VertexTransformationFunction() const
+	{
+		Matrix worldViewProjectionMatrix{};
+
+		for (auto& pMesh : m_pMeshes)
 		{
 			worldViewProjectionMatrix *= pMesh->worldMatrix * m_pCamera->viewMatrix * m_pCamera->projectionMatrix;
 			pMesh->vertices_out.clear();
 
+			//Gouraud shading: the vertices get their final colour here, the rasterizer only interpolates it
+			const bool isLitPerVertex{ m_ShadingLod == ShadingLod::Gouraud && !m_ShowDepthBuffer && pMesh == m_pMeshes[0] };
+			const MaterialBinding material{ pMesh->material.Bind() };
+
 			for (auto& vertex : pMesh->vertices)
 			{
 				//Transfrom vertex from model space to screen space (aka raster space)
@@ -329,7 +1153,8 @@ namespace dae
 				Vector4 transformedVertex{ worldViewProjectionMatrix.TransformPoint(position) };
 
 				//Get the viewDirection from the vertex position
-				Vector3 viewDirection{ pMesh->worldMatrix.TransformPoint(vertex.position) - m_pCamera->origin };
+				const Vector3 worldPosition{ pMesh->worldMatrix.TransformPoint(vertex.position) };
+				Vector3 viewDirection{ worldPosition - m_pCamera->origin };
 
 				//Do the perspective divide with the w component from the Vector4 transfromedVertex
 				transformedVertex.x /= transformedVertex.w;
@@ -349,38 +1174,108 @@ namespace dae
 				outVertex.tangent = tangent;
 				outVertex.uv = vertex.uv;
 				outVertex.viewDirection = viewDirection;
+				outVertex.worldPosition = worldPosition;
+
+				if ((m_TemporalCache.IsEnabled() || m_Checkerboard.IsEnabled()) && pMesh == m_pMeshes[0])
+				{
+					outVertex.previousPosition = m_PreviousWorldViewProjection.TransformPoint(position);
+				}
+
+				//Move light and view direction into the tangent frame once per vertex instead of the normal into world space per pixel
+				if (m_TangentSpaceLighting)
+				{
+					const Vector3 biNormal{ Vector3::Cross(normal, tangent).Normalized() };
+
+					outVertex.tangentLightDirection = { Vector3::Dot(m_LightDirection, tangent), Vector3::Dot(m_LightDirection, biNormal), Vector3::Dot(m_LightDirection, normal) };
+					outVertex.tangentViewDirection = { Vector3::Dot(viewDirection, tangent), Vector3::Dot(viewDirection, biNormal), Vector3::Dot(viewDirection, normal) };
+				}
+
+				if (isLitPerVertex)
+				{
+					//ShadePixel expects the directions the rasterizer would have normalized
+					Vertex_Out shadingVertex{ outVertex };
+					shadingVertex.viewDirection.Normalize();
+					if (m_TangentSpaceLighting)
+					{
+						shadingVertex.tangentLightDirection.Normalize();
+						shadingVertex.tangentViewDirection.Normalize();
+					}
+
+					outVertex.color = ShadePixel(shadingVertex, m_GouraudUvLod, material);
+				}
 
 				pMesh->vertices_out.push_back(outVertex);
 			}
 		}
 	}
-	ColorRGB SoftwareRenderer::ShadePixel(const Vertex_Out& vertexOut) const
+	MaterialSample SoftwareRenderer::SampleMaterial(const Vector2& uv, float uvLod, const MaterialBinding& material) const
+	{
+		//Interleaved so one fetch reads them all, only there when the maps are neither compressed nor virtual
+		if (material.pPackedMap)
+		{
+			MaterialSample sample{ material.pPackedMap->SampleMaterial(uv, m_SamplerState, uvLod) };
+			if (m_ShadingLod != ShadingLod::Full)
+			{
+				sample.normal = Vector3{ 0.0f, 0.0f, 1.0f };
+			}
+			return sample;
+		}
+
+		MaterialSample sample{};
+		sample.diffuse = material.pVirtualDiffuseMap ?
+			material.pVirtualDiffuseMap->Sample(uv, m_SamplerState, uvLod) :
+			material.pDiffuseMap->Sample(uv, m_SamplerState, uvLod);
+		//Below full shading the tangent space normal stays straight up, which is the vertex normal
+		if (m_ShadingLod == ShadingLod::Full)
+		{
+			sample.normal = material.pNormalMap->SampleNormal(uv, m_SamplerState, uvLod);
+		}
+		sample.gloss = material.pGlossyMap->SampleScalar(uv, m_SamplerState, uvLod);
+		sample.specular = material.pSpecularMap->SampleScalar(uv, m_SamplerState, uvLod);
+
+		return sample;
+	}
+
+	ColorRGB SoftwareRenderer::ShadePixel(const Vertex_Out& vertexOut, float uvLod, const MaterialBinding& material) const
 	{
 		ColorRGB finalColour{};
 
-		Vector3 lightDirection{ 0.577f,-0.577f,0.577f };
-		float lightIntensity{ 7.0f };
-		ColorRGB totalLight{ ColorRGB{1.0f,1.0f,1.0f} *lightIntensity };
-		float shininess{ 25.0f };
-		ColorRGB ambient{ 0.025f,0.025f,0.025f };
+		ColorRGB totalLight{ ColorRGB{1.0f,1.0f,1.0f} * material.lightIntensity };
+		const float shininess{ material.shininess };
+		const ColorRGB ambient{ material.ambient };
+
+		//Diffuse, normal, gloss and specular maps
+		const MaterialSample maps{ SampleMaterial(vertexOut.uv, uvLod, material) };
 
-		//Diffuse map
-		ColorRGB diffuse{ m_pMeshes[0]->m_pTextureMap.at("DiffuseMap")->Sample(vertexOut.uv)};
+		ColorRGB diffuse{ maps.diffuse };
 
 		//Normal map
-		Vector3 biNormal{ Vector3::Cross(vertexOut.normal, vertexOut.tangent).Normalized() };
-		Matrix tangentAxisSpace{ Matrix{vertexOut.tangent, biNormal, vertexOut.normal, {0,0,0}} };
+		Vector3 normal{};
+		Vector3 vertexNormal{};
+		Vector3 lightDirection{};
+		Vector3 viewDirection{};
 
-		ColorRGB normalColour{ m_pMeshes[0]->m_pTextureMap.at("NormalMap")->Sample(vertexOut.uv)};
-		Vector3 normal{ 2.0f * normalColour.r - 1.0f, 2.0f * normalColour.g - 1.0f, 2.0f * normalColour.b - 1.0f };
-		normal = tangentAxisSpace.TransformVector(normal);
-		normal.Normalize();
+		if (m_TangentSpaceLighting)
+		{
+			//Light and view direction arrive in tangent space, the sampled normal is used as is
+			normal = FastMath::Normalized(maps.normal, m_MathAccuracy);
+			vertexNormal = Vector3{ 0.f, 0.f, 1.f };
+			lightDirection = vertexOut.tangentLightDirection;
+			viewDirection = vertexOut.tangentViewDirection;
+		}
+		else
+		{
+			Vector3 biNormal{ FastMath::Normalized(Vector3::Cross(vertexOut.normal, vertexOut.tangent), m_MathAccuracy) };
+			Matrix tangentAxisSpace{ Matrix{vertexOut.tangent, biNormal, vertexOut.normal, {0,0,0}} };
 
-		//Glossy map
-		ColorRGB gloss{ m_pMeshes[0]->m_pTextureMap.at("GlossyMap")->Sample(vertexOut.uv) };
+			normal = FastMath::Normalized(tangentAxisSpace.TransformVector(maps.normal), m_MathAccuracy);
+			vertexNormal = vertexOut.normal;
+			lightDirection = m_LightDirection;
+			viewDirection = vertexOut.viewDirection;
+		}
 
-		//Specular map
-		ColorRGB specular{ m_pMeshes[0]->m_pTextureMap.at("SpecularMap")->Sample(vertexOut.uv) };
+		float gloss{ maps.gloss };
+		float specular{ maps.specular };
 
 		//Calculate labert cosine
 		//Make sure that the normal and the lightDirection point in the same direction (originally opposed to each other)
@@ -392,58 +1287,830 @@ namespace dae
 		}
 		else
 		{
-			lambertCosine = Vector3::Dot(vertexOut.normal, -lightDirection);
+			lambertCosine = Vector3::Dot(vertexNormal, -lightDirection);
+		}
+
+		//Local lights do not care which way the directional light comes from
+		ColorRGB localColour{};
+		if (!m_Lights.empty())
+		{
+			localColour = ShadeLocalLights(vertexOut.worldPosition, normal, m_NormalMapEnabled ? normal : vertexNormal, viewDirection,
+				maps, shininess, static_cast<int>(vertexOut.position.x), static_cast<int>(vertexOut.position.y));
 		}
 
 		if (lambertCosine <= 0.0f)
 		{
-			finalColour = { 0.f,0.f,0.f };
+			finalColour = localColour;
 			return finalColour;
 		}
 
+		//Shadows only take away the directional light, the ambient and the local lights stay
+		const float visibility{ m_ShadowsEnabled ? m_ShadowMap.Sample(vertexOut.worldPosition) : 1.0f };
+		const float shadowedLambertCosine{ lambertCosine * visibility };
+
 		switch (m_ShadingMode)
 		{
 		case ShadingMode::Combined:
 		{
-			ColorRGB phongExponent{ gloss * shininess };
+			float phongExponent{ gloss * shininess };
 
 			Vector3 reflect{ Vector3::Reflect(-lightDirection, normal) };
-			float cosAlpha{ std::max(0.0f, Vector3::Dot(reflect, vertexOut.viewDirection)) };
-			ColorRGB phong{ specular * std::powf(cosAlpha, phongExponent.r) };
+			float cosAlpha{ std::max(0.0f, Vector3::Dot(reflect, viewDirection)) };
+			ColorRGB phong{ ColorRGB{ specular, specular, specular } * FastMath::Pow(cosAlpha, phongExponent, m_MathAccuracy) };
 
 			ColorRGB rho{ diffuse };
 			ColorRGB diffuseColour{ rho / PI };
 
-			finalColour = lambertCosine * totalLight * diffuseColour + (phong + ambient);
+			finalColour = shadowedLambertCosine * totalLight * diffuseColour + (phong * visibility + ambient);
 		}
 		break;
 		case ShadingMode::Diffuse:
 		{
 			ColorRGB rho{ diffuse };
 			ColorRGB diffuseColour{ rho / PI };
-			finalColour = totalLight * diffuseColour * lambertCosine;
+			finalColour = totalLight * diffuseColour * shadowedLambertCosine;
 		}
 		break;
 		case ShadingMode::Specular:
 		{
-			ColorRGB phongExponent{ gloss * shininess };
+			float phongExponent{ gloss * shininess };
 
 			Vector3 reflect{ Vector3::Reflect(-lightDirection, normal) };
-			float cosAlpha{ std::max(0.0f, Vector3::Dot(reflect, vertexOut.viewDirection)) };
-			ColorRGB phong{ specular * std::powf(cosAlpha, phongExponent.r) };
+			float cosAlpha{ std::max(0.0f, Vector3::Dot(reflect, viewDirection)) };
+			ColorRGB phong{ ColorRGB{ specular, specular, specular } * FastMath::Pow(cosAlpha, phongExponent, m_MathAccuracy) };
 
-			finalColour = totalLight * phong * lambertCosine;
+			finalColour = totalLight * phong * shadowedLambertCosine;
 		}
 		break;
 		case ShadingMode::ObservedArea:
 		{
-			finalColour = { lambertCosine,lambertCosine,lambertCosine };
+			finalColour = { shadowedLambertCosine,shadowedLambertCosine,shadowedLambertCosine };
 		}
 		break;
 		default:
 			break;
 		}
 
+		finalColour += localColour;
 		return finalColour;
 	}
-}
\ No newline at end of file
+
+	void SoftwareRenderer::CullLights() const
+	{
+		//View space bounding spheres, a spot light is bounded by the sphere of its range
+		std::vector<Vector4> lightSpheres(m_Lights.size());
+		for (size_t i{}; i < m_Lights.size(); ++i)
+		{
+			lightSpheres[i] = Vector4{ m_pCamera->viewMatrix.TransformPoint(m_Lights[i].position), m_Lights[i].range };
+		}
+
+		//ndc = view * scale / viewZ, and the stored depth d = A + B / viewZ
+		const Matrix& projection{ m_pCamera->projectionMatrix };
+		const float scaleX{ projection[0].x };
+		const float scaleY{ projection[1].y };
+		const float depthA{ projection[2].z };
+		const float depthB{ projection[3].z };
+		const int lightCount{ std::min(static_cast<int>(m_Lights.size()), static_cast<int>(UINT16_MAX)) };
+
+		JobSystem::GetInstance().ParallelFor(m_TileCountX * m_TileCountY, m_TileCountX, [&](int begin, int end)
+			{
+				for (int tile{ begin }; tile < end; ++tile)
+				{
+					const int xMin{ (tile % m_TileCountX) * LightTileSize };
+					const int yMin{ (tile / m_TileCountX) * LightTileSize };
+					const int xMax{ std::min(xMin + LightTileSize, m_Width) };
+					const int yMax{ std::min(yMin + LightTileSize, m_Height) };
+
+					float minDepth{ FLT_MAX };
+					float maxDepth{ -FLT_MAX };
+					for (int py{ yMin }; py < yMax; ++py)
+					{
+						for (int px{ xMin }; px < xMax; ++px)
+						{
+							const float depth{ m_pDepthBufferPixels[px + (py * m_Width)] };
+							if (depth != FLT_MAX)
+							{
+								minDepth = std::min(minDepth, depth);
+								maxDepth = std::max(maxDepth, depth);
+							}
+						}
+					}
+
+					int& count{ m_TileLightCounts[tile] };
+					count = 0;
+
+					//Nothing drawn in this tile, nothing to light
+					if (minDepth == FLT_MAX)
+					{
+						continue;
+					}
+
+					const float nearZ{ depthB / (minDepth - depthA) };
+					const float farZ{ depthB / (maxDepth - depthA) };
+
+					//Side planes through the camera and the tile edges, normals point into the tile
+					const float leftNdc{ 2.0f * xMin / m_Width - 1.0f };
+					const float rightNdc{ 2.0f * xMax / m_Width - 1.0f };
+					const float topNdc{ 1.0f - 2.0f * yMin / m_Height };
+					const float bottomNdc{ 1.0f - 2.0f * yMax / m_Height };
+					const Vector3 planes[4]
+					{
+						Vector3{ scaleX, 0.0f, -leftNdc }.Normalized(),
+						Vector3{ -scaleX, 0.0f, rightNdc }.Normalized(),
+						Vector3{ 0.0f, scaleY, -bottomNdc }.Normalized(),
+						Vector3{ 0.0f, -scaleY, topNdc }.Normalized()
+					};
+
+					uint16_t* pTileLights{ m_TileLightIndices.data() + tile * MaxLightsPerTile };
+					for (int light{}; light < lightCount && count < MaxLightsPerTile; ++light)
+					{
+						const Vector4& sphere{ lightSpheres[light] };
+						if (sphere.z + sphere.w < nearZ || sphere.z - sphere.w > farZ)
+						{
+							continue;
+						}
+
+						const Vector3 center{ sphere.x, sphere.y, sphere.z };
+						if (std::all_of(std::begin(planes), std::end(planes), [&](const Vector3& plane) { return Vector3::Dot(plane, center) >= -sphere.w; }))
+						{
+							pTileLights[count++] = static_cast<uint16_t>(light);
+						}
+					}
+				}
+			});
+	}
+
+	ColorRGB SoftwareRenderer::ShadeLocalLights(const Vector3& position, const Vector3& normal, const Vector3& lambertNormal, const Vector3& viewDirection,
+		const MaterialSample& maps, float shininess, int pixelX, int pixelY) const
+	{
+		const int tile{ (pixelY / LightTileSize) * m_TileCountX + pixelX / LightTileSize };
+		const uint16_t* pTileLights{ m_TileLightIndices.data() + tile * MaxLightsPerTile };
+		const float phongExponent{ maps.gloss * shininess };
+
+		ColorRGB colour{};
+		for (int i{}; i < m_TileLightCounts[tile]; ++i)
+		{
+			const Light& light{ m_Lights[pTileLights[i]] };
+
+			const Vector3 toLight{ light.position - position };
+			const float distanceSquared{ toLight.SqrMagnitude() };
+			if (distanceSquared >= light.range * light.range)
+			{
+				continue;
+			}
+
+			const float distance{ std::sqrt(distanceSquared) };
+			const Vector3 lightDirection{ toLight / distance };
+
+			const float lambertCosine{ Vector3::Dot(lambertNormal, lightDirection) };
+			if (lambertCosine <= 0.0f)
+			{
+				continue;
+			}
+
+			//Inverse square falloff, windowed so it reaches zero at the range
+			const float window{ Saturate(1.0f - Square(Square(distance / light.range))) };
+			float attenuation{ light.intensity * window * window / (distanceSquared + 1.0f) };
+
+			if (light.type == LightType::Spot)
+			{
+				const float cone{ Saturate((Vector3::Dot(-lightDirection, light.direction) - light.outerConeCos) / (light.innerConeCos - light.outerConeCos)) };
+				attenuation *= cone * cone * (3.0f - 2.0f * cone);
+			}
+
+			const ColorRGB radiance{ light.color * (attenuation * lambertCosine) };
+
+			//Same phong as the directional light, scaled by what this light delivers
+			const auto phong{ [&]()
+				{
+					const float cosAlpha{ std::max(0.0f, Vector3::Dot(Vector3::Reflect(lightDirection, normal), viewDirection)) };
+					return maps.specular * FastMath::Pow(cosAlpha, phongExponent, m_MathAccuracy);
+				} };
+
+			switch (m_ShadingMode)
+			{
+			case ShadingMode::Combined:
+				colour += radiance * (maps.diffuse / PI) + radiance * phong();
+				break;
+			case ShadingMode::Diffuse:
+				colour += radiance * (maps.diffuse / PI);
+				break;
+			case ShadingMode::Specular:
+				colour += radiance * phong();
+				break;
+			case ShadingMode::ObservedArea:
+				colour += radiance;
+				break;
+			default:
+				break;
+			}
+		}
+
+		return colour;
+	}
+
+	namespace
+	{
+		//Shading normal, the normal the lambert term uses and the light and view direction of 8 fragments
+		struct ShadingVectors
+		{
+			__m256 normalX{}, normalY{}, normalZ{};
+			__m256 lambertNormalX{}, lambertNormalY{}, lambertNormalZ{};
+			__m256 lightX{}, lightY{}, lightZ{};
+			__m256 viewX{}, viewY{}, viewZ{};
+		};
+
+		//The vector part of ShadePixel for the 8 lanes starting at first, pMapNormal* point at those lanes' sampled normals
+		template<MathAccuracy Accuracy>
+		ShadingVectors ComputeShadingVectors(const FragmentBatch& batch, int first, const float* pMapNormalX, const float* pMapNormalY, const float* pMapNormalZ,
+			bool isTangentSpace, bool isNormalMapEnabled, const Vector3& lightDirection)
+		{
+			ShadingVectors vectors{};
+			vectors.normalX = _mm256_load_ps(pMapNormalX);
+			vectors.normalY = _mm256_load_ps(pMapNormalY);
+			vectors.normalZ = _mm256_load_ps(pMapNormalZ);
+
+			__m256 vertexNormalX{}, vertexNormalY{}, vertexNormalZ{};
+
+			if (isTangentSpace)
+			{
+				FastMath::Normalize<Accuracy>(vectors.normalX, vectors.normalY, vectors.normalZ);
+				vertexNormalZ = _mm256_set1_ps(1.0f);
+				vectors.lightX = _mm256_load_ps(batch.tangentLightX + first);
+				vectors.lightY = _mm256_load_ps(batch.tangentLightY + first);
+				vectors.lightZ = _mm256_load_ps(batch.tangentLightZ + first);
+				vectors.viewX = _mm256_load_ps(batch.tangentViewX + first);
+				vectors.viewY = _mm256_load_ps(batch.tangentViewY + first);
+				vectors.viewZ = _mm256_load_ps(batch.tangentViewZ + first);
+			}
+			else
+			{
+				vertexNormalX = _mm256_load_ps(batch.normalX + first);
+				vertexNormalY = _mm256_load_ps(batch.normalY + first);
+				vertexNormalZ = _mm256_load_ps(batch.normalZ + first);
+				const __m256 tangentX{ _mm256_load_ps(batch.tangentX + first) };
+				const __m256 tangentY{ _mm256_load_ps(batch.tangentY + first) };
+				const __m256 tangentZ{ _mm256_load_ps(batch.tangentZ + first) };
+
+				__m256 biNormalX{ _mm256_sub_ps(_mm256_mul_ps(vertexNormalY, tangentZ), _mm256_mul_ps(vertexNormalZ, tangentY)) };
+				__m256 biNormalY{ _mm256_sub_ps(_mm256_mul_ps(vertexNormalZ, tangentX), _mm256_mul_ps(vertexNormalX, tangentZ)) };
+				__m256 biNormalZ{ _mm256_sub_ps(_mm256_mul_ps(vertexNormalX, tangentY), _mm256_mul_ps(vertexNormalY, tangentX)) };
+				FastMath::Normalize<Accuracy>(biNormalX, biNormalY, biNormalZ);
+
+				//Tangent to world: tangent * x + biNormal * y + normal * z
+				const auto transform{ [&](__m256 tangent, __m256 biNormal, __m256 normal)
+					{
+						return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(tangent, vectors.normalX), _mm256_mul_ps(biNormal, vectors.normalY)), _mm256_mul_ps(normal, vectors.normalZ));
+					} };
+				const __m256 worldNormalX{ transform(tangentX, biNormalX, vertexNormalX) };
+				const __m256 worldNormalY{ transform(tangentY, biNormalY, vertexNormalY) };
+				const __m256 worldNormalZ{ transform(tangentZ, biNormalZ, vertexNormalZ) };
+				vectors.normalX = worldNormalX;
+				vectors.normalY = worldNormalY;
+				vectors.normalZ = worldNormalZ;
+				FastMath::Normalize<Accuracy>(vectors.normalX, vectors.normalY, vectors.normalZ);
+
+				vectors.lightX = _mm256_set1_ps(lightDirection.x);
+				vectors.lightY = _mm256_set1_ps(lightDirection.y);
+				vectors.lightZ = _mm256_set1_ps(lightDirection.z);
+				vectors.viewX = _mm256_load_ps(batch.viewX + first);
+				vectors.viewY = _mm256_load_ps(batch.viewY + first);
+				vectors.viewZ = _mm256_load_ps(batch.viewZ + first);
+			}
+
+			vectors.lambertNormalX = isNormalMapEnabled ? vectors.normalX : vertexNormalX;
+			vectors.lambertNormalY = isNormalMapEnabled ? vectors.normalY : vertexNormalY;
+			vectors.lambertNormalZ = isNormalMapEnabled ? vectors.normalZ : vertexNormalZ;
+
+			return vectors;
+		}
+
+		//16 int16 lanes from two registers of 8 floats, value * scale rounded and saturated
+		__m256i ToFixedPoint(__m256 low, __m256 high, float scale)
+		{
+			const __m256 scaleVector{ _mm256_set1_ps(scale) };
+			const __m256i packed{ _mm256_packs_epi32(_mm256_cvtps_epi32(_mm256_mul_ps(low, scaleVector)), _mm256_cvtps_epi32(_mm256_mul_ps(high, scaleVector))) };
+
+			//packs works per 128 bit half, put the lanes back in order
+			return _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0));
+		}
+
+		//Lanes 0 - 7 or 8 - 15 of 16 int16 lanes, widened to int32
+		__m256i WidenLow(__m256i value)
+		{
+			return _mm256_cvtepi16_epi32(_mm256_castsi256_si128(value));
+		}
+
+		__m256i WidenHigh(__m256i value)
+		{
+			return _mm256_cvtepi16_epi32(_mm256_extracti128_si256(value, 1));
+		}
+
+		//Dot product of two Q15 vectors, unit vectors can not overflow
+		__m256i DotFixedPoint(__m256i ax, __m256i ay, __m256i az, __m256i bx, __m256i by, __m256i bz)
+		{
+			return _mm256_adds_epi16(_mm256_adds_epi16(_mm256_mulhrs_epi16(ax, bx), _mm256_mulhrs_epi16(ay, by)), _mm256_mulhrs_epi16(az, bz));
+		}
+	}
+
+	void SoftwareRenderer::ShadeBatch(FragmentBatch& batch, const MaterialBinding& material) const
+	{
+		batch.FillUnusedLanes();
+
+		//Observed area has no fixed point version, it is a debug view, neither do local lights
+		if (m_FixedPointShading && m_ShadingMode != ShadingMode::ObservedArea && m_Lights.empty())
+		{
+			ShadeBatchFixedPoint(batch, material);
+			m_FixedPointFragmentCount += batch.count;
+			batch.count = 0;
+			return;
+		}
+
+		//Pick the accuracy once per batch instead of once per call inside the lanes, only halves that hold fragments are shaded
+		for (int first{}; first < batch.count; first += FragmentBatch::FloatLanes)
+		{
+			switch (m_MathAccuracy)
+			{
+			case MathAccuracy::Exact:
+				ShadeBatch<MathAccuracy::Exact>(batch, first, material);
+				break;
+			case MathAccuracy::Fast:
+				ShadeBatch<MathAccuracy::Fast>(batch, first, material);
+				break;
+			case MathAccuracy::Fastest:
+				ShadeBatch<MathAccuracy::Fastest>(batch, first, material);
+				break;
+			default:
+				break;
+			}
+		}
+
+		batch.count = 0;
+	}
+
+	void SoftwareRenderer::SampleBatchMaterial(const FragmentBatch& batch, int first, int count, const MaterialBinding& material, const MaterialSampleBatch& samples) const
+	{
+		//The separate maps are only fetched when the mode reads them
+		const bool needsDiffuse{ m_ShadingMode == ShadingMode::Combined || m_ShadingMode == ShadingMode::Diffuse };
+		const bool needsPhong{ m_ShadingMode == ShadingMode::Combined || m_ShadingMode == ShadingMode::Specular };
+
+		const float* pU{ batch.u + first };
+		const float* pV{ batch.v + first };
+		const float* pUvLod{ batch.uvLod + first };
+
+		//Below full shading the tangent space normal stays straight up, which is the vertex normal
+		const bool needsNormalMap{ m_ShadingLod == ShadingLod::Full };
+		const auto straightenNormals{ [&]()
+			{
+				std::fill_n(samples.pNormalX, count, 0.0f);
+				std::fill_n(samples.pNormalY, count, 0.0f);
+				std::fill_n(samples.pNormalZ, count, 1.0f);
+			} };
+
+		if (material.pPackedMap)
+		{
+			//The normal comes with the same fetch, it can only be thrown away
+			material.pPackedMap->SampleMaterialBatch(pU, pV, pUvLod, count, m_SamplerState, samples);
+			if (!needsNormalMap)
+			{
+				straightenNormals();
+			}
+			return;
+		}
+
+		if (needsDiffuse && material.pVirtualDiffuseMap)
+		{
+			//Page lookups and feedback are per texel, the virtual map has no batched fetch
+			for (int lane{}; lane < count; ++lane)
+			{
+				const ColorRGB diffuse{ material.pVirtualDiffuseMap->Sample(Vector2{ pU[lane], pV[lane] }, m_SamplerState, pUvLod[lane]) };
+				samples.pDiffuseR[lane] = diffuse.r;
+				samples.pDiffuseG[lane] = diffuse.g;
+				samples.pDiffuseB[lane] = diffuse.b;
+			}
+		}
+		else if (needsDiffuse)
+		{
+			material.pDiffuseMap->SampleBatch(pU, pV, pUvLod, count, m_SamplerState, samples.pDiffuseR, samples.pDiffuseG, samples.pDiffuseB);
+		}
+
+		if (needsNormalMap)
+		{
+			material.pNormalMap->SampleBatch(pU, pV, pUvLod, count, m_SamplerState, samples.pNormalX, samples.pNormalY, samples.pNormalZ);
+		}
+		else
+		{
+			straightenNormals();
+		}
+
+		if (needsPhong)
+		{
+			//Single channel maps broadcast, the same array takes all three channels
+			material.pGlossyMap->SampleBatch(pU, pV, pUvLod, count, m_SamplerState, samples.pGloss, samples.pGloss, samples.pGloss);
+			material.pSpecularMap->SampleBatch(pU, pV, pUvLod, count, m_SamplerState, samples.pSpecular, samples.pSpecular, samples.pSpecular);
+		}
+	}
+
+	template<MathAccuracy Accuracy>
+	void SoftwareRenderer::ShadeBatch(const FragmentBatch& batch, int first, const MaterialBinding& material) const
+	{
+		constexpr int lanes{ FragmentBatch::FloatLanes };
+
+		alignas(32) float diffuseR[lanes]{}, diffuseG[lanes]{}, diffuseB[lanes]{};
+		alignas(32) float mapNormalX[lanes]{}, mapNormalY[lanes]{}, mapNormalZ[lanes]{};
+		alignas(32) float gloss[lanes]{}, specular[lanes]{};
+
+		SampleBatchMaterial(batch, first, lanes, material,
+			MaterialSampleBatch{ diffuseR, diffuseG, diffuseB, mapNormalX, mapNormalY, mapNormalZ, gloss, specular });
+
+		//Same steps as ShadePixel, one lane per fragment
+		const ShadingVectors vectors{ ComputeShadingVectors<Accuracy>(batch, first, mapNormalX, mapNormalY, mapNormalZ,
+			m_TangentSpaceLighting, m_NormalMapEnabled, m_LightDirection) };
+
+		const auto dot{ [](__m256 ax, __m256 ay, __m256 az, __m256 bx, __m256 by, __m256 bz)
+			{
+				return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax, bx), _mm256_mul_ps(ay, by)), _mm256_mul_ps(az, bz));
+			} };
+
+		//Lambert cosine against the light coming in, lanes facing away stay black
+		const __m256 zero{ _mm256_setzero_ps() };
+		const __m256 lambertCosine{ _mm256_sub_ps(zero, dot(vectors.lambertNormalX, vectors.lambertNormalY, vectors.lambertNormalZ, vectors.lightX, vectors.lightY, vectors.lightZ)) };
+		const __m256 litMask{ _mm256_cmp_ps(lambertCosine, zero, _CMP_GT_OQ) };
+
+		//Shadows only take away the directional light, the ambient and the local lights stay
+		__m256 visibility{ _mm256_set1_ps(1.0f) };
+		if (m_ShadowsEnabled)
+		{
+			alignas(32) float laneVisibility[lanes]{};
+			m_ShadowMap.SampleBatch(batch.worldX + first, batch.worldY + first, batch.worldZ + first, laneVisibility);
+			visibility = _mm256_load_ps(laneVisibility);
+		}
+		const __m256 shadowedLambertCosine{ _mm256_mul_ps(lambertCosine, visibility) };
+
+		//Phong: reflect(-light, normal) = -light + 2 * dot(light, normal) * normal
+		__m256 phong{};
+		if (m_ShadingMode == ShadingMode::Combined || m_ShadingMode == ShadingMode::Specular)
+		{
+			const __m256 twoLightDotNormal{ _mm256_mul_ps(_mm256_set1_ps(2.0f), dot(vectors.lightX, vectors.lightY, vectors.lightZ, vectors.normalX, vectors.normalY, vectors.normalZ)) };
+			const __m256 reflectX{ _mm256_sub_ps(_mm256_mul_ps(twoLightDotNormal, vectors.normalX), vectors.lightX) };
+			const __m256 reflectY{ _mm256_sub_ps(_mm256_mul_ps(twoLightDotNormal, vectors.normalY), vectors.lightY) };
+			const __m256 reflectZ{ _mm256_sub_ps(_mm256_mul_ps(twoLightDotNormal, vectors.normalZ), vectors.lightZ) };
+
+			const __m256 cosAlpha{ _mm256_max_ps(zero, dot(reflectX, reflectY, reflectZ, vectors.viewX, vectors.viewY, vectors.viewZ)) };
+			const __m256 phongExponent{ _mm256_mul_ps(_mm256_load_ps(gloss), _mm256_set1_ps(material.shininess)) };
+			phong = _mm256_mul_ps(_mm256_load_ps(specular), FastMath::Pow<Accuracy>(cosAlpha, phongExponent));
+		}
+
+		const __m256 lightIntensity{ _mm256_set1_ps(material.lightIntensity) };
+		const __m256 diffuseScale{ _mm256_mul_ps(lightIntensity, _mm256_set1_ps(1.0f / PI)) };
+		__m256 red{}, green{}, blue{};
+
+		switch (m_ShadingMode)
+		{
+		case ShadingMode::Combined:
+		{
+			const __m256 diffuseFactor{ _mm256_mul_ps(shadowedLambertCosine, diffuseScale) };
+			const __m256 shadowedPhong{ _mm256_mul_ps(phong, visibility) };
+			red = _mm256_add_ps(_mm256_mul_ps(diffuseFactor, _mm256_load_ps(diffuseR)), _mm256_add_ps(shadowedPhong, _mm256_set1_ps(material.ambient.r)));
+			green = _mm256_add_ps(_mm256_mul_ps(diffuseFactor, _mm256_load_ps(diffuseG)), _mm256_add_ps(shadowedPhong, _mm256_set1_ps(material.ambient.g)));
+			blue = _mm256_add_ps(_mm256_mul_ps(diffuseFactor, _mm256_load_ps(diffuseB)), _mm256_add_ps(shadowedPhong, _mm256_set1_ps(material.ambient.b)));
+		}
+		break;
+		case ShadingMode::Diffuse:
+		{
+			const __m256 diffuseFactor{ _mm256_mul_ps(shadowedLambertCosine, diffuseScale) };
+			red = _mm256_mul_ps(diffuseFactor, _mm256_load_ps(diffuseR));
+			green = _mm256_mul_ps(diffuseFactor, _mm256_load_ps(diffuseG));
+			blue = _mm256_mul_ps(diffuseFactor, _mm256_load_ps(diffuseB));
+		}
+		break;
+		case ShadingMode::Specular:
+		{
+			red = _mm256_mul_ps(_mm256_mul_ps(lightIntensity, phong), shadowedLambertCosine);
+			green = red;
+			blue = red;
+		}
+		break;
+		case ShadingMode::ObservedArea:
+		{
+			red = shadowedLambertCosine;
+			green = red;
+			blue = red;
+		}
+		break;
+		default:
+			break;
+		}
+
+		red = _mm256_and_ps(red, litMask);
+		green = _mm256_and_ps(green, litMask);
+		blue = _mm256_and_ps(blue, litMask);
+
+		if (!m_Lights.empty())
+		{
+			//Every lane has its own tile and light list, so the local lights are added one lane at a time
+			alignas(32) float laneRed[lanes]{}, laneGreen[lanes]{}, laneBlue[lanes]{};
+			alignas(32) float normalX[lanes]{}, normalY[lanes]{}, normalZ[lanes]{};
+			alignas(32) float lambertNormalX[lanes]{}, lambertNormalY[lanes]{}, lambertNormalZ[lanes]{};
+			_mm256_store_ps(laneRed, red);
+			_mm256_store_ps(laneGreen, green);
+			_mm256_store_ps(laneBlue, blue);
+			_mm256_store_ps(normalX, vectors.normalX);
+			_mm256_store_ps(normalY, vectors.normalY);
+			_mm256_store_ps(normalZ, vectors.normalZ);
+			_mm256_store_ps(lambertNormalX, vectors.lambertNormalX);
+			_mm256_store_ps(lambertNormalY, vectors.lambertNormalY);
+			_mm256_store_ps(lambertNormalZ, vectors.lambertNormalZ);
+
+			for (int lane{}; lane < std::min(batch.count - first, lanes); ++lane)
+			{
+				const int index{ first + lane };
+				const int pixelIndex{ batch.pixelIndices[index] };
+
+				MaterialSample maps{};
+				maps.diffuse = ColorRGB{ diffuseR[lane], diffuseG[lane], diffuseB[lane] };
+				maps.gloss = gloss[lane];
+				maps.specular = specular[lane];
+
+				const ColorRGB localColour{ ShadeLocalLights(
+					Vector3{ batch.worldX[index], batch.worldY[index], batch.worldZ[index] },
+					Vector3{ normalX[lane], normalY[lane], normalZ[lane] },
+					Vector3{ lambertNormalX[lane], lambertNormalY[lane], lambertNormalZ[lane] },
+					Vector3{ batch.viewX[index], batch.viewY[index], batch.viewZ[index] },
+					maps, material.shininess, pixelIndex % m_Width, pixelIndex / m_Width) };
+
+				laneRed[lane] += localColour.r;
+				laneGreen[lane] += localColour.g;
+				laneBlue[lane] += localColour.b;
+			}
+
+			red = _mm256_load_ps(laneRed);
+			green = _mm256_load_ps(laneGreen);
+			blue = _mm256_load_ps(laneBlue);
+		}
+
+		WriteBatchPixels(batch, first, red, green, blue);
+	}
+
+	void SoftwareRenderer::ShadeBatchFixedPoint(const FragmentBatch& batch, const MaterialBinding& material) const
+	{
+		constexpr int lanes{ FragmentBatch::Size };
+		constexpr int floatLanes{ FragmentBatch::FloatLanes };
+		constexpr float q15{ 32767.0f };
+		constexpr float q12{ 4096.0f };
+
+		alignas(32) float diffuseR[lanes]{}, diffuseG[lanes]{}, diffuseB[lanes]{};
+		alignas(32) float mapNormalX[lanes]{}, mapNormalY[lanes]{}, mapNormalZ[lanes]{};
+		alignas(32) float gloss[lanes]{}, specular[lanes]{};
+
+		SampleBatchMaterial(batch, 0, lanes, material,
+			MaterialSampleBatch{ diffuseR, diffuseG, diffuseB, mapNormalX, mapNormalY, mapNormalZ, gloss, specular });
+
+		//Directions are still interpolated and normalized in float, everything after that is Q15 (1.0 = 32767) in 16 lanes
+		const ShadingVectors low{ ComputeShadingVectors<MathAccuracy::Fastest>(batch, 0, mapNormalX, mapNormalY, mapNormalZ,
+			m_TangentSpaceLighting, m_NormalMapEnabled, m_LightDirection) };
+		const ShadingVectors high{ ComputeShadingVectors<MathAccuracy::Fastest>(batch, floatLanes, mapNormalX + floatLanes, mapNormalY + floatLanes, mapNormalZ + floatLanes,
+			m_TangentSpaceLighting, m_NormalMapEnabled, m_LightDirection) };
+
+		const __m256i normalX{ ToFixedPoint(low.normalX, high.normalX, q15) };
+		const __m256i normalY{ ToFixedPoint(low.normalY, high.normalY, q15) };
+		const __m256i normalZ{ ToFixedPoint(low.normalZ, high.normalZ, q15) };
+		const __m256i lightX{ ToFixedPoint(low.lightX, high.lightX, q15) };
+		const __m256i lightY{ ToFixedPoint(low.lightY, high.lightY, q15) };
+		const __m256i lightZ{ ToFixedPoint(low.lightZ, high.lightZ, q15) };
+
+		const __m256i zero{ _mm256_setzero_si256() };
+		const __m256i lambertCosine{ _mm256_subs_epi16(zero, DotFixedPoint(
+			ToFixedPoint(low.lambertNormalX, high.lambertNormalX, q15),
+			ToFixedPoint(low.lambertNormalY, high.lambertNormalY, q15),
+			ToFixedPoint(low.lambertNormalZ, high.lambertNormalZ, q15), lightX, lightY, lightZ)) };
+		const __m256i litMask{ _mm256_cmpgt_epi16(lambertCosine, zero) };
+
+		//Shadow lookups stay in float, only the visibility is converted
+		__m256i visibility{ _mm256_set1_epi16(static_cast<short>(q15)) };
+		if (m_ShadowsEnabled)
+		{
+			alignas(32) float laneVisibility[lanes]{};
+			m_ShadowMap.SampleBatch(batch.worldX, batch.worldY, batch.worldZ, laneVisibility);
+			m_ShadowMap.SampleBatch(batch.worldX + floatLanes, batch.worldY + floatLanes, batch.worldZ + floatLanes, laneVisibility + floatLanes);
+			visibility = ToFixedPoint(_mm256_load_ps(laneVisibility), _mm256_load_ps(laneVisibility + floatLanes), q15);
+		}
+		const __m256i shadowedLambertCosine{ _mm256_mulhrs_epi16(lambertCosine, visibility) };
+
+		__m256i phong{};
+		if (m_ShadingMode != ShadingMode::Diffuse)
+		{
+			const __m256i viewX{ ToFixedPoint(low.viewX, high.viewX, q15) };
+			const __m256i viewY{ ToFixedPoint(low.viewY, high.viewY, q15) };
+			const __m256i viewZ{ ToFixedPoint(low.viewZ, high.viewZ, q15) };
+
+			//dot(reflect(-light, normal), view) = 2 * dot(light, normal) * dot(normal, view) - dot(light, view)
+			//Halved so the intermediate stays in range, anything below zero is clamped anyway
+			const __m256i lightDotNormal{ DotFixedPoint(lightX, lightY, lightZ, normalX, normalY, normalZ) };
+			const __m256i normalDotView{ DotFixedPoint(normalX, normalY, normalZ, viewX, viewY, viewZ) };
+			const __m256i lightDotView{ DotFixedPoint(lightX, lightY, lightZ, viewX, viewY, viewZ) };
+			const __m256i halfCosAlpha{ _mm256_subs_epi16(_mm256_mulhrs_epi16(lightDotNormal, normalDotView), _mm256_srai_epi16(lightDotView, 1)) };
+			const __m256i cosAlpha{ _mm256_max_epi16(_mm256_adds_epi16(halfCosAlpha, halfCosAlpha), zero) };
+
+			//pow(cosAlpha, gloss * shininess) from the table: the top 8 bits of cosAlpha pick the entry, the low 7 lerp to the next
+			const __m256i glossBucket{ ToFixedPoint(_mm256_load_ps(gloss), _mm256_load_ps(gloss + floatLanes), static_cast<float>(SpecularTableGlossBuckets - 1)) };
+			const __m256i tableIndex{ _mm256_add_epi16(_mm256_slli_epi16(glossBucket, 8), _mm256_srli_epi16(cosAlpha, 7)) };
+			const __m256i fraction{ _mm256_and_si256(cosAlpha, _mm256_set1_epi16(127)) };
+
+			const auto lookup{ [&](__m256i index, __m256i lerp)
+				{
+					const __m256i entries{ _mm256_i32gather_epi32(reinterpret_cast<const int*>(m_SpecularTable.data()), index, 4) };
+					const __m256i start{ _mm256_and_si256(entries, _mm256_set1_epi32(0xFFFF)) };
+					const __m256i end{ _mm256_srli_epi32(entries, 16) };
+					return _mm256_add_epi32(start, _mm256_srai_epi32(_mm256_mullo_epi32(_mm256_sub_epi32(end, start), lerp), 7));
+				} };
+			const __m256i power{ _mm256_permute4x64_epi64(_mm256_packs_epi32(
+				lookup(WidenLow(tableIndex), WidenLow(fraction)),
+				lookup(WidenHigh(tableIndex), WidenHigh(fraction))), _MM_SHUFFLE(3, 1, 2, 0)) };
+
+			phong = _mm256_mulhrs_epi16(ToFixedPoint(_mm256_load_ps(specular), _mm256_load_ps(specular + floatLanes), q15), power);
+		}
+
+		//Colours are Q12 (1.0 = 4096) so the lit diffuse term has room above one, the colour buffer keeps it
+		const __m256i diffuseScale{ _mm256_set1_epi16(static_cast<short>(std::min(material.lightIntensity / PI * q12, q15))) };
+		const __m256i lightIntensity{ _mm256_set1_epi16(static_cast<short>(std::min(material.lightIntensity * q12, q15))) };
+		__m256i red{}, green{}, blue{};
+
+		if (m_ShadingMode == ShadingMode::Specular)
+		{
+			red = _mm256_mulhrs_epi16(_mm256_mulhrs_epi16(phong, shadowedLambertCosine), lightIntensity);
+			green = red;
+			blue = red;
+		}
+		else
+		{
+			//Q15 * Q12 = Q12
+			const __m256i diffuseFactor{ _mm256_mulhrs_epi16(shadowedLambertCosine, diffuseScale) };
+			red = _mm256_mulhrs_epi16(diffuseFactor, ToFixedPoint(_mm256_load_ps(diffuseR), _mm256_load_ps(diffuseR + floatLanes), q15));
+			green = _mm256_mulhrs_epi16(diffuseFactor, ToFixedPoint(_mm256_load_ps(diffuseG), _mm256_load_ps(diffuseG + floatLanes), q15));
+			blue = _mm256_mulhrs_epi16(diffuseFactor, ToFixedPoint(_mm256_load_ps(diffuseB), _mm256_load_ps(diffuseB + floatLanes), q15));
+
+			if (m_ShadingMode == ShadingMode::Combined)
+			{
+				const __m256i phongQ12{ _mm256_srai_epi16(_mm256_mulhrs_epi16(phong, visibility), 3) };
+				red = _mm256_adds_epi16(red, _mm256_adds_epi16(phongQ12, _mm256_set1_epi16(static_cast<short>(material.ambient.r * q12))));
+				green = _mm256_adds_epi16(green, _mm256_adds_epi16(phongQ12, _mm256_set1_epi16(static_cast<short>(material.ambient.g * q12))));
+				blue = _mm256_adds_epi16(blue, _mm256_adds_epi16(phongQ12, _mm256_set1_epi16(static_cast<short>(material.ambient.b * q12))));
+			}
+		}
+
+		red = _mm256_and_si256(red, litMask);
+		green = _mm256_and_si256(green, litMask);
+		blue = _mm256_and_si256(blue, litMask);
+
+		//Q12 to float
+		const __m256 fromQ12{ _mm256_set1_ps(1.0f / q12) };
+		const auto toFloat{ [&](__m256i channel) { return _mm256_mul_ps(_mm256_cvtepi32_ps(channel), fromQ12); } };
+
+		WriteBatchPixels(batch, 0, toFloat(WidenLow(red)), toFloat(WidenLow(green)), toFloat(WidenLow(blue)));
+		if (batch.count > floatLanes)
+		{
+			WriteBatchPixels(batch, floatLanes, toFloat(WidenHigh(red)), toFloat(WidenHigh(green)), toFloat(WidenHigh(blue)));
+		}
+	}
+
+	void SoftwareRenderer::WriteBatchPixels(const FragmentBatch& batch, int first, __m256 red, __m256 green, __m256 blue) const
+	{
+		constexpr int lanes{ FragmentBatch::FloatLanes };
+
+		//To half floats, interleaved into red, green, blue and the unused zero per pixel
+		const __m128i redHalves{ _mm256_cvtps_ph(red, _MM_FROUND_TO_NEAREST_INT) };
+		const __m128i greenHalves{ _mm256_cvtps_ph(green, _MM_FROUND_TO_NEAREST_INT) };
+		const __m128i blueHalves{ _mm256_cvtps_ph(blue, _MM_FROUND_TO_NEAREST_INT) };
+		const __m128i redGreenLow{ _mm_unpacklo_epi16(redHalves, greenHalves) };
+		const __m128i redGreenHigh{ _mm_unpackhi_epi16(redHalves, greenHalves) };
+		const __m128i blueLow{ _mm_unpacklo_epi16(blueHalves, _mm_setzero_si128()) };
+		const __m128i blueHigh{ _mm_unpackhi_epi16(blueHalves, _mm_setzero_si128()) };
+
+		alignas(32) HdrPixel pixels[lanes]{};
+		_mm_store_si128(reinterpret_cast<__m128i*>(pixels), _mm_unpacklo_epi32(redGreenLow, blueLow));
+		_mm_store_si128(reinterpret_cast<__m128i*>(pixels + 2), _mm_unpackhi_epi32(redGreenLow, blueLow));
+		_mm_store_si128(reinterpret_cast<__m128i*>(pixels + 4), _mm_unpacklo_epi32(redGreenHigh, blueHigh));
+		_mm_store_si128(reinterpret_cast<__m128i*>(pixels + 6), _mm_unpackhi_epi32(redGreenHigh, blueHigh));
+
+		//Only lanes below count hold fragments, the rest are copies of lane 0
+		const int count{ std::min(batch.count - first, lanes) };
+
+		if (batch.pShadedPixels)
+		{
+			std::memcpy(batch.pShadedPixels + first, pixels, count * sizeof(HdrPixel));
+		}
+
+		//A run along one scanline is one copy, anything else goes out lane by lane
+		const int* pPixelIndices{ batch.pixelIndices + first };
+		bool isContiguous{ true };
+		for (int lane{ 1 }; lane < count; ++lane)
+		{
+			isContiguous &= pPixelIndices[lane] == pPixelIndices[0] + lane;
+		}
+
+		if (isContiguous && !m_Multisample.IsEnabled())
+		{
+			std::memcpy(m_ColourBuffer.data() + pPixelIndices[0], pixels, count * sizeof(HdrPixel));
+		}
+		else
+		{
+			//In lane order, so a later fragment that passed the depth test over an earlier one in the same batch still wins
+			for (int lane{}; lane < count; ++lane)
+			{
+				WritePixel(pPixelIndices[lane], pixels[lane], batch.sampleMasks[first + lane]);
+			}
+		}
+	}
+
+	void SoftwareRenderer::WritePixel(int pixelIndex, HdrPixel colour, int sampleMask) const
+	{
+		if (m_Multisample.IsEnabled())
+		{
+			m_Multisample.Write(pixelIndex, sampleMask, colour);
+			return;
+		}
+
+		m_ColourBuffer[pixelIndex] = colour;
+	}
+
+	void SoftwareRenderer::UpdateSpecularTable(float shininess)
+	{
+		if (shininess == m_SpecularTableShininess)
+		{
+			return;
+		}
+
+		//Every entry holds pow at its own cosine in the low 16 bits and at the next one in the high 16 bits, one gather fetches both lerp ends
+		constexpr int entries{ 256 };
+		m_SpecularTable.resize(SpecularTableGlossBuckets * entries);
+		for (int bucket{}; bucket < SpecularTableGlossBuckets; ++bucket)
+		{
+			const float exponent{ shininess * bucket / (SpecularTableGlossBuckets - 1) };
+			const auto power{ [&](int entry) { return static_cast<uint32_t>(std::pow(entry / static_cast<float>(entries), exponent) * 32767.0f + 0.5f); } };
+
+			for (int entry{}; entry < entries; ++entry)
+			{
+				m_SpecularTable[bucket * entries + entry] = power(entry) | (power(entry + 1) << 16);
+			}
+		}
+
+		m_SpecularTableShininess = shininess;
+	}
+
+	void SoftwareRenderer::SetFixedPointShading(bool fixedPointShading)
+	{
+		m_FixedPointShading = fixedPointShading;
+	}
+
+	bool SoftwareRenderer::MeasureFixedPointPSNR(float& psnr)
+	{
+		const bool wasFixedPoint{ m_FixedPointShading };
+
+		//Offscreen and over the whole frame, so the window, the histories and the buffers the next frame keeps from this one stay as they are
+		const size_t pixelCount{ static_cast<size_t>(m_Width) * m_Height };
+		std::vector<HdrPixel> colours(pixelCount);
+		std::vector<float> depths(pixelCount);
+		std::swap(m_ColourBuffer, colours);
+		float* const pDepthBufferPixels{ m_pDepthBufferPixels };
+		m_pDepthBufferPixels = depths.data();
+
+		//Same frame through both paths, only the pixels the mesh covers count
+		const ScreenRect frame{ 0, 0, m_Width, m_Height };
+		m_FixedPointShading = false;
+		Rasterize(frame, false);
+		const std::vector<HdrPixel> reference(m_ColourBuffer);
+
+		m_FixedPointShading = true;
+		m_FixedPointFragmentCount = 0;
+		Rasterize(frame, false);
+		m_FixedPointShading = wasFixedPoint;
+
+		std::swap(m_ColourBuffer, colours);
+		m_pDepthBufferPixels = pDepthBufferPixels;
+
+		//Observed area, local lights, gouraud and the debug views all shade in float whatever the toggle says
+		if (m_FixedPointFragmentCount == 0)
+		{
+			return false;
+		}
+
+		double squaredError{};
+		int channelCount{};
+		for (size_t i{}; i < pixelCount; ++i)
+		{
+			if (depths[i] == FLT_MAX)
+			{
+				continue;
+			}
+
+			//In 8 bit steps of the linear colours
+			const ColorRGB difference{ (ToColorRGB(reference[i]) - ToColorRGB(colours[i])) * 255.0f };
+			squaredError += difference.r * difference.r + difference.g * difference.g + difference.b * difference.b;
+			channelCount += 3;
+		}
+
+		psnr = squaredError == 0.0 ? FLT_MAX : static_cast<float>(10.0 * std::log10(255.0 * 255.0 / (squaredError / channelCount)));
+		return true;
+	}
+}
@@ -1,15 +1,52 @@
 #pragma once
 #include "Camera.h"
 #include "DataTypes.h"
-#include <map>
+#include "FastMath.h"
+#include "ShadowMap.h"
+#include "ShadingAtlas.h"
+#include "TemporalCache.h"
+#include "ShadingRateMap.h"
+#include "Checkerboard.h"
+#include "MultisampleBuffer.h"
+#include "PostProcess.h"
+#include "HdrPixel.h"
 
 struct SDL_Window;
 struct SDL_Surface;
+struct SDL_Rect;
 
 namespace dae
 {
 	class MeshData;
 	class Texture;
+	struct MaterialBinding;
+
+	//What the software rasterizer draws and how, handed to it every Update
+	struct SoftwareShadingSettings
+	{
+		bool shouldRotate{ true };
+		ShadingMode shadingMode{ ShadingMode::Combined };
+		bool showDepthBuffer{ false };
+		bool uniformColor{ false };
+		bool showBounding{ false };
+		bool renderNormal{ true };					//Normal map
+		CullMode cullMode{ CullMode::BackFace };
+		SampleMode sampleMode{ SampleMode::Point };
+		TextureAddressMode addressMode{ TextureAddressMode::Wrap };
+		bool tangentSpaceLighting{ true };			//Only taken without local lights
+		bool batchedShading{ true };
+		bool fixedPointShading{ false };			//Batched, whatever batchedShading says
+		bool shadows{ true };
+		bool shadingLod{ true };
+		bool showShadingLod{ false };
+		bool textureSpaceShading{ false };
+		int temporalRefreshInterval{ 0 };			//Frames between two shadings of a pixel with temporal reuse, 0 is off
+		bool dirtyRegions{ true };
+		bool coarseShading{ false };
+		bool checkerboard{ false };
+		bool multisampling{ false };
+		bool postProcessing{ false };				//Off, the frame is only packed, see SetPostProcessSettings
+	};
 
 	class SoftwareRenderer final
 	{
@@ -17,33 +54,244 @@ namespace dae
 		SoftwareRenderer(SDL_Window* pWindow, Camera* pCamera, int width, int height, std::vector<MeshData*>& pMeshes);
 		~SoftwareRenderer();
 
-		void Update(const Timer* pTimer, bool shouldRotate, ShadingMode shadingMode, bool showDepthBuffer, bool uniformColor, bool showBounding, bool renderNormal, CullMode cullMode);
+		void Update(const Timer* pTimer, const SoftwareShadingSettings& settings);
 		void Render() const;
 
+		//The next frame is rendered and presented in full, for when the window lost what was presented
+		void Invalidate();
+		//Whether the last Update found nothing on screen changed, Render then neither renders nor presents
+		bool IsFrameSkipped() const;
+		//Pixels the last Update marked for re-rendering
+		int GetDirtyPixelCount() const;
+
+		void SetMathAccuracy(MathAccuracy accuracy);
+
+		//Point and spot lights on top of the directional light, culled per screen tile
+		//While there are any, every frame gets a depth prepass and the lighting runs in world space
+		void AddLight(const Light& light);
+		void ClearLights();
+		int GetLightCount() const;
+
+		//Projected sizes (diameter of the mesh's bounding sphere, in output pixels) below which the cheaper shading kicks in
+		//Output pixels, so a lower render scale does not also count towards the thresholds the governor scales
+		void SetShadingLodThresholds(float noNormalMapBelow, float gouraudBelow);
+		static constexpr float DefaultNoNormalMapLodSize{ 192.0f };
+		static constexpr float DefaultGouraudLodSize{ 64.0f };
+		ShadingLod GetShadingLod() const;
+		float GetProjectedSize() const;
+
+		//Tiles of the shading atlas that hold a shaded colour and the ones shaded in the last update
+		int GetShadingAtlasTileCount() const;
+		int GetShadingAtlasRefreshCount() const;
+
+		//Fragments of the last frame that took their colour from the temporal history and the ones that were shaded
+		int GetTemporalReusedCount() const;
+		int GetTemporalShadedCount() const;
+
+		//Bytes 4x multisampling adds, at the render size: the sample depths, and the per pixel colours and flags together with
+		//the last frame's split pixels' sample colours; the plain depth and colour buffers stay as they are
+		size_t GetMultisampleDepthMemorySize() const;
+		size_t GetMultisampleColourMemorySize() const;
+		int GetMultisampleSplitPixelCount() const;
+
+		//Renders at scale times the window size (clamped to it) and upscales bilinearly into the back buffer, 1 renders at full size
+		//Another size drops every history that is kept per pixel and re-renders the whole frame
+		void SetRenderScale(float scale);
+		int GetRenderWidth() const;
+		int GetRenderHeight() const;
+		//Highest texture filter used, whatever the sample mode asks for
+		void SetTextureFilterLimit(TextureFilter filter);
+		//Exposure, tone mapping, sRGB encoding and FXAA the resolve applies while post-processing is on
+		void SetPostProcessSettings(const PostProcess::Settings& settings);
+
+		//Renders the current frame offscreen with the float and the fixed point shading and compares the covered pixels,
+		//false when the current settings never reach the fixed point shading so there was nothing to compare
+		bool MeasureFixedPointPSNR(float& psnr);
+		//Everything besides the geometry, the light and the eye a shaded colour depends on, packed to notice when it changes
+		uint32_t GetShadingSettings() const;
+		//Lets a failed check fall back to float for the frame it was made in, Update sets it again every frame
+		void SetFixedPointShading(bool fixedPointShading);
+
+		//Lowest PSNR (dB) against the float shading at which the fixed point shading is worth using
+		static constexpr float FixedPointMinPSNR{ 40.0f };
+
 	private:
+		//Half open pixel rectangle
+		struct ScreenRect
+		{
+			int left{};
+			int top{};
+			int right{};
+			int bottom{};
+		};
 
 		void VertexTransformationFunction() const;
-		ColorRGB ShadePixel(const Vertex_Out& vertexOut) const;
+		//Transforms, rasterizes and shades the rectangle into the colour and depth buffers
+		//A frame that is not presented neither reuses nor leaves anything for the frames around it: no temporal reuse,
+		//checkerboard, coarse shading, shading atlas, streaming or history
+		void Rasterize(const ScreenRect& rect, bool isPresented) const;
+		ColorRGB ShadePixel(const Vertex_Out& vertexOut, float uvLod, const MaterialBinding& material) const;
+		MaterialSample SampleMaterial(const Vector2& uv, float uvLod, const MaterialBinding& material) const;
+
+		//Shades the queued fragments and writes them to the back buffer, the batch is empty afterwards
+		void ShadeBatch(FragmentBatch& batch, const MaterialBinding& material) const;
+		void SampleBatchMaterial(const FragmentBatch& batch, int first, int count, const MaterialBinding& material, const MaterialSampleBatch& samples) const;
+		//8 float lanes starting at first
+		template<MathAccuracy Accuracy>
+		void ShadeBatch(const FragmentBatch& batch, int first, const MaterialBinding& material) const;
+		//All 16 lanes in Q15 int16, diffuse, specular and combined only
+		void ShadeBatchFixedPoint(const FragmentBatch& batch, const MaterialBinding& material) const;
+		//Into the colour buffer, or into the samples of the mask with multisampling
+		void WritePixel(int pixelIndex, HdrPixel colour, int sampleMask) const;
+		//Linear colours, for the 8 lanes starting at first
+		void WriteBatchPixels(const FragmentBatch& batch, int first, __m256 red, __m256 green, __m256 blue) const;
+
+		void UpdateSpecularTable(float shininess);
+		void UpdateShadingLod();
+		void UpdateShadingAtlas();
+		void UpdateDirtyRegion();
+		//Screen rectangle the rendered mesh's bounding sphere covers, false when part of it is behind the camera
+		bool GetScreenBounds(const Matrix& worldMatrix, ScreenRect& bounds) const;
+
+		void ResizeLightTiles();
+		//Sizes the colour buffer, and the resolve's target when the frame is upscaled, for the render size
+		void UpdateRenderTarget();
+		//Bilinear from the resolved render size frame into the back buffer, for the back buffer pixels the render rectangle reaches
+		void Upscale(const uint32_t* pSource, const ScreenRect& rect, SDL_Rect& upscaledRect) const;
+
+		//Depth range of every tile from the prepass, then the lights whose bounds reach into it
+		void CullLights() const;
+		//Sum of the lights culled into the tile of the pixel, every vector in world space
+		ColorRGB ShadeLocalLights(const Vector3& position, const Vector3& normal, const Vector3& lambertNormal, const Vector3& viewDirection,
+			const MaterialSample& maps, float shininess, int pixelX, int pixelY) const;
 
 		SDL_Window* m_pWindow{};
 		Camera* m_pCamera{};
 
 		SDL_Surface* m_pFrontBuffer{ nullptr };
 		SDL_Surface* m_pBackBuffer{ nullptr };
-		uint32_t* m_pBackBufferPixels{};
+		//What the rasterizer draws into, m_Width x m_Height, linear and unclamped; resolved into the back buffer's format
+		//once per frame, straight into the back buffer at full size and into m_ResolvedPixels below it
+		//Written by Render
+		mutable std::vector<HdrPixel> m_ColourBuffer{};
+		mutable std::vector<uint32_t> m_ResolvedPixels{};
 
+		//Allocated at the window size, the render size only uses its first rows
 		float* m_pDepthBufferPixels{};
 
 		std::vector<MeshData*> m_pMeshes{};
 
+		//Render size, the window's one is the back buffer's
 		int m_Width{};
 		int m_Height{};
+		int m_OutputWidth{};
+		int m_OutputHeight{};
+		TextureFilter m_TextureFilterLimit{ TextureFilter::Trilinear };
 
 		ShadingMode m_ShadingMode{};
 		CullMode m_CullMode{};
+		SamplerState m_SamplerState{};
+		MathAccuracy m_MathAccuracy{ MathAccuracy::Fast };
+
+		Vector3 m_LightDirection{ 0.577f,-0.577f,0.577f };
 
 		bool m_ShowDepthBuffer{};
 		bool m_NormalMapEnabled{ true };
+		bool m_TangentSpaceLighting{ true };
+		bool m_BatchedShading{ true };
+		bool m_FixedPointShading{};
+		//Fragments the fixed point shading shaded since MeasureFixedPointPSNR reset it
+		mutable int m_FixedPointFragmentCount{};
+
+		//pow(cosine, gloss * shininess) for the fixed point shading, gloss in buckets and 256 cosines per bucket
+		static constexpr int SpecularTableGlossBuckets{ 32 };
+		std::vector<uint32_t> m_SpecularTable{};
+		float m_SpecularTableShininess{ -1.0f };
+
+		//Directional light shadows, cast by the meshes the software rasterizer draws
+		static constexpr int ShadowMapSize{ 1024 };
+		ShadowMap m_ShadowMap{ ShadowMapSize };
+		bool m_ShadowsEnabled{ true };
+
+		//Picked once per frame for the rendered mesh, from its bounding sphere
+		bool m_ShadingLodEnabled{ true };
+		bool m_ShowShadingLod{};
+		ShadingLod m_ShadingLod{ ShadingLod::Full };
+		float m_NoNormalMapLodSize{ DefaultNoNormalMapLodSize };
+		float m_GouraudLodSize{ DefaultGouraudLodSize };
+		float m_ProjectedSize{};
+		//Mip the vertices sample at with gouraud shading, about one vertex spacing per texel
+		float m_GouraudUvLod{};
+		Vector3 m_BoundsCenter{};
+		float m_BoundsRadius{};
+
+		//Texture space shading: covered pixels read the cached colour, only pixels whose texels are not shaded yet run ShadePixel
+		//Off while there are local lights (their light lists are per screen tile) and with gouraud shading
+		static constexpr int ShadingAtlasSize{ 1024 };
+		static constexpr int ShadingAtlasTilesPerUpdate{ 256 };
+		static constexpr float ShadingAtlasMaxStaleAngle{ 2.0f * TO_RADIANS };
+		ShadingAtlas m_ShadingAtlas{ ShadingAtlasSize };
+		bool m_TextureSpaceShading{};
+		uint32_t m_ShadingAtlasSettings{ UINT32_MAX };
+		int m_ShadingAtlasRefreshCount{};
+
+		//Temporal reuse: fragments visible in the last frame as well take its colour, every pixel is shaded again at least every
+		//refresh interval frames; off in the debug views and with gouraud shading, which is cheaper than the reprojection
+		//Written by Render, the history is the frame it just finished
+		mutable TemporalCache m_TemporalCache;
+		int m_TemporalRefreshInterval{};
+
+		//Coarse shading: flat tiles of the last frame are shaded once per 2x2 or 4x4 pixels, the block's other fragments
+		//on the same surface take its colour; off in the debug views and with gouraud shading
+		//Written by Render, the rates are picked from the frame it just finished
+		mutable ShadingRateMap m_ShadingRateMap;
+		bool m_CoarseShading{};
+
+		//Checkerboard rendering: half of the pixels are rasterized and shaded, alternating every frame, the others reconstructed
+		//Written by Render, the history is the frame it just finished
+		mutable Checkerboard m_Checkerboard;
+		bool m_CheckerboardRendering{};
+
+		//4x multisampling: coverage and depth tested per sample, shaded once per pixel and triangle, resolved before anything
+		//reads the frame; the per pixel depth buffer keeps the closest sample for the passes that read it
+		//Written by Render
+		mutable MultisampleBuffer m_Multisample;
+		bool m_Multisampling{};
+
+		//The resolve, with the post-processing settings while it is on and only packing the frame otherwise
+		PostProcess m_PostProcess{};
+		PostProcess::Settings m_PostProcessSettings{};
+		bool m_PostProcessing{};
+
+		//World * view * projection of the rendered mesh in the last rendered frame, for its motion
+		mutable Matrix m_PreviousWorldViewProjection{};
+
+		//Dirty regions: what the last frame was rendered with, a frame where nothing changed is neither rendered nor presented
+		//and one where only the mesh moved re-renders the rectangle its old and new bounds cover
+		bool m_DirtyRegionsEnabled{ true };
+		bool m_IsInvalidated{ true };
+		Matrix m_RenderedViewMatrix{};
+		Matrix m_RenderedProjectionMatrix{};
+		Matrix m_RenderedWorldMatrix{};
+		uint64_t m_RenderedSettings{};
+		ScreenRect m_RenderedBounds{};
+		bool m_HasRenderedBounds{};
+		//Empty when the frame is skipped
+		ScreenRect m_DirtyRect{};
+		//With checkerboard rendering, the other half of the last dirty rectangle's pixels is still to be rendered
+		ScreenRect m_CheckerboardPendingRect{};
+		//With temporal reuse, the last dirty rectangle's pixels still show reused colours until every one was shaded again
+		ScreenRect m_TemporalPendingRect{};
+		int m_TemporalPendingFrames{};
+
+		static constexpr int LightTileSize{ 16 };
+		static constexpr int MaxLightsPerTile{ 256 };
+		std::vector<Light> m_Lights{};
+		int m_TileCountX{};
+		int m_TileCountY{};
+		//Rewritten by CullLights every frame, MaxLightsPerTile slots per tile
+		mutable std::vector<uint16_t> m_TileLightIndices{};
+		mutable std::vector<int> m_TileLightCounts{};
 		bool m_UniformColor{};
 		bool m_ShowBounding{};
 	};
@@ -0,0 +1,130 @@
+#include "pch.h"
+#include "TemporalCache.h"
+
+namespace dae
+{
+	TemporalCache::TemporalCache(int width, int height)
+		: m_Width{ width }
+		, m_Height{ height }
+	{
+	}
+
+	void TemporalCache::Resize(int width, int height)
+	{
+		m_Width = width;
+		m_Height = height;
+		m_HasHistory = false;
+	}
+
+	void TemporalCache::BeginFrame(int refreshInterval, uint32_t settings)
+	{
+		if (refreshInterval != m_RefreshInterval || settings != m_Settings)
+		{
+			m_HasHistory = false;
+		}
+
+		m_RefreshInterval = refreshInterval;
+		m_Settings = settings;
+		++m_FrameIndex;
+		m_ReusedCount = 0;
+		m_ShadedCount = 0;
+
+		if (m_RefreshInterval <= 0)
+		{
+			m_HasHistory = false;
+			return;
+		}
+
+		//Allocated on first use, a cache that is never turned on costs nothing
+		const size_t pixelCount{ static_cast<size_t>(m_Width) * m_Height };
+		m_Age.resize(pixelCount);
+		m_MotionVectors.assign(pixelCount, Vector2{});
+	}
+
+	bool TemporalCache::IsEnabled() const
+	{
+		return m_RefreshInterval > 0;
+	}
+
+	bool TemporalCache::Reproject(int px, int py, const Vector4& previousPosition, HdrPixel& colour)
+	{
+		const int index{ px + py * m_Width };
+		m_Age[index] = 0;
+
+		//Behind the camera in the last frame
+		if (!m_HasHistory || previousPosition.w <= 0.0f)
+		{
+			++m_ShadedCount;
+			return false;
+		}
+
+		//Same raster mapping as the rasterizer, pixel positions are their top left corners
+		const float previousX{ (previousPosition.x / previousPosition.w + 1.0f) * 0.5f * m_Width };
+		const float previousY{ (1.0f - previousPosition.y / previousPosition.w) * 0.5f * m_Height };
+		m_MotionVectors[index] = Vector2{ px - previousX, py - previousY };
+
+		const int historyX{ static_cast<int>(std::floor(previousX + 0.5f)) };
+		const int historyY{ static_cast<int>(std::floor(previousY + 0.5f)) };
+		if (historyX < 0 || historyX >= m_Width || historyY < 0 || historyY >= m_Height)
+		{
+			++m_ShadedCount;
+			return false;
+		}
+
+		//Disocclusion: whatever the history shows there is not this surface
+		const int historyIndex{ historyX + historyY * m_Width };
+		const float historyDepth{ m_HistoryDepth[historyIndex] };
+		if (historyDepth == FLT_MAX ||
+			std::abs(m_PreviousDepthB / (historyDepth - m_PreviousDepthA) - previousPosition.w) > DepthTolerance * previousPosition.w)
+		{
+			++m_ShadedCount;
+			return false;
+		}
+
+		//Due when it got too old, or on its slot of the diagonal stagger pattern
+		const int age{ m_HistoryAge[historyIndex] + 1 };
+		if (age >= m_RefreshInterval || (static_cast<uint32_t>(px + py) + m_FrameIndex) % static_cast<uint32_t>(m_RefreshInterval) == 0)
+		{
+			++m_ShadedCount;
+			return false;
+		}
+
+		m_Age[index] = static_cast<uint8_t>(age);
+		colour = m_HistoryColour[historyIndex];
+		++m_ReusedCount;
+		return true;
+	}
+
+	void TemporalCache::EndFrame(const HdrPixel* pColour, const float* pDepth, const Matrix& projection)
+	{
+		if (m_RefreshInterval <= 0)
+		{
+			return;
+		}
+
+		const size_t pixelCount{ static_cast<size_t>(m_Width) * m_Height };
+		m_HistoryColour.assign(pColour, pColour + pixelCount);
+		m_HistoryDepth.assign(pDepth, pDepth + pixelCount);
+		m_HistoryAge.swap(m_Age);
+		m_Age.resize(pixelCount);
+
+		m_PreviousDepthA = projection[2].z;
+		m_PreviousDepthB = projection[3].z;
+		m_HasHistory = true;
+	}
+
+	const Vector2& TemporalCache::GetMotionVector(int px, int py) const
+	{
+		return m_MotionVectors[px + py * m_Width];
+	}
+
+	int TemporalCache::GetReusedCount() const
+	{
+		return m_ReusedCount;
+	}
+
+	int TemporalCache::GetShadedCount() const
+	{
+		return m_ShadedCount;
+	}
+}
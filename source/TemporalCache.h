@@ -0,0 +1,67 @@
+#pragma once
+#include <vector>
+#include "Math.h"
+#include "HdrPixel.h"
+
+namespace dae
+{
+	//Reverse reprojection cache for the software rasterizer: the last frame's colour, depth and motion vectors
+	//A fragment that was visible in the last frame as well takes its colour over instead of being shaded again,
+	//every pixel is shaded again at least every refresh interval frames, staggered so every frame shades about as many
+	class TemporalCache final
+	{
+	public:
+		//Relative difference in view depth above which the history belongs to another surface
+		static constexpr float DepthTolerance{ 0.01f };
+
+		TemporalCache(int width, int height);
+
+		TemporalCache(const TemporalCache&) = delete;
+		TemporalCache(TemporalCache&&) noexcept = delete;
+		TemporalCache& operator=(const TemporalCache&) = delete;
+		TemporalCache& operator=(TemporalCache&&) noexcept = delete;
+
+		//For another render resolution, drops the history
+		void Resize(int width, int height);
+
+		//Starts a frame, refreshInterval 0 turns the cache off
+		//The history is dropped when the interval or the settings (anything the colours depend on besides the geometry) changed
+		void BeginFrame(int refreshInterval, uint32_t settings);
+		bool IsEnabled() const;
+
+		//previousPosition is the fragment's clip space position in the last frame, its motion vector is stored either way
+		//True with the history's colour when it is the same surface and the pixel is not due to be shaded again
+		bool Reproject(int px, int py, const Vector4& previousPosition, HdrPixel& colour);
+
+		//Keeps the finished frame as the next one's history
+		void EndFrame(const HdrPixel* pColour, const float* pDepth, const Matrix& projection);
+
+		//Pixels (current minus last frame position), zero where nothing was reprojected this frame
+		const Vector2& GetMotionVector(int px, int py) const;
+		int GetReusedCount() const;
+		int GetShadedCount() const;
+
+	private:
+		int m_Width{};
+		int m_Height{};
+
+		int m_RefreshInterval{};
+		uint32_t m_Settings{ UINT32_MAX };
+		uint32_t m_FrameIndex{};
+		bool m_HasHistory{};
+
+		std::vector<HdrPixel> m_HistoryColour{};
+		std::vector<float> m_HistoryDepth{};
+		//Frames since the pixel was last shaded
+		std::vector<uint8_t> m_HistoryAge{};
+		std::vector<uint8_t> m_Age{};
+		std::vector<Vector2> m_MotionVectors{};
+
+		//Stored depth d = A + B / viewZ of the last frame's projection
+		float m_PreviousDepthA{};
+		float m_PreviousDepthB{};
+
+		int m_ReusedCount{};
+		int m_ShadedCount{};
+	};
+}
@@ -1,36 +1,857 @@
 #include"pch.h"
 #include "Texture.h"
 #include "Vector2.h"
+#include "JobSystem.h"
+#include "BlockCompression.h"
 #include <SDL_image.h>
+#include <atomic>
+#include <immintrin.h>
 
 namespace dae
 {
-	Texture::Texture(SDL_Surface* pSurface) :
-		m_pSurface{ pSurface },
-		m_pSurfacePixels{ (uint32_t*)pSurface->pixels }
+	namespace
+	{
+		//Every codec turns one stored texel into 4 floats, Scale maps those to the range the shader expects
+		struct RGBA8Codec
+		{
+			static constexpr int BytesPerTexel{ 4 };
+			static constexpr float Scale{ 1 / 255.f };
+
+			static __m128 Unpack(const uint8_t* pTexels, int index)
+			{
+				return _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_loadu_si32(pTexels + index * BytesPerTexel)));
+			}
+		};
+
+		struct NormalSNorm8Codec
+		{
+			static constexpr int BytesPerTexel{ 4 };
+			static constexpr float Scale{ 1 / 127.f };
+
+			static __m128 Unpack(const uint8_t* pTexels, int index)
+			{
+				return _mm_cvtepi32_ps(_mm_cvtepi8_epi32(_mm_loadu_si32(pTexels + index * BytesPerTexel)));
+			}
+		};
+
+		struct R8Codec
+		{
+			static constexpr int BytesPerTexel{ 1 };
+			static constexpr float Scale{ 1 / 255.f };
+
+			//Broadcast, so a scalar map reads back as a grey colour
+			static __m128 Unpack(const uint8_t* pTexels, int index)
+			{
+				return _mm_set1_ps(static_cast<float>(pTexels[index]));
+			}
+		};
+
+		//Packed material texels are 8 bytes: diffuse R, G, B, A, then normal x, y (snorm), gloss, specular
+		//This codec reads the diffuse half, so Sample and SampleBatch return the diffuse colour
+		struct PackedMaterialCodec
+		{
+			static constexpr int BytesPerTexel{ 8 };
+			static constexpr float Scale{ 1 / 255.f };
+
+			static __m128 Unpack(const uint8_t* pTexels, int index)
+			{
+				return _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_loadu_si32(pTexels + index * BytesPerTexel)));
+			}
+		};
+
+		//The whole packed material texel in 8 lanes, diffuse in the low half and the surface in the high half
+		//SampleMaterial filters every map with one set of addresses and weights this way
+		struct PackedTexelCodec
+		{
+			static constexpr int BytesPerTexel{ 8 };
+			//The channels have different ranges, the caller scales them
+			static constexpr float Scale{ 1.f };
+
+			static __m256 Unpack(const uint8_t* pTexels, int index)
+			{
+				const __m128i bytes{ _mm_loadl_epi64(reinterpret_cast<const __m128i*>(pTexels + index * BytesPerTexel)) };
+
+				//Normal x, y are signed, every other byte unsigned
+				return _mm256_blend_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes)), _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(bytes)), 0b00110000);
+			}
+		};
+
+		//What a codec unpacks one texel to, 4 channels or the 8 of a whole packed material texel
+		template<typename Codec>
+		using Texel = decltype(Codec::Unpack(nullptr, 0));
+
+		template<typename Codec>
+		constexpr int ChannelCount{ static_cast<int>(sizeof(Texel<Codec>) / sizeof(float)) };
+
+		inline float ReconstructNormalZ(float x, float y)
+		{
+			return std::sqrt(std::max(0.0f, 1.0f - x * x - y * y));
+		}
+
+		//Every layout maps a texel coordinate to its index inside the level
+		struct LinearLayout
+		{
+			static int Index(int x, int y, int width)
+			{
+				return x + y * width;
+			}
+
+			static __m128i Index4(__m128i x, __m128i y, __m128i width)
+			{
+				return _mm_add_epi32(x, _mm_mullo_epi32(y, width));
+			}
+		};
+
+		//Keeps a bilinear footprint inside one block most of the time, and a block of RGBA8 texels is one cache line
+		struct Tiled4x4Layout
+		{
+			static int Index(int x, int y, int width)
+			{
+				const int tilesPerRow{ (width + 3) >> 2 };
+				return (((y >> 2) * tilesPerRow + (x >> 2)) << 4) + ((y & 3) << 2) + (x & 3);
+			}
+
+			static __m128i Index4(__m128i x, __m128i y, __m128i width)
+			{
+				const __m128i three{ _mm_set1_epi32(3) };
+				const __m128i tilesPerRow{ _mm_srli_epi32(_mm_add_epi32(width, three), 2) };
+				const __m128i tile{ _mm_add_epi32(_mm_mullo_epi32(_mm_srli_epi32(y, 2), tilesPerRow), _mm_srli_epi32(x, 2)) };
+				const __m128i inTile{ _mm_add_epi32(_mm_slli_epi32(_mm_and_si128(y, three), 2), _mm_and_si128(x, three)) };
+
+				return _mm_add_epi32(_mm_slli_epi32(tile, 4), inTile);
+			}
+		};
+
+		//Every block format decodes to one of the uncompressed formats, Decoded is that format's codec
+		struct BC1Block
+		{
+			using Decoded = RGBA8Codec;
+			static constexpr int BytesPerBlock{ 8 };
+
+			static void Encode(const uint8_t* pTexels, uint8_t* pBlock) { BlockCompression::EncodeBC1(pTexels, pBlock); }
+			static void Decode(const uint8_t* pBlock, uint8_t* pTexels) { BlockCompression::DecodeBC1(pBlock, pTexels); }
+		};
+
+		struct BC3Block
+		{
+			using Decoded = RGBA8Codec;
+			static constexpr int BytesPerBlock{ 16 };
+
+			static void Encode(const uint8_t* pTexels, uint8_t* pBlock) { BlockCompression::EncodeBC3(pTexels, pBlock); }
+			static void Decode(const uint8_t* pBlock, uint8_t* pTexels) { BlockCompression::DecodeBC3(pBlock, pTexels); }
+		};
+
+		struct BC4Block
+		{
+			using Decoded = R8Codec;
+			static constexpr int BytesPerBlock{ 8 };
+
+			static void Encode(const uint8_t* pTexels, uint8_t* pBlock) { BlockCompression::EncodeBC4(pTexels, pBlock); }
+			static void Decode(const uint8_t* pBlock, uint8_t* pTexels) { BlockCompression::DecodeBC4(pBlock, pTexels); }
+		};
+
+		struct BC5Block
+		{
+			using Decoded = NormalSNorm8Codec;
+			static constexpr int BytesPerBlock{ 16 };
+
+			static void Encode(const uint8_t* pTexels, uint8_t* pBlock) { BlockCompression::EncodeBC5(pTexels, pBlock); }
+			static void Decode(const uint8_t* pBlock, uint8_t* pTexels) { BlockCompression::DecodeBC5(pBlock, pTexels); }
+		};
+
+		//Bumped whenever block data gets freed, so no thread keeps decoded texels of a block whose memory got reused
+		std::atomic<uint32_t> g_BlockCacheGeneration{ 0 };
+
+		//Direct mapped cache of the last decoded blocks on this thread
+		//A bilinear footprint and the next few pixels of a span nearly always land in blocks that are already decoded
+		template<typename Block>
+		const uint8_t* DecodeBlockCached(const uint8_t* pBlock)
+		{
+			static constexpr int EntryCount{ 64 };
+
+			struct BlockCache
+			{
+				const uint8_t* pBlocks[EntryCount]{};
+				alignas(16) uint8_t texels[EntryCount][16 * Block::Decoded::BytesPerTexel]{};
+				uint32_t generation{};
+			};
+
+			thread_local BlockCache cache{};
+
+			const uint32_t generation{ g_BlockCacheGeneration.load(std::memory_order_relaxed) };
+			if (cache.generation != generation)
+			{
+				std::fill(std::begin(cache.pBlocks), std::end(cache.pBlocks), nullptr);
+				cache.generation = generation;
+			}
+
+			const size_t slot{ (reinterpret_cast<uintptr_t>(pBlock) / Block::BytesPerBlock) % EntryCount };
+			if (cache.pBlocks[slot] != pBlock)
+			{
+				Block::Decode(pBlock, cache.texels[slot]);
+				cache.pBlocks[slot] = pBlock;
+			}
+
+			return cache.texels[slot];
+		}
+
+		//Block formats are always sampled through Tiled4x4Layout, its index is block * 16 + texel inside the block
+		template<typename Block>
+		struct BlockCodec
+		{
+			static constexpr float Scale{ Block::Decoded::Scale };
+
+			static __m128 Unpack(const uint8_t* pBlocks, int index)
+			{
+				return Block::Decoded::Unpack(DecodeBlockCached<Block>(pBlocks + (index >> 4) * Block::BytesPerBlock), index & 15);
+			}
+		};
+
+		using BC1Codec = BlockCodec<BC1Block>;
+		using BC3Codec = BlockCodec<BC3Block>;
+		using BC4Codec = BlockCodec<BC4Block>;
+		using BC5Codec = BlockCodec<BC5Block>;
+
+		bool IsBlockCompressed(TextureFormat format)
+		{
+			return format == TextureFormat::BC1 || format == TextureFormat::BC3 || format == TextureFormat::BC4 || format == TextureFormat::BC5;
+		}
+
+		//The uncompressed format a texture gets built in (and decodes back to)
+		TextureFormat GetDecodedFormat(TextureFormat format)
+		{
+			switch (format)
+			{
+			case dae::TextureFormat::BC1:
+			case dae::TextureFormat::BC3:
+				return TextureFormat::RGBA8;
+			case dae::TextureFormat::BC4:
+				return TextureFormat::R8;
+			case dae::TextureFormat::BC5:
+				return TextureFormat::NormalSNorm8;
+			default:
+				return format;
+			}
+		}
+
+		int GetBytesPerTexel(TextureFormat format)
+		{
+			switch (format)
+			{
+			case dae::TextureFormat::R8:
+				return R8Codec::BytesPerTexel;
+			case dae::TextureFormat::PackedMaterial:
+				return PackedMaterialCodec::BytesPerTexel;
+			case dae::TextureFormat::BC1:
+			case dae::TextureFormat::BC3:
+			case dae::TextureFormat::BC4:
+			case dae::TextureFormat::BC5:
+				return 0;
+			default:
+				return RGBA8Codec::BytesPerTexel;
+			}
+		}
+
+		int GetBytesPerBlock(TextureFormat format)
+		{
+			switch (format)
+			{
+			case dae::TextureFormat::BC1:
+				return BC1Block::BytesPerBlock;
+			case dae::TextureFormat::BC3:
+				return BC3Block::BytesPerBlock;
+			case dae::TextureFormat::BC4:
+				return BC4Block::BytesPerBlock;
+			case dae::TextureFormat::BC5:
+				return BC5Block::BytesPerBlock;
+			default:
+				return 0;
+			}
+		}
+
+		//Calls function.template operator()<Block>() for a block compressed format
+		template<typename Function>
+		void DispatchBlockFormat(TextureFormat format, Function&& function)
+		{
+			switch (format)
+			{
+			case dae::TextureFormat::BC1:
+				function.template operator()<BC1Block>();
+				break;
+			case dae::TextureFormat::BC3:
+				function.template operator()<BC3Block>();
+				break;
+			case dae::TextureFormat::BC4:
+				function.template operator()<BC4Block>();
+				break;
+			case dae::TextureFormat::BC5:
+				function.template operator()<BC5Block>();
+				break;
+			default:
+				break;
+			}
+		}
+
+		size_t GetLevelTexelCount(int width, int height, TextureLayout layout)
+		{
+			if (layout == TextureLayout::Tiled4x4)
+			{
+				//Partial blocks at the right and bottom edge get padded
+				return static_cast<size_t>((width + 3) >> 2) * ((height + 3) >> 2) * 16;
+			}
+
+			return static_cast<size_t>(width) * height;
+		}
+
+		//Calls function.template operator()<Codec, Layout>() for the texture's format and layout,
+		//so the per-texel code is compiled once for every combination instead of branching per texel
+		template<typename Function>
+		void DispatchFormat(TextureFormat format, TextureLayout layout, Function&& function)
+		{
+			const bool isTiled{ layout == TextureLayout::Tiled4x4 };
+
+			switch (format)
+			{
+			case dae::TextureFormat::RGBA8:
+				isTiled ? function.template operator()<RGBA8Codec, Tiled4x4Layout>() : function.template operator()<RGBA8Codec, LinearLayout>();
+				break;
+			case dae::TextureFormat::NormalSNorm8:
+				isTiled ? function.template operator()<NormalSNorm8Codec, Tiled4x4Layout>() : function.template operator()<NormalSNorm8Codec, LinearLayout>();
+				break;
+			case dae::TextureFormat::R8:
+				isTiled ? function.template operator()<R8Codec, Tiled4x4Layout>() : function.template operator()<R8Codec, LinearLayout>();
+				break;
+			case dae::TextureFormat::PackedMaterial:
+				isTiled ? function.template operator()<PackedMaterialCodec, Tiled4x4Layout>() : function.template operator()<PackedMaterialCodec, LinearLayout>();
+				break;
+			case dae::TextureFormat::BC1:
+				function.template operator()<BC1Codec, Tiled4x4Layout>();
+				break;
+			case dae::TextureFormat::BC3:
+				function.template operator()<BC3Codec, Tiled4x4Layout>();
+				break;
+			case dae::TextureFormat::BC4:
+				function.template operator()<BC4Codec, Tiled4x4Layout>();
+				break;
+			case dae::TextureFormat::BC5:
+				function.template operator()<BC5Codec, Tiled4x4Layout>();
+				break;
+			default:
+				break;
+			}
+		}
+
+		inline __m128 Lerp4(__m128 a, __m128 b, __m128 factor)
+		{
+			return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), factor));
+		}
+
+		//Blends every channel of two texels by the same factor
+		inline __m128 LerpTexel(__m128 a, __m128 b, float factor)
+		{
+			return Lerp4(a, b, _mm_set1_ps(factor));
+		}
+
+		inline __m256 LerpTexel(__m256 a, __m256 b, float factor)
+		{
+			return _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), _mm256_set1_ps(factor)));
+		}
+
+		inline float AddressCoordinate(float coordinate, TextureAddressMode addressMode)
+		{
+			if (addressMode == TextureAddressMode::Wrap)
+			{
+				return coordinate - std::floor(coordinate);
+			}
+
+			return Saturate(coordinate);
+		}
+
+		inline __m128 AddressCoordinate4(__m128 coordinate, TextureAddressMode addressMode)
+		{
+			if (addressMode == TextureAddressMode::Wrap)
+			{
+				return _mm_sub_ps(coordinate, _mm_floor_ps(coordinate));
+			}
+
+			return _mm_min_ps(_mm_max_ps(coordinate, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+		}
+
+		//Coordinates are already addressed to [0, 1], so a bilinear footprint is at most one texel outside the level
+		inline int AddressTexel(int texel, int size, TextureAddressMode addressMode)
+		{
+			if (addressMode == TextureAddressMode::Wrap)
+			{
+				return texel < 0 ? texel + size : (texel >= size ? texel - size : texel);
+			}
+
+			return Clamp(texel, 0, size - 1);
+		}
+
+		inline __m128i AddressTexel4(__m128i texel, __m128i size, TextureAddressMode addressMode)
+		{
+			const __m128i maxTexel{ _mm_sub_epi32(size, _mm_set1_epi32(1)) };
+
+			if (addressMode == TextureAddressMode::Wrap)
+			{
+				const __m128i below{ _mm_cmplt_epi32(texel, _mm_setzero_si128()) };
+				const __m128i above{ _mm_cmpgt_epi32(texel, maxTexel) };
+				texel = _mm_add_epi32(texel, _mm_and_si128(below, size));
+				return _mm_sub_epi32(texel, _mm_and_si128(above, size));
+			}
+
+			return _mm_min_epi32(_mm_max_epi32(texel, _mm_setzero_si128()), maxTexel);
+		}
+
+		template<typename Codec, typename Layout>
+		Texel<Codec> SamplePoint(const Texture::MipLevel& mipLevel, float u, float v)
+		{
+			const int x{ std::min(static_cast<int>(u * mipLevel.width), mipLevel.width - 1) };
+			const int y{ std::min(static_cast<int>(v * mipLevel.height), mipLevel.height - 1) };
+
+			return Codec::Unpack(mipLevel.pTexels, Layout::Index(x, y, mipLevel.width));
+		}
+
+		template<typename Codec, typename Layout>
+		Texel<Codec> SampleBilinear(const Texture::MipLevel& mipLevel, float u, float v, TextureAddressMode addressMode)
+		{
+			//Texel centers sit at half texel offsets
+			const float x{ u * mipLevel.width - 0.5f };
+			const float y{ v * mipLevel.height - 0.5f };
+
+			const float xFloor{ std::floor(x) };
+			const float yFloor{ std::floor(y) };
+
+			const int x0{ AddressTexel(static_cast<int>(xFloor), mipLevel.width, addressMode) };
+			const int y0{ AddressTexel(static_cast<int>(yFloor), mipLevel.height, addressMode) };
+			const int x1{ AddressTexel(static_cast<int>(xFloor) + 1, mipLevel.width, addressMode) };
+			const int y1{ AddressTexel(static_cast<int>(yFloor) + 1, mipLevel.height, addressMode) };
+
+			const uint8_t* pTexels{ mipLevel.pTexels };
+			const int width{ mipLevel.width };
+
+			//Every channel of the 2x2 footprint gets blended at once
+			const float xBlend{ x - xFloor };
+			const Texel<Codec> top{ LerpTexel(Codec::Unpack(pTexels, Layout::Index(x0, y0, width)), Codec::Unpack(pTexels, Layout::Index(x1, y0, width)), xBlend) };
+			const Texel<Codec> bottom{ LerpTexel(Codec::Unpack(pTexels, Layout::Index(x0, y1, width)), Codec::Unpack(pTexels, Layout::Index(x1, y1, width)), xBlend) };
+
+			return LerpTexel(top, bottom, y - yFloor);
+		}
+
+		//Returns the filtered texel in the codec's range, lod is already clamped to the mip chain
+		template<typename Codec, typename Layout>
+		Texel<Codec> SampleFiltered(const std::vector<Texture::MipLevel>& mipLevels, const Vector2& uv, const SamplerState& sampler, float lod)
+		{
+			const float u{ AddressCoordinate(uv.x, sampler.addressMode) };
+			const float v{ AddressCoordinate(uv.y, sampler.addressMode) };
+
+			switch (sampler.filter)
+			{
+			case dae::TextureFilter::Point:
+				return SamplePoint<Codec, Layout>(mipLevels[static_cast<int>(lod + 0.5f)], u, v);
+			case dae::TextureFilter::Bilinear:
+				return SampleBilinear<Codec, Layout>(mipLevels[static_cast<int>(lod + 0.5f)], u, v, sampler.addressMode);
+			case dae::TextureFilter::Trilinear:
+			{
+				//Blend the bilinear results of the two closest levels
+				const int level{ static_cast<int>(lod) };
+				const Texel<Codec> colour{ SampleBilinear<Codec, Layout>(mipLevels[level], u, v, sampler.addressMode) };
+
+				if (level + 1 >= static_cast<int>(mipLevels.size()))
+				{
+					return colour;
+				}
+
+				const Texel<Codec> nextColour{ SampleBilinear<Codec, Layout>(mipLevels[level + 1], u, v, sampler.addressMode) };
+				return LerpTexel(colour, nextColour, lod - level);
+			}
+			default:
+				return Texel<Codec>{};
+			}
+		}
+
+		//Per-lane level description for the batched paths, every lane can sit on another mip
+		struct LevelLanes
+		{
+			const uint8_t* pTexels[4]{};
+			__m128i width{};
+			__m128i height{};
+		};
+
+		inline LevelLanes GetLevelLanes(const std::vector<Texture::MipLevel>& mipLevels, const int levels[4])
+		{
+			LevelLanes lanes{};
+			alignas(16) int width[4]{};
+			alignas(16) int height[4]{};
+
+			for (int lane{}; lane < 4; ++lane)
+			{
+				const Texture::MipLevel& mipLevel{ mipLevels[levels[lane]] };
+				lanes.pTexels[lane] = mipLevel.pTexels;
+				width[lane] = mipLevel.width;
+				height[lane] = mipLevel.height;
+			}
+
+			lanes.width = _mm_load_si128(reinterpret_cast<const __m128i*>(width));
+			lanes.height = _mm_load_si128(reinterpret_cast<const __m128i*>(height));
+			return lanes;
+		}
+
+		//Fetches one texel per lane and transposes them, so channels[c] holds channel c of the 4 lanes
+		//Callers that do not need every channel ignore the rest, they get optimized away once inlined
+		template<typename Codec>
+		void GatherTexels(const LevelLanes& lanes, __m128i index, __m128 (&channels)[ChannelCount<Codec>])
+		{
+			alignas(16) int indices[4]{};
+			_mm_store_si128(reinterpret_cast<__m128i*>(indices), index);
+
+			const Texel<Codec> texel0{ Codec::Unpack(lanes.pTexels[0], indices[0]) };
+			const Texel<Codec> texel1{ Codec::Unpack(lanes.pTexels[1], indices[1]) };
+			const Texel<Codec> texel2{ Codec::Unpack(lanes.pTexels[2], indices[2]) };
+			const Texel<Codec> texel3{ Codec::Unpack(lanes.pTexels[3], indices[3]) };
+
+			if constexpr (ChannelCount<Codec> == 8)
+			{
+				//Both halves of the texels get transposed on their own
+				__m128 low0{ _mm256_castps256_ps128(texel0) }, low1{ _mm256_castps256_ps128(texel1) }, low2{ _mm256_castps256_ps128(texel2) }, low3{ _mm256_castps256_ps128(texel3) };
+				__m128 high0{ _mm256_extractf128_ps(texel0, 1) }, high1{ _mm256_extractf128_ps(texel1, 1) }, high2{ _mm256_extractf128_ps(texel2, 1) }, high3{ _mm256_extractf128_ps(texel3, 1) };
+
+				_MM_TRANSPOSE4_PS(low0, low1, low2, low3);
+				_MM_TRANSPOSE4_PS(high0, high1, high2, high3);
+
+				channels[0] = low0;
+				channels[1] = low1;
+				channels[2] = low2;
+				channels[3] = low3;
+				channels[4] = high0;
+				channels[5] = high1;
+				channels[6] = high2;
+				channels[7] = high3;
+			}
+			else
+			{
+				__m128 transposed0{ texel0 }, transposed1{ texel1 }, transposed2{ texel2 }, transposed3{ texel3 };
+				_MM_TRANSPOSE4_PS(transposed0, transposed1, transposed2, transposed3);
+
+				channels[0] = transposed0;
+				channels[1] = transposed1;
+				channels[2] = transposed2;
+				channels[3] = transposed3;
+			}
+		}
+
+		template<typename Codec, typename Layout>
+		void SamplePoint4(const LevelLanes& lanes, __m128 u, __m128 v, __m128 (&channels)[ChannelCount<Codec>])
+		{
+			const __m128i maxX{ _mm_sub_epi32(lanes.width, _mm_set1_epi32(1)) };
+			const __m128i maxY{ _mm_sub_epi32(lanes.height, _mm_set1_epi32(1)) };
+
+			const __m128i x{ _mm_min_epi32(_mm_cvttps_epi32(_mm_mul_ps(u, _mm_cvtepi32_ps(lanes.width))), maxX) };
+			const __m128i y{ _mm_min_epi32(_mm_cvttps_epi32(_mm_mul_ps(v, _mm_cvtepi32_ps(lanes.height))), maxY) };
+
+			GatherTexels<Codec>(lanes, Layout::Index4(x, y, lanes.width), channels);
+		}
+
+		template<typename Codec, typename Layout>
+		void SampleBilinear4(const LevelLanes& lanes, __m128 u, __m128 v, TextureAddressMode addressMode, __m128 (&channels)[ChannelCount<Codec>])
+		{
+			const __m128 half{ _mm_set1_ps(0.5f) };
+			const __m128 x{ _mm_sub_ps(_mm_mul_ps(u, _mm_cvtepi32_ps(lanes.width)), half) };
+			const __m128 y{ _mm_sub_ps(_mm_mul_ps(v, _mm_cvtepi32_ps(lanes.height)), half) };
+
+			const __m128 xFloor{ _mm_floor_ps(x) };
+			const __m128 yFloor{ _mm_floor_ps(y) };
+
+			const __m128 xBlend{ _mm_sub_ps(x, xFloor) };
+			const __m128 yBlend{ _mm_sub_ps(y, yFloor) };
+
+			const __m128i one{ _mm_set1_epi32(1) };
+			const __m128i x0{ _mm_cvttps_epi32(xFloor) };
+			const __m128i y0{ _mm_cvttps_epi32(yFloor) };
+			const __m128i column0{ AddressTexel4(x0, lanes.width, addressMode) };
+			const __m128i column1{ AddressTexel4(_mm_add_epi32(x0, one), lanes.width, addressMode) };
+			const __m128i row0{ AddressTexel4(y0, lanes.height, addressMode) };
+			const __m128i row1{ AddressTexel4(_mm_add_epi32(y0, one), lanes.height, addressMode) };
+
+			__m128 texels00[ChannelCount<Codec>], texels10[ChannelCount<Codec>], texels01[ChannelCount<Codec>], texels11[ChannelCount<Codec>];
+			GatherTexels<Codec>(lanes, Layout::Index4(column0, row0, lanes.width), texels00);
+			GatherTexels<Codec>(lanes, Layout::Index4(column1, row0, lanes.width), texels10);
+			GatherTexels<Codec>(lanes, Layout::Index4(column0, row1, lanes.width), texels01);
+			GatherTexels<Codec>(lanes, Layout::Index4(column1, row1, lanes.width), texels11);
+
+			for (int channel{}; channel < ChannelCount<Codec>; ++channel)
+			{
+				channels[channel] = Lerp4(Lerp4(texels00[channel], texels10[channel], xBlend), Lerp4(texels01[channel], texels11[channel], xBlend), yBlend);
+			}
+		}
+
+		template<typename Codec, typename Layout>
+		void SampleBatch4(const std::vector<Texture::MipLevel>& mipLevels, __m128 u, __m128 v, __m128 lod, const SamplerState& sampler,
+			__m128 (&channels)[ChannelCount<Codec>])
+		{
+			alignas(16) int levels[4]{};
+
+			switch (sampler.filter)
+			{
+			case dae::TextureFilter::Point:
+				_mm_store_si128(reinterpret_cast<__m128i*>(levels), _mm_cvttps_epi32(_mm_add_ps(lod, _mm_set1_ps(0.5f))));
+				SamplePoint4<Codec, Layout>(GetLevelLanes(mipLevels, levels), u, v, channels);
+				break;
+			case dae::TextureFilter::Bilinear:
+				_mm_store_si128(reinterpret_cast<__m128i*>(levels), _mm_cvttps_epi32(_mm_add_ps(lod, _mm_set1_ps(0.5f))));
+				SampleBilinear4<Codec, Layout>(GetLevelLanes(mipLevels, levels), u, v, sampler.addressMode, channels);
+				break;
+			case dae::TextureFilter::Trilinear:
+			{
+				const __m128 maxLod{ _mm_set1_ps(static_cast<float>(mipLevels.size() - 1)) };
+				const __m128 levelFloor{ _mm_floor_ps(lod) };
+				const __m128 levelBlend{ _mm_sub_ps(lod, levelFloor) };
+
+				_mm_store_si128(reinterpret_cast<__m128i*>(levels), _mm_cvttps_epi32(levelFloor));
+				SampleBilinear4<Codec, Layout>(GetLevelLanes(mipLevels, levels), u, v, sampler.addressMode, channels);
+
+				//Lanes already on the last level blend with themselves (levelBlend is 0 there)
+				_mm_store_si128(reinterpret_cast<__m128i*>(levels), _mm_cvttps_epi32(_mm_min_ps(_mm_add_ps(levelFloor, _mm_set1_ps(1.0f)), maxLod)));
+
+				__m128 nextChannels[ChannelCount<Codec>];
+				SampleBilinear4<Codec, Layout>(GetLevelLanes(mipLevels, levels), u, v, sampler.addressMode, nextChannels);
+
+				for (int channel{}; channel < ChannelCount<Codec>; ++channel)
+				{
+					channels[channel] = Lerp4(channels[channel], nextChannels[channel], levelBlend);
+				}
+			}
+			break;
+			default:
+				break;
+			}
+
+			const __m128 scale{ _mm_set1_ps(Codec::Scale) };
+			for (__m128& channel : channels)
+			{
+				channel = _mm_mul_ps(channel, scale);
+			}
+		}
+
+		template<typename Codec>
+		void DownsampleTexel(const Texture::MipLevel& source, int x0, int x1, int y0, int y1, uint8_t* pTexel);
+
+		//Average every byte channel, +2 rounds to nearest instead of truncating
+		template<>
+		void DownsampleTexel<RGBA8Codec>(const Texture::MipLevel& source, int x0, int x1, int y0, int y1, uint8_t* pTexel)
+		{
+			const int box[4]{ x0 + y0 * source.width, x1 + y0 * source.width, x0 + y1 * source.width, x1 + y1 * source.width };
+
+			for (int channel{}; channel < 4; ++channel)
+			{
+				int sum{ 2 };
+				for (int index : box)
+				{
+					sum += source.pTexels[index * 4 + channel];
+				}
+
+				pTexel[channel] = static_cast<uint8_t>(sum / 4);
+			}
+		}
+
+		template<>
+		void DownsampleTexel<R8Codec>(const Texture::MipLevel& source, int x0, int x1, int y0, int y1, uint8_t* pTexel)
+		{
+			const int sum{ 2 + source.pTexels[x0 + y0 * source.width] + source.pTexels[x1 + y0 * source.width] +
+				source.pTexels[x0 + y1 * source.width] + source.pTexels[x1 + y1 * source.width] };
+
+			*pTexel = static_cast<uint8_t>(sum / 4);
+		}
+
+		//Normals get averaged as vectors and renormalized, averaging the bytes would shorten them
+		template<>
+		void DownsampleTexel<NormalSNorm8Codec>(const Texture::MipLevel& source, int x0, int x1, int y0, int y1, uint8_t* pTexel)
+		{
+			const int box[4]{ x0 + y0 * source.width, x1 + y0 * source.width, x0 + y1 * source.width, x1 + y1 * source.width };
+			const int8_t* pSource{ reinterpret_cast<const int8_t*>(source.pTexels) };
+
+			Vector3 normal{};
+			for (int index : box)
+			{
+				normal += Vector3{ static_cast<float>(pSource[index * 4]), static_cast<float>(pSource[index * 4 + 1]), static_cast<float>(pSource[index * 4 + 2]) };
+			}
+
+			if (normal.SqrMagnitude() > 0.0f)
+			{
+				normal.Normalize();
+			}
+
+			pTexel[0] = static_cast<uint8_t>(static_cast<int8_t>(std::lround(normal.x * 127.0f)));
+			pTexel[1] = static_cast<uint8_t>(static_cast<int8_t>(std::lround(normal.y * 127.0f)));
+			pTexel[2] = static_cast<uint8_t>(static_cast<int8_t>(std::lround(normal.z * 127.0f)));
+			pTexel[3] = 0;
+		}
+
+		//Same as the separate maps: bytes get averaged, the normal gets averaged as a vector and renormalized
+		template<>
+		void DownsampleTexel<PackedMaterialCodec>(const Texture::MipLevel& source, int x0, int x1, int y0, int y1, uint8_t* pTexel)
+		{
+			const int box[4]{ x0 + y0 * source.width, x1 + y0 * source.width, x0 + y1 * source.width, x1 + y1 * source.width };
+
+			for (int channel : { 0, 1, 2, 3, 6, 7 })
+			{
+				int sum{ 2 };
+				for (int index : box)
+				{
+					sum += source.pTexels[index * 8 + channel];
+				}
+
+				pTexel[channel] = static_cast<uint8_t>(sum / 4);
+			}
+
+			Vector3 normal{};
+			for (int index : box)
+			{
+				const float x{ static_cast<int8_t>(source.pTexels[index * 8 + 4]) / 127.0f };
+				const float y{ static_cast<int8_t>(source.pTexels[index * 8 + 5]) / 127.0f };
+				normal += Vector3{ x, y, ReconstructNormalZ(x, y) };
+			}
+
+			if (normal.SqrMagnitude() > 0.0f)
+			{
+				normal.Normalize();
+			}
+
+			pTexel[4] = static_cast<uint8_t>(static_cast<int8_t>(std::lround(normal.x * 127.0f)));
+			pTexel[5] = static_cast<uint8_t>(static_cast<int8_t>(std::lround(normal.y * 127.0f)));
+		}
+
+		//Encodes a row-major level into blocks, edge blocks of levels that are not a multiple of 4 repeat the last row/column
+		template<typename Block>
+		void CompressLevel(const Texture::MipLevel& source, uint8_t* pBlocks)
+		{
+			constexpr int bytesPerTexel{ Block::Decoded::BytesPerTexel };
+			const int blocksPerRow{ (source.width + 3) >> 2 };
+			const int blocksPerColumn{ (source.height + 3) >> 2 };
+
+			JobSystem::GetInstance().ParallelFor(blocksPerColumn, 4, [&](int begin, int end)
+				{
+					uint8_t texels[16 * bytesPerTexel]{};
+
+					for (int blockY{ begin }; blockY < end; ++blockY)
+					{
+						for (int blockX{}; blockX < blocksPerRow; ++blockX)
+						{
+							for (int texel{}; texel < 16; ++texel)
+							{
+								const int x{ std::min(blockX * 4 + (texel & 3), source.width - 1) };
+								const int y{ std::min(blockY * 4 + (texel >> 2), source.height - 1) };
+								std::memcpy(texels + texel * bytesPerTexel, source.pTexels + (x + static_cast<size_t>(y) * source.width) * bytesPerTexel, bytesPerTexel);
+							}
+
+							Block::Encode(texels, pBlocks + (blockX + static_cast<size_t>(blockY) * blocksPerRow) * Block::BytesPerBlock);
+						}
+					}
+				});
+		}
+
+		template<typename Codec>
+		void DownsampleLevel(const Texture::MipLevel& source, int width, int height, uint8_t* pTexels)
+		{
+			//Every row of the new level only reads the previous level, so the rows can be built in parallel
+			JobSystem::GetInstance().ParallelFor(height, 16, [&](int begin, int end)
+				{
+					for (int y{ begin }; y < end; ++y)
+					{
+						//Clamp for odd sizes so the last row/column gets reused instead of read out of bounds
+						const int y0{ std::min(y * 2, source.height - 1) };
+						const int y1{ std::min(y * 2 + 1, source.height - 1) };
+
+						for (int x{}; x < width; ++x)
+						{
+							const int x0{ std::min(x * 2, source.width - 1) };
+							const int x1{ std::min(x * 2 + 1, source.width - 1) };
+
+							DownsampleTexel<Codec>(source, x0, x1, y0, y1, pTexels + (x + y * width) * Codec::BytesPerTexel);
+						}
+					}
+				});
+		}
+	}
+
+	Texture::Texture(SDL_Surface* pSurface, TextureFormat format, TextureLayout layout) :
+		m_Format{ GetDecodedFormat(format) },
+		m_Layout{ layout }
+	{
+		//The chain is always built row-major and uncompressed, tiling or compression happens afterwards on the finished levels
+		ConvertSurface(pSurface);
+		GenerateMipChain();
+
+		if (dae::IsBlockCompressed(format))
+		{
+			CompressMipChain(format);
+		}
+		else if (m_Layout == TextureLayout::Tiled4x4)
+		{
+			TileMipChain();
+		}
+	}
+
+	Texture::Texture(TextureFormat format, TextureLayout layout) :
+		m_Format{ format },
+		m_Layout{ layout }
 	{
 	}
 
 	Texture::~Texture()
 	{
-		if (m_pSurface)
+		if (IsBlockCompressed())
 		{
-			SDL_FreeSurface(m_pSurface);
-			m_pSurface = nullptr;
+			++g_BlockCacheGeneration;
 		}
 
-		m_pResource->Release();
-		m_pResourceView->Release();
+		//Textures that were never uploaded (benchmarks, tools) have no D3D resources
+		if (m_pResource)
+		{
+			m_pResource->Release();
+		}
+
+		if (m_pResourceView)
+		{
+			m_pResourceView->Release();
+		}
 	}
 
-	Texture* Texture::LoadFromFile(const std::string& path)
+	Texture* Texture::LoadFromFile(const std::string& path, TextureFormat format, TextureLayout layout)
 	{
 		//TODO
 		//Load SDL_Surface using IMG_LOAD
 		//Create & Return a new Texture Object (using SDL_Surface)
 
 		SDL_Surface* pSurface{ IMG_Load(path.c_str()) };
-		return new Texture(pSurface);
+
+		//Fix the channel order first, ABGR8888 is R, G, B, A in memory
+		if (pSurface && pSurface->format->format != SDL_PIXELFORMAT_ABGR8888)
+		{
+			SDL_Surface* pConverted{ SDL_ConvertSurfaceFormat(pSurface, SDL_PIXELFORMAT_ABGR8888, 0) };
+			SDL_FreeSurface(pSurface);
+			pSurface = pConverted;
+		}
+
+		//The texture keeps its own converted copy, the surface is not needed after this
+		Texture* pTexture{ new Texture(pSurface, format, layout) };
+		SDL_FreeSurface(pSurface);
+
+		return pTexture;
+	}
+
+	Texture* Texture::PackMaterial(const Texture* pDiffuse, const Texture* pNormal, const Texture* pGloss, const Texture* pSpecular, TextureLayout layout)
+	{
+		Texture* pTexture{ new Texture(TextureFormat::PackedMaterial, layout) };
+		pTexture->PackMaps(pDiffuse, pNormal, pGloss, pSpecular);
+		pTexture->GenerateMipChain();
+
+		if (layout == TextureLayout::Tiled4x4)
+		{
+			pTexture->TileMipChain();
+		}
+
+		return pTexture;
 	}
 
 	ColorRGB Texture::Sample(const Vector2& uv) const
@@ -38,23 +859,271 @@ namespace dae
 		//TODO
 		//Sample the correct texel for the given uv
 
-		Uint8 r, g, b;
+		const SamplerState pointSampler{ TextureFilter::Point, TextureAddressMode::Wrap };
+		return Sample(uv, pointSampler, -FLT_MAX);
+	}
+
+	ColorRGB Texture::Sample(const Vector2& uv, const SamplerState& sampler, float uvLod) const
+	{
+		//uvLod is log2 of the uv distance covered by one pixel, the texture size turns it into a mip level
+		const float lod{ Clamp(uvLod + m_LodOffset, 0.0f, static_cast<float>(GetMipCount() - 1)) };
+
+		__m128 colour{};
+
+		DispatchFormat(m_Format, m_Layout, [&]<typename Codec, typename Layout>()
+			{
+				colour = _mm_mul_ps(SampleFiltered<Codec, Layout>(m_MipLevels, uv, sampler, lod), _mm_set1_ps(Codec::Scale));
+			});
+
+		alignas(16) float channels[4]{};
+		_mm_store_ps(channels, colour);
+
+		return { channels[0], channels[1], channels[2] };
+	}
+
+	Vector3 Texture::SampleNormal(const Vector2& uv, const SamplerState& sampler, float uvLod) const
+	{
+		const float lod{ Clamp(uvLod + m_LodOffset, 0.0f, static_cast<float>(GetMipCount() - 1)) };
+
+		__m128 normal{};
+		if (m_Format == TextureFormat::BC5)
+		{
+			normal = SampleFiltered<BC5Codec, Tiled4x4Layout>(m_MipLevels, uv, sampler, lod);
+		}
+		else
+		{
+			normal = m_Layout == TextureLayout::Tiled4x4 ?
+				SampleFiltered<NormalSNorm8Codec, Tiled4x4Layout>(m_MipLevels, uv, sampler, lod) :
+				SampleFiltered<NormalSNorm8Codec, LinearLayout>(m_MipLevels, uv, sampler, lod);
+		}
+
+		alignas(16) float channels[4]{};
+		_mm_store_ps(channels, _mm_mul_ps(normal, _mm_set1_ps(NormalSNorm8Codec::Scale)));
+
+		return { channels[0], channels[1], channels[2] };
+	}
+
+	float Texture::SampleScalar(const Vector2& uv, const SamplerState& sampler, float uvLod) const
+	{
+		const float lod{ Clamp(uvLod + m_LodOffset, 0.0f, static_cast<float>(GetMipCount() - 1)) };
+
+		__m128 value{};
+		if (m_Format == TextureFormat::BC4)
+		{
+			value = SampleFiltered<BC4Codec, Tiled4x4Layout>(m_MipLevels, uv, sampler, lod);
+		}
+		else
+		{
+			value = m_Layout == TextureLayout::Tiled4x4 ?
+				SampleFiltered<R8Codec, Tiled4x4Layout>(m_MipLevels, uv, sampler, lod) :
+				SampleFiltered<R8Codec, LinearLayout>(m_MipLevels, uv, sampler, lod);
+		}
+
+		return _mm_cvtss_f32(value) * R8Codec::Scale;
+	}
+
+	MaterialSample Texture::SampleMaterial(const Vector2& uv, const SamplerState& sampler, float uvLod) const
+	{
+		const float lod{ Clamp(uvLod + m_LodOffset, 0.0f, static_cast<float>(GetMipCount() - 1)) };
+		const bool isTiled{ m_Layout == TextureLayout::Tiled4x4 };
+
+		//One filtered fetch of the whole 8 byte texels, every map shares the addressing and the weights
+		const __m256 texel{ isTiled ?
+			SampleFiltered<PackedTexelCodec, Tiled4x4Layout>(m_MipLevels, uv, sampler, lod) :
+			SampleFiltered<PackedTexelCodec, LinearLayout>(m_MipLevels, uv, sampler, lod) };
+
+		alignas(32) float channels[8]{};
+		_mm256_store_ps(channels, _mm256_mul_ps(texel, _mm256_setr_ps(1 / 255.f, 1 / 255.f, 1 / 255.f, 1 / 255.f, 1 / 127.f, 1 / 127.f, 1 / 255.f, 1 / 255.f)));
+
+		MaterialSample material{};
+		material.diffuse = ColorRGB{ channels[0], channels[1], channels[2] };
+		material.normal = Vector3{ channels[4], channels[5], ReconstructNormalZ(channels[4], channels[5]) };
+		material.gloss = channels[6];
+		material.specular = channels[7];
+
+		//Filtering shortens the normal, and clamped z can leave it slightly off unit length
+		material.normal.Normalize();
+
+		return material;
+	}
+
+	void Texture::SampleBatch(const float* pU, const float* pV, const float* pUvLod, int count, const SamplerState& sampler,
+		float* pR, float* pG, float* pB) const
+	{
+		const __m128 lodOffset{ _mm_set1_ps(m_LodOffset) };
+		const __m128 maxLod{ _mm_set1_ps(static_cast<float>(GetMipCount() - 1)) };
+
+		for (int i{}; i < count; i += 4)
+		{
+			const __m128 u{ AddressCoordinate4(_mm_loadu_ps(pU + i), sampler.addressMode) };
+			const __m128 v{ AddressCoordinate4(_mm_loadu_ps(pV + i), sampler.addressMode) };
+			const __m128 lod{ _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_loadu_ps(pUvLod + i), lodOffset), _mm_setzero_ps()), maxLod) };
+
+			__m128 channels[4]{};
+
+			DispatchFormat(m_Format, m_Layout, [&]<typename Codec, typename Layout>()
+				{
+					SampleBatch4<Codec, Layout>(m_MipLevels, u, v, lod, sampler, channels);
+				});
+
+			_mm_storeu_ps(pR + i, channels[0]);
+			_mm_storeu_ps(pG + i, channels[1]);
+			_mm_storeu_ps(pB + i, channels[2]);
+		}
+	}
+
+	void Texture::SampleMaterialBatch(const float* pU, const float* pV, const float* pUvLod, int count, const SamplerState& sampler,
+		const MaterialSampleBatch& samples) const
+	{
+		const __m128 lodOffset{ _mm_set1_ps(m_LodOffset) };
+		const __m128 maxLod{ _mm_set1_ps(static_cast<float>(GetMipCount() - 1)) };
+		const bool isTiled{ m_Layout == TextureLayout::Tiled4x4 };
+
+		for (int i{}; i < count; i += 4)
+		{
+			const __m128 u{ AddressCoordinate4(_mm_loadu_ps(pU + i), sampler.addressMode) };
+			const __m128 v{ AddressCoordinate4(_mm_loadu_ps(pV + i), sampler.addressMode) };
+			const __m128 lod{ _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_loadu_ps(pUvLod + i), lodOffset), _mm_setzero_ps()), maxLod) };
+
+			//Diffuse R, G, B, A, normal x, y, gloss, specular of the 4 lanes, from one filtered fetch per lane
+			__m128 channels[8]{};
+			isTiled ?
+				SampleBatch4<PackedTexelCodec, Tiled4x4Layout>(m_MipLevels, u, v, lod, sampler, channels) :
+				SampleBatch4<PackedTexelCodec, LinearLayout>(m_MipLevels, u, v, lod, sampler, channels);
+
+			const __m128 snormScale{ _mm_set1_ps(1 / 127.f) };
+			const __m128 unormScale{ _mm_set1_ps(1 / 255.f) };
+			__m128 normalX{ _mm_mul_ps(channels[4], snormScale) };
+			__m128 normalY{ _mm_mul_ps(channels[5], snormScale) };
+
+			//Same as SampleMaterial: rebuild z, then normalize what filtering shortened
+			const __m128 one{ _mm_set1_ps(1.0f) };
+			__m128 normalZ{ _mm_sqrt_ps(_mm_max_ps(_mm_setzero_ps(), _mm_sub_ps(_mm_sub_ps(one, _mm_mul_ps(normalX, normalX)), _mm_mul_ps(normalY, normalY)))) };
+			const __m128 length{ _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(normalX, normalX), _mm_mul_ps(normalY, normalY)), _mm_mul_ps(normalZ, normalZ))) };
+			normalX = _mm_div_ps(normalX, length);
+			normalY = _mm_div_ps(normalY, length);
+			normalZ = _mm_div_ps(normalZ, length);
+
+			_mm_storeu_ps(samples.pDiffuseR + i, _mm_mul_ps(channels[0], unormScale));
+			_mm_storeu_ps(samples.pDiffuseG + i, _mm_mul_ps(channels[1], unormScale));
+			_mm_storeu_ps(samples.pDiffuseB + i, _mm_mul_ps(channels[2], unormScale));
+			_mm_storeu_ps(samples.pNormalX + i, normalX);
+			_mm_storeu_ps(samples.pNormalY + i, normalY);
+			_mm_storeu_ps(samples.pNormalZ + i, normalZ);
+			_mm_storeu_ps(samples.pGloss + i, _mm_mul_ps(channels[6], unormScale));
+			_mm_storeu_ps(samples.pSpecular + i, _mm_mul_ps(channels[7], unormScale));
+		}
+	}
+
+	TextureFormat Texture::GetFormat() const
+	{
+		return m_Format;
+	}
+
+	TextureLayout Texture::GetLayout() const
+	{
+		return m_Layout;
+	}
+
+	int Texture::GetBytesPerTexel() const
+	{
+		return dae::GetBytesPerTexel(m_Format);
+	}
+
+	int Texture::GetBytesPerBlock() const
+	{
+		return dae::GetBytesPerBlock(m_Format);
+	}
+
+	bool Texture::IsBlockCompressed() const
+	{
+		return dae::IsBlockCompressed(m_Format);
+	}
+
+	size_t Texture::GetMemorySize() const
+	{
+		size_t size{};
+		for (const std::vector<uint8_t>& texels : m_MipStorage)
+		{
+			size += texels.size();
+		}
+
+		return size;
+	}
+
+	void Texture::ReleaseTexels()
+	{
+		if (IsBlockCompressed())
+		{
+			++g_BlockCacheGeneration;
+		}
+
+		m_MipLevels = {};
+		m_MipStorage = {};
+	}
 
-		const size_t x{ static_cast<size_t>(uv.x * m_pSurface->w) };
-		const size_t y{ static_cast<size_t>(uv.y * m_pSurface->h) };
+	int Texture::GetMipCount() const
+	{
+		return static_cast<int>(m_MipLevels.size());
+	}
 
-		const Uint32 pixel{ m_pSurfacePixels[x + y * m_pSurface->w] };
+	const Texture::MipLevel& Texture::GetMipLevel(int level) const
+	{
+		return m_MipLevels[level];
+	}
 
-		SDL_GetRGB(pixel, m_pSurface->format, &r, &g, &b);
+	size_t Texture::GetTexelOffset(int level, int x, int y) const
+	{
+		const int width{ m_MipLevels[level].width };
+		const int index{ m_Layout == TextureLayout::Tiled4x4 ? Tiled4x4Layout::Index(x, y, width) : LinearLayout::Index(x, y, width) };
 
-		const constexpr float invClampVal{ 1 / 255.f };
+		if (IsBlockCompressed())
+		{
+			return static_cast<size_t>(index >> 4) * GetBytesPerBlock();
+		}
 
-		return { r * invClampVal,g * invClampVal,b * invClampVal };
+		return static_cast<size_t>(index) * GetBytesPerTexel();
 	}
 
-	SDL_Surface* Texture::GetSurface() const
+	std::vector<uint8_t> Texture::CopyLevelLinear(int level) const
 	{
-		return m_pSurface;
+		const MipLevel& mipLevel{ m_MipLevels[level] };
+		const size_t bytesPerTexel{ static_cast<size_t>(dae::GetBytesPerTexel(GetDecodedFormat(m_Format))) };
+
+		std::vector<uint8_t> texels(static_cast<size_t>(mipLevel.width) * mipLevel.height * bytesPerTexel);
+
+		if (IsBlockCompressed())
+		{
+			DispatchBlockFormat(m_Format, [&]<typename Block>()
+				{
+					const int blocksPerRow{ (mipLevel.width + 3) >> 2 };
+					uint8_t decoded[16 * Block::Decoded::BytesPerTexel]{};
+
+					for (int y{}; y < mipLevel.height; ++y)
+					{
+						for (int x{}; x < mipLevel.width; ++x)
+						{
+							//Decodes every block 16 times, this is only meant for uploads and tools
+							Block::Decode(mipLevel.pTexels + ((y >> 2) * blocksPerRow + (x >> 2)) * Block::BytesPerBlock, decoded);
+							std::memcpy(texels.data() + (x + static_cast<size_t>(y) * mipLevel.width) * bytesPerTexel,
+								decoded + ((y & 3) * 4 + (x & 3)) * bytesPerTexel, bytesPerTexel);
+						}
+					}
+				});
+
+			return texels;
+		}
+
+		for (int y{}; y < mipLevel.height; ++y)
+		{
+			for (int x{}; x < mipLevel.width; ++x)
+			{
+				std::memcpy(texels.data() + (x + static_cast<size_t>(y) * mipLevel.width) * bytesPerTexel,
+					mipLevel.pTexels + GetTexelOffset(level, x, y), bytesPerTexel);
+			}
+		}
+
+		return texels;
 	}
 
 	ID3D11ShaderResourceView* Texture::GetSRV() const
@@ -76,4 +1145,189 @@ namespace dae
 	{
 		m_pResourceView = pResourceView;
 	}
-}
\ No newline at end of file
+
+	void Texture::ConvertSurface(SDL_Surface* pSurface)
+	{
+		const int width{ pSurface->w };
+		const int height{ pSurface->h };
+		const int bytesPerTexel{ GetBytesPerTexel() };
+
+		std::vector<uint8_t>& texels{ m_MipStorage.emplace_back(static_cast<size_t>(width) * height * bytesPerTexel) };
+
+		JobSystem::GetInstance().ParallelFor(height, 64, [&](int begin, int end)
+			{
+				for (int y{ begin }; y < end; ++y)
+				{
+					const uint8_t* pSourceRow{ static_cast<const uint8_t*>(pSurface->pixels) + y * pSurface->pitch };
+					uint8_t* pRow{ texels.data() + static_cast<size_t>(y) * width * bytesPerTexel };
+
+					switch (m_Format)
+					{
+					case dae::TextureFormat::RGBA8:
+						std::memcpy(pRow, pSourceRow, static_cast<size_t>(width) * 4);
+						break;
+					case dae::TextureFormat::NormalSNorm8:
+						//[0, 255] -> [-1, 1] -> [-127, 127], the sampler no longer has to do the 2 * c - 1
+						for (int x{}; x < width * 4; x += 4)
+						{
+							for (int channel{}; channel < 3; ++channel)
+							{
+								const float value{ pSourceRow[x + channel] / 255.0f * 2.0f - 1.0f };
+								pRow[x + channel] = static_cast<uint8_t>(static_cast<int8_t>(std::lround(value * 127.0f)));
+							}
+
+							pRow[x + 3] = 0;
+						}
+						break;
+					case dae::TextureFormat::R8:
+						for (int x{}; x < width; ++x)
+						{
+							pRow[x] = pSourceRow[x * 4];
+						}
+						break;
+					default:
+						break;
+					}
+				}
+			});
+
+		m_MipLevels.push_back(MipLevel{ width, height, texels.data() });
+		m_LodOffset = std::log2f(static_cast<float>(std::max(width, height)));
+	}
+
+	void Texture::PackMaps(const Texture* pDiffuse, const Texture* pNormal, const Texture* pGloss, const Texture* pSpecular)
+	{
+		const int width{ pDiffuse->GetMipLevel(0).width };
+		const int height{ pDiffuse->GetMipLevel(0).height };
+
+		for (const Texture* pMap : { pNormal, pGloss, pSpecular })
+		{
+			if (pMap->GetMipLevel(0).width != width || pMap->GetMipLevel(0).height != height)
+			{
+				throw std::runtime_error("Material maps must all have the same size to be packed");
+			}
+		}
+
+		if (GetDecodedFormat(pDiffuse->GetFormat()) != TextureFormat::RGBA8 || GetDecodedFormat(pNormal->GetFormat()) != TextureFormat::NormalSNorm8 ||
+			GetDecodedFormat(pGloss->GetFormat()) != TextureFormat::R8 || GetDecodedFormat(pSpecular->GetFormat()) != TextureFormat::R8)
+		{
+			throw std::runtime_error("Material maps must be loaded as colour, normal, scalar and scalar maps to be packed");
+		}
+
+		//The inputs can be tiled or compressed, read them back in row-major order like the rest of the chain expects
+		const std::vector<uint8_t> diffuseTexels{ pDiffuse->CopyLevelLinear(0) };
+		const std::vector<uint8_t> normalTexels{ pNormal->CopyLevelLinear(0) };
+		const std::vector<uint8_t> glossTexels{ pGloss->CopyLevelLinear(0) };
+		const std::vector<uint8_t> specularTexels{ pSpecular->CopyLevelLinear(0) };
+
+		std::vector<uint8_t>& texels{ m_MipStorage.emplace_back(static_cast<size_t>(width) * height * PackedMaterialCodec::BytesPerTexel) };
+
+		JobSystem::GetInstance().ParallelFor(height, 64, [&](int begin, int end)
+			{
+				for (int index{ begin * width }; index < end * width; ++index)
+				{
+					uint8_t* pTexel{ texels.data() + static_cast<size_t>(index) * PackedMaterialCodec::BytesPerTexel };
+					std::memcpy(pTexel, diffuseTexels.data() + static_cast<size_t>(index) * 4, 4);
+
+					//Only x and y of the unit normal are kept, z is rebuilt on sampling (tangent space normals face +z)
+					const int8_t* pNormal{ reinterpret_cast<const int8_t*>(normalTexels.data()) + static_cast<size_t>(index) * 4 };
+					Vector3 normal{ static_cast<float>(pNormal[0]), static_cast<float>(pNormal[1]), static_cast<float>(pNormal[2]) };
+
+					if (normal.SqrMagnitude() > 0.0f)
+					{
+						normal.Normalize();
+					}
+
+					pTexel[4] = static_cast<uint8_t>(static_cast<int8_t>(std::lround(normal.x * 127.0f)));
+					pTexel[5] = static_cast<uint8_t>(static_cast<int8_t>(std::lround(normal.y * 127.0f)));
+					pTexel[6] = glossTexels[index];
+					pTexel[7] = specularTexels[index];
+				}
+			});
+
+		m_MipLevels.push_back(MipLevel{ width, height, texels.data() });
+		m_LodOffset = std::log2f(static_cast<float>(std::max(width, height)));
+	}
+
+	void Texture::GenerateMipChain()
+	{
+		const int bytesPerTexel{ GetBytesPerTexel() };
+
+		while (m_MipLevels.back().width > 1 || m_MipLevels.back().height > 1)
+		{
+			const MipLevel source{ m_MipLevels.back() };
+			const int width{ std::max(source.width / 2, 1) };
+			const int height{ std::max(source.height / 2, 1) };
+
+			std::vector<uint8_t>& texels{ m_MipStorage.emplace_back(static_cast<size_t>(width) * height * bytesPerTexel) };
+
+			switch (m_Format)
+			{
+			case dae::TextureFormat::RGBA8:
+				DownsampleLevel<RGBA8Codec>(source, width, height, texels.data());
+				break;
+			case dae::TextureFormat::NormalSNorm8:
+				DownsampleLevel<NormalSNorm8Codec>(source, width, height, texels.data());
+				break;
+			case dae::TextureFormat::R8:
+				DownsampleLevel<R8Codec>(source, width, height, texels.data());
+				break;
+			case dae::TextureFormat::PackedMaterial:
+				DownsampleLevel<PackedMaterialCodec>(source, width, height, texels.data());
+				break;
+			default:
+				break;
+			}
+
+			m_MipLevels.push_back(MipLevel{ width, height, texels.data() });
+		}
+	}
+
+	void Texture::TileMipChain()
+	{
+		const size_t bytesPerTexel{ static_cast<size_t>(GetBytesPerTexel()) };
+
+		for (size_t level{}; level < m_MipLevels.size(); ++level)
+		{
+			MipLevel& mipLevel{ m_MipLevels[level] };
+			const std::vector<uint8_t>& linearTexels{ m_MipStorage[level] };
+			std::vector<uint8_t> tiledTexels(GetLevelTexelCount(mipLevel.width, mipLevel.height, m_Layout) * bytesPerTexel);
+
+			JobSystem::GetInstance().ParallelFor(mipLevel.height, 64, [&](int begin, int end)
+				{
+					for (int y{ begin }; y < end; ++y)
+					{
+						for (int x{}; x < mipLevel.width; ++x)
+						{
+							std::memcpy(tiledTexels.data() + Tiled4x4Layout::Index(x, y, mipLevel.width) * bytesPerTexel,
+								linearTexels.data() + (x + static_cast<size_t>(y) * mipLevel.width) * bytesPerTexel, bytesPerTexel);
+						}
+					}
+				});
+
+			m_MipStorage[level] = std::move(tiledTexels);
+			mipLevel.pTexels = m_MipStorage[level].data();
+		}
+	}
+	void Texture::CompressMipChain(TextureFormat format)
+	{
+		for (size_t level{}; level < m_MipLevels.size(); ++level)
+		{
+			MipLevel& mipLevel{ m_MipLevels[level] };
+			const size_t blockCount{ static_cast<size_t>((mipLevel.width + 3) >> 2) * ((mipLevel.height + 3) >> 2) };
+			std::vector<uint8_t> blocks(blockCount * dae::GetBytesPerBlock(format));
+
+			DispatchBlockFormat(format, [&]<typename Block>()
+				{
+					CompressLevel<Block>(mipLevel, blocks.data());
+				});
+
+			m_MipStorage[level] = std::move(blocks);
+			mipLevel.pTexels = m_MipStorage[level].data();
+		}
+
+		//Blocks are stored in the same order as Tiled4x4 tiles, so the sampler addresses them through that layout
+		m_Format = format;
+		m_Layout = TextureLayout::Tiled4x4;
+	}
+}
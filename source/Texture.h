@@ -1,7 +1,10 @@
 #pragma once
-#include <SDL_surface.h>
 #include <string>
+#include <vector>
 #include "ColorRGB.h"
+#include "DataTypes.h"
+
+struct SDL_Surface;
 
 namespace dae
 {
@@ -10,11 +13,57 @@ namespace dae
 	class Texture
 	{
 	public:
+		struct MipLevel
+		{
+			int width{};
+			int height{};
+			const uint8_t* pTexels{};
+		};
+
 		~Texture();
 
-		static Texture* LoadFromFile(const std::string& path);
+		//Block compressed formats are encoded on load and ignore layout, their blocks are always stored tiled
+		static Texture* LoadFromFile(const std::string& path, TextureFormat format = TextureFormat::RGBA8, TextureLayout layout = TextureLayout::Linear);
+		//Interleaves four loaded maps of the same size into one PackedMaterial texture, the inputs are left untouched
+		static Texture* PackMaterial(const Texture* pDiffuse, const Texture* pNormal, const Texture* pGloss, const Texture* pSpecular,
+			TextureLayout layout = TextureLayout::Linear);
+
 		ColorRGB Sample(const Vector2& uv) const;
-		SDL_Surface* GetSurface() const;
+		ColorRGB Sample(const Vector2& uv, const SamplerState& sampler, float uvLod) const;
+
+		//Typed fetches for the shading code, these only handle the formats their maps load as
+		//(NormalSNorm8 or BC5 for SampleNormal, R8 or BC4 for SampleScalar)
+		Vector3 SampleNormal(const Vector2& uv, const SamplerState& sampler, float uvLod) const;
+		float SampleScalar(const Vector2& uv, const SamplerState& sampler, float uvLod) const;
+		//Every map of a PackedMaterial texture from the same texels, the normal comes back normalized
+		MaterialSample SampleMaterial(const Vector2& uv, const SamplerState& sampler, float uvLod) const;
+
+		//Samples count (a multiple of 4) uvs at once, inputs and outputs are SoA arrays of count floats
+		void SampleBatch(const float* pU, const float* pV, const float* pUvLod, int count, const SamplerState& sampler,
+			float* pR, float* pG, float* pB) const;
+		//SampleMaterial for count (a multiple of 4) uvs of a PackedMaterial texture
+		void SampleMaterialBatch(const float* pU, const float* pV, const float* pUvLod, int count, const SamplerState& sampler,
+			const MaterialSampleBatch& samples) const;
+
+		TextureFormat GetFormat() const;
+		TextureLayout GetLayout() const;
+		//0 for block compressed formats, those have GetBytesPerBlock instead
+		int GetBytesPerTexel() const;
+		int GetBytesPerBlock() const;
+		bool IsBlockCompressed() const;
+		//Bytes of texel data held on the cpu, every mip level included
+		size_t GetMemorySize() const;
+		int GetMipCount() const;
+		const MipLevel& GetMipLevel(int level) const;
+
+		//Byte offset of texel (x, y) inside its level (of its block when compressed), for tools that need to know where a fetch lands
+		size_t GetTexelOffset(int level, int x, int y) const;
+		//Row-major copy of a level, for consumers that cannot read the tiled layout (D3D11 uploads)
+		//Block compressed levels get decoded, to RGBA8, NormalSNorm8 or R8
+		std::vector<uint8_t> CopyLevelLinear(int level) const;
+		//Frees the texels on the cpu, for a texture that only its gpu copy is read from anymore
+		//It cannot be sampled or uploaded again afterwards
+		void ReleaseTexels();
 
 		ID3D11ShaderResourceView* GetSRV() const;
 		ID3D11Texture2D* GetResource() const;
@@ -22,12 +71,25 @@ namespace dae
 		void SetResourceView(ID3D11ShaderResourceView* pResourceView);
 
 	private:
-		Texture(SDL_Surface* pSurface);
+		Texture(SDL_Surface* pSurface, TextureFormat format, TextureLayout layout);
+		Texture(TextureFormat format, TextureLayout layout);
+
+		void ConvertSurface(SDL_Surface* pSurface);
+		void PackMaps(const Texture* pDiffuse, const Texture* pNormal, const Texture* pGloss, const Texture* pSpecular);
+		void GenerateMipChain();
+		void TileMipChain();
+		void CompressMipChain(TextureFormat format);
+
+		TextureFormat m_Format{};
+		TextureLayout m_Layout{};
+
+		std::vector<MipLevel> m_MipLevels{};
+		std::vector<std::vector<uint8_t>> m_MipStorage{};
 
-		SDL_Surface* m_pSurface{ nullptr };
-		uint32_t* m_pSurfacePixels{ nullptr };
+		//log2 of the texture size, turns a uv-space lod into a texel-space lod
+		float m_LodOffset{};
 
 		ID3D11Texture2D* m_pResource{};
 		ID3D11ShaderResourceView* m_pResourceView{};
 	};
-}
\ No newline at end of file
+}
@@ -0,0 +1,183 @@
+#include "pch.h"
+#include "TextureBenchmark.h"
+#include "Texture.h"
+#include <chrono>
+#include <iomanip>
+
+namespace dae
+{
+	namespace
+	{
+		//Set associative LRU cache, sized like a typical L1 data cache (32 KiB, 8 ways, 64 byte lines)
+		class CacheSimulator final
+		{
+		public:
+			void Access(uintptr_t address)
+			{
+				const uintptr_t line{ address / LineSize };
+				uintptr_t* pWays{ &m_Tags[(line % SetCount) * WayCount] };
+
+				++m_AccessCount;
+
+				//Ways are kept in most recently used order, a hit moves the line to the front
+				int way{};
+				while (way < WayCount && pWays[way] != line + 1)
+				{
+					++way;
+				}
+
+				if (way == WayCount)
+				{
+					++m_MissCount;
+					way = WayCount - 1;
+				}
+
+				for (; way > 0; --way)
+				{
+					pWays[way] = pWays[way - 1];
+				}
+				pWays[0] = line + 1;
+			}
+
+			int GetAccessCount() const { return m_AccessCount; }
+			int GetMissCount() const { return m_MissCount; }
+
+		private:
+			static constexpr int LineSize{ 64 };
+			static constexpr int WayCount{ 8 };
+			static constexpr int SetCount{ 32 * 1024 / (LineSize * WayCount) };
+
+			//Tags are stored as line + 1, so 0 marks an empty way
+			uintptr_t m_Tags[SetCount * WayCount]{};
+			int m_AccessCount{};
+			int m_MissCount{};
+		};
+
+		struct Footprint
+		{
+			const char* name{};
+			float angle{};
+			//Texels per pixel along the screen x and y axis
+			float scaleX{};
+			float scaleY{};
+		};
+
+		struct Result
+		{
+			float missRate{};
+			float milliseconds{};
+		};
+
+		constexpr int ScreenSize{ 256 };
+
+		//Walks a screen square in scanline order, like the rasterizer does, and maps every pixel into uv space
+		void BuildFootprint(const Footprint& footprint, const Texture& texture, std::vector<float>& u, std::vector<float>& v, float& uvLod)
+		{
+			const Texture::MipLevel& topLevel{ texture.GetMipLevel(0) };
+			const float cosAngle{ std::cos(footprint.angle * TO_RADIANS) };
+			const float sinAngle{ std::sin(footprint.angle * TO_RADIANS) };
+
+			for (int py{}; py < ScreenSize; ++py)
+			{
+				for (int px{}; px < ScreenSize; ++px)
+				{
+					const float x{ (px - ScreenSize * 0.5f) * footprint.scaleX };
+					const float y{ (py - ScreenSize * 0.5f) * footprint.scaleY };
+
+					u[px + py * ScreenSize] = 0.5f + (x * cosAngle - y * sinAngle) / topLevel.width;
+					v[px + py * ScreenSize] = 0.5f + (x * sinAngle + y * cosAngle) / topLevel.height;
+				}
+			}
+
+			//Same estimate as the rasterizer, the uv area covered by one pixel
+			const float uvArea{ footprint.scaleX * footprint.scaleY / (static_cast<float>(topLevel.width) * topLevel.height) };
+			uvLod = 0.5f * std::log2(uvArea);
+		}
+
+		Result Measure(const Texture& texture, const std::vector<float>& u, const std::vector<float>& v, float uvLod)
+		{
+			const SamplerState sampler{ TextureFilter::Bilinear, TextureAddressMode::Wrap };
+			const int sampleCount{ static_cast<int>(u.size()) };
+
+			//Replay the bilinear footprints of every sample through the cache
+			const float lodOffset{ std::log2(static_cast<float>(std::max(texture.GetMipLevel(0).width, texture.GetMipLevel(0).height))) };
+			const int level{ static_cast<int>(Clamp(uvLod + lodOffset, 0.0f, static_cast<float>(texture.GetMipCount() - 1)) + 0.5f) };
+			const Texture::MipLevel& mipLevel{ texture.GetMipLevel(level) };
+			const uintptr_t base{ reinterpret_cast<uintptr_t>(mipLevel.pTexels) };
+
+			CacheSimulator cache{};
+			for (int i{}; i < sampleCount; ++i)
+			{
+				const float x{ (u[i] - std::floor(u[i])) * mipLevel.width - 0.5f };
+				const float y{ (v[i] - std::floor(v[i])) * mipLevel.height - 0.5f };
+				const int x0{ static_cast<int>(std::floor(x)) };
+				const int y0{ static_cast<int>(std::floor(y)) };
+
+				for (int corner{}; corner < 4; ++corner)
+				{
+					const int texelX{ (x0 + (corner & 1) + mipLevel.width) % mipLevel.width };
+					const int texelY{ (y0 + (corner >> 1) + mipLevel.height) % mipLevel.height };
+					cache.Access(base + texture.GetTexelOffset(level, texelX, texelY));
+				}
+			}
+
+			//Best of a few runs, the first one also warms up the job system and the real caches
+			const std::vector<float> lod(sampleCount, uvLod);
+			std::vector<float> r(sampleCount), g(sampleCount), b(sampleCount);
+			float bestMilliseconds{ FLT_MAX };
+
+			for (int run{}; run < 5; ++run)
+			{
+				const auto start{ std::chrono::high_resolution_clock::now() };
+				texture.SampleBatch(u.data(), v.data(), lod.data(), sampleCount, sampler, r.data(), g.data(), b.data());
+				const auto end{ std::chrono::high_resolution_clock::now() };
+
+				bestMilliseconds = std::min(bestMilliseconds, std::chrono::duration<float, std::milli>(end - start).count());
+			}
+
+			return Result{ static_cast<float>(cache.GetMissCount()) / cache.GetAccessCount(), bestMilliseconds };
+		}
+	}
+
+	void TextureBenchmark::Run(const std::string& path)
+	{
+		const std::unique_ptr<Texture> pLinear{ Texture::LoadFromFile(path, TextureFormat::RGBA8, TextureLayout::Linear) };
+		const std::unique_ptr<Texture> pTiled{ Texture::LoadFromFile(path, TextureFormat::RGBA8, TextureLayout::Tiled4x4) };
+
+		const Footprint footprints[]
+		{
+			{ "Upright", 0.f, 1.f, 1.f },
+			{ "Rotated 30", 30.f, 1.f, 1.f },
+			{ "Rotated 90", 90.f, 1.f, 1.f },
+			{ "Foreshortened", 0.f, 1.f, 3.f },
+			{ "Rotated 60 + Foreshortened", 60.f, 1.f, 3.f },
+			{ "Magnified, Rotated 45", 45.f, 0.5f, 0.5f },
+		};
+
+		std::cout << "\033[36m";
+		std::cout << "[Texture Layout Benchmark] " << path << " (" << pLinear->GetMipLevel(0).width << 'x' << pLinear->GetMipLevel(0).height << ")\n";
+		std::cout << "\tSimulated 32 KiB 8-way L1, bilinear footprints, " << ScreenSize << 'x' << ScreenSize << " pixels in scanline order\n\n";
+		std::cout << std::left << std::setw(30) << "\tFootprint" << std::setw(26) << "Linear (miss / ms)" << std::setw(26) << "Tiled4x4 (miss / ms)" << '\n';
+		std::cout << std::fixed << std::setprecision(2);
+
+		std::vector<float> u(ScreenSize * ScreenSize), v(ScreenSize * ScreenSize);
+
+		for (const Footprint& footprint : footprints)
+		{
+			float uvLod{};
+			BuildFootprint(footprint, *pLinear, u, v, uvLod);
+
+			const Result linear{ Measure(*pLinear, u, v, uvLod) };
+			const Result tiled{ Measure(*pTiled, u, v, uvLod) };
+
+			std::ostringstream linearText{}, tiledText{};
+			linearText << std::fixed << std::setprecision(2) << linear.missRate * 100.f << "% / " << linear.milliseconds;
+			tiledText << std::fixed << std::setprecision(2) << tiled.missRate * 100.f << "% / " << tiled.milliseconds;
+
+			std::cout << '\t' << std::setw(29) << footprint.name << std::setw(26) << linearText.str() << std::setw(26) << tiledText.str() << '\n';
+		}
+
+		std::cout << "\033[0m";
+		std::cout << '\n';
+	}
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include <string>
+
+namespace dae
+{
+	namespace TextureBenchmark
+	{
+		//Compares the linear and tiled texture layouts on rotated and foreshortened footprints
+		//Prints simulated L1 misses and measured sampling time per footprint, run with --benchmark-textures
+		void Run(const std::string& path);
+	}
+}
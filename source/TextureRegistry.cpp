@@ -0,0 +1,91 @@
+#include "pch.h"
+#include "TextureRegistry.h"
+#include "Texture.h"
+
+namespace dae
+{
+	std::shared_ptr<Texture> TextureRegistry::Load(const std::string& path, TextureFormat format, TextureLayout layout)
+	{
+		//Block compressed textures are always stored in 4x4 tiles, whatever layout was asked for
+		const bool isBlockCompressed{ format == TextureFormat::BC1 || format == TextureFormat::BC3 || format == TextureFormat::BC4 || format == TextureFormat::BC5 };
+		const Key key{ path, format, isBlockCompressed ? TextureLayout::Tiled4x4 : layout };
+
+		return FindOrCreate(key, [&]()
+			{
+				return Texture::LoadFromFile(path, format, layout);
+			});
+	}
+
+	std::shared_ptr<Texture> TextureRegistry::LoadPackedMaterial(const std::string& diffusePath, const std::string& normalPath,
+		const std::string& glossPath, const std::string& specularPath, TextureLayout layout)
+	{
+		const Key key{ diffusePath + '|' + normalPath + '|' + glossPath + '|' + specularPath, TextureFormat::PackedMaterial, layout };
+
+		//The source maps are only needed while packing, they stay loaded if someone else holds them too
+		const std::shared_ptr<Texture> pDiffuse{ Load(diffusePath, TextureFormat::RGBA8, layout) };
+		const std::shared_ptr<Texture> pNormal{ Load(normalPath, TextureFormat::NormalSNorm8, layout) };
+		const std::shared_ptr<Texture> pGloss{ Load(glossPath, TextureFormat::R8, layout) };
+		const std::shared_ptr<Texture> pSpecular{ Load(specularPath, TextureFormat::R8, layout) };
+
+		return FindOrCreate(key, [&]()
+			{
+				return Texture::PackMaterial(pDiffuse.get(), pNormal.get(), pGloss.get(), pSpecular.get(), layout);
+			});
+	}
+
+	void TextureRegistry::Evict(const Texture* pTexture)
+	{
+		const std::lock_guard lock{ m_Mutex };
+
+		std::erase_if(m_Textures, [pTexture](const auto& entry) { return entry.second.expired() || entry.second.lock().get() == pTexture; });
+	}
+
+	int TextureRegistry::GetTextureCount() const
+	{
+		const std::lock_guard lock{ m_Mutex };
+
+		return static_cast<int>(std::count_if(m_Textures.begin(), m_Textures.end(), [](const auto& entry) { return !entry.second.expired(); }));
+	}
+
+	size_t TextureRegistry::GetMemorySize() const
+	{
+		const std::lock_guard lock{ m_Mutex };
+
+		size_t memorySize{};
+		for (const auto& entry : m_Textures)
+		{
+			if (const std::shared_ptr<Texture> pTexture{ entry.second.lock() })
+			{
+				memorySize += pTexture->GetMemorySize();
+			}
+		}
+
+		return memorySize;
+	}
+
+	template<typename Create>
+	std::shared_ptr<Texture> TextureRegistry::FindOrCreate(const Key& key, const Create& create)
+	{
+		const std::lock_guard lock{ m_Mutex };
+
+		const auto it{ m_Textures.find(key) };
+		if (it != m_Textures.end())
+		{
+			if (std::shared_ptr<Texture> pTexture{ it->second.lock() })
+			{
+				return pTexture;
+			}
+		}
+
+		std::shared_ptr<Texture> pTexture{ create() };
+		if (!pTexture)
+		{
+			return nullptr;
+		}
+
+		std::erase_if(m_Textures, [](const auto& entry) { return entry.second.expired(); });
+		m_Textures[key] = pTexture;
+
+		return pTexture;
+	}
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "DataTypes.h"
+
+namespace dae
+{
+	class Texture;
+
+	//Loads every texture once and hands out shared handles to it
+	//Entries are keyed by path, format and layout, a texture (and the gpu copy it owns) is freed when its last handle goes away
+	class TextureRegistry final
+	{
+	public:
+		TextureRegistry() = default;
+		~TextureRegistry() = default;
+
+		TextureRegistry(const TextureRegistry&) = delete;
+		TextureRegistry(TextureRegistry&&) noexcept = delete;
+		TextureRegistry& operator=(const TextureRegistry&) = delete;
+		TextureRegistry& operator=(TextureRegistry&&) noexcept = delete;
+
+		std::shared_ptr<Texture> Load(const std::string& path, TextureFormat format = TextureFormat::RGBA8, TextureLayout layout = TextureLayout::Linear);
+
+		//Interleaved copy of four maps, shared like any other texture and keyed by the paths it was packed from
+		std::shared_ptr<Texture> LoadPackedMaterial(const std::string& diffusePath, const std::string& normalPath,
+			const std::string& glossPath, const std::string& specularPath, TextureLayout layout = TextureLayout::Linear);
+
+		//Forgets the entry handing out pTexture, later loads of its key create a fresh texture instead of sharing it
+		//Call this before changing a texture in place so the change never reaches the other holders of its key
+		void Evict(const Texture* pTexture);
+
+		//Textures that are still alive and the cpu memory they use
+		int GetTextureCount() const;
+		size_t GetMemorySize() const;
+
+	private:
+		struct Key
+		{
+			std::string path{};
+			TextureFormat format{};
+			TextureLayout layout{};
+
+			auto operator<=>(const Key&) const = default;
+		};
+
+		//Returns the live texture for key, or creates it while the lock is held so two callers never load the same file
+		template<typename Create>
+		std::shared_ptr<Texture> FindOrCreate(const Key& key, const Create& create);
+
+		//Weak, the handles own the textures, expired entries are swept when a new texture is added
+		std::map<Key, std::weak_ptr<Texture>> m_Textures{};
+		mutable std::mutex m_Mutex{};
+	};
+}
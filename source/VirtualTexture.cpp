@@ -0,0 +1,450 @@
+#include "pch.h"
+#include "VirtualTexture.h"
+#include "Texture.h"
+#include "Vector2.h"
+#include <filesystem>
+
+namespace dae
+{
+	namespace
+	{
+		struct PageFileHeader
+		{
+			char magic[4]{ 'V', 'T', 'E', 'X' };
+			int32_t width{};
+			int32_t height{};
+			int32_t levelCount{};
+			int32_t pageSize{};
+			int32_t pageBorder{};
+		};
+
+		constexpr int BytesPerTexel{ 4 };
+		constexpr int PageStride{ VirtualTexture::PageSize + 2 * VirtualTexture::PageBorder };
+		constexpr int StreamerCount{ 2 };
+
+		//A page that finished loading is only mapped if it was still needed this recently
+		constexpr uint32_t RequestLifetime{ 4 };
+		//Keeps the queue short, so the disk works on what the current view needs and not on a backlog
+		constexpr size_t MaxQueuedRequests{ 64 };
+
+		inline int Wrap(int texel, int size)
+		{
+			const int wrapped{ texel % size };
+			return wrapped < 0 ? wrapped + size : wrapped;
+		}
+	}
+
+	VirtualTexture::VirtualTexture(const std::string& pageFilePath, size_t budgetBytes) :
+		m_PageFilePath{ pageFilePath }
+	{
+		std::ifstream pageFile{ pageFilePath, std::ios::binary };
+		PageFileHeader header{};
+
+		if (!pageFile.read(reinterpret_cast<char*>(&header), sizeof(header)) || std::string(header.magic, 4) != "VTEX" ||
+			header.pageSize != PageSize || header.pageBorder != PageBorder)
+		{
+			throw std::runtime_error("Failed to open virtual texture page file " + pageFilePath);
+		}
+
+		//Same chain Texture builds, every level halves until 1x1
+		int width{ header.width };
+		int height{ header.height };
+		int pageCount{};
+
+		for (int level{}; level < header.levelCount; ++level)
+		{
+			Level& mipLevel{ m_Levels.emplace_back() };
+			mipLevel.width = width;
+			mipLevel.height = height;
+			mipLevel.pagesPerRow = (width + PageSize - 1) / PageSize;
+			mipLevel.pagesPerColumn = (height + PageSize - 1) / PageSize;
+			mipLevel.firstPage = pageCount;
+
+			pageCount += mipLevel.pagesPerRow * mipLevel.pagesPerColumn;
+			width = std::max(width / 2, 1);
+			height = std::max(height / 2, 1);
+		}
+
+		m_LodOffset = std::log2f(static_cast<float>(std::max(header.width, header.height)));
+		m_PageBytes = static_cast<size_t>(PageStride) * PageStride * BytesPerTexel;
+		m_PageFileHeaderBytes = sizeof(PageFileHeader);
+
+		m_PageTable.assign(pageCount, -1);
+		m_PageFrames = std::vector<std::atomic<uint32_t>>(pageCount);
+		m_IsPagePending.assign(pageCount, false);
+
+		//Levels that fit in a single page stay resident, they are what every lookup can fall back to
+		for (const Level& mipLevel : m_Levels)
+		{
+			if (mipLevel.pagesPerRow == 1 && mipLevel.pagesPerColumn == 1)
+			{
+				++m_PinnedSlotCount;
+			}
+		}
+
+		const int slotCount{ std::max(static_cast<int>(budgetBytes / m_PageBytes), m_PinnedSlotCount + 4) };
+		m_BudgetBytes = slotCount * m_PageBytes;
+		m_SlotTexels.resize(m_BudgetBytes);
+		m_SlotPages.assign(slotCount, -1);
+
+		int slot{};
+		for (const Level& mipLevel : m_Levels)
+		{
+			if (mipLevel.pagesPerRow == 1 && mipLevel.pagesPerColumn == 1)
+			{
+				LoadPage(pageFile, mipLevel.firstPage, m_SlotTexels.data() + slot * m_PageBytes);
+				m_PageTable[mipLevel.firstPage] = slot;
+				m_SlotPages[slot] = mipLevel.firstPage;
+				++slot;
+			}
+		}
+
+		for (int i{}; i < StreamerCount; ++i)
+		{
+			m_Streamers.emplace_back(&VirtualTexture::StreamLoop, this);
+		}
+	}
+
+	VirtualTexture::~VirtualTexture()
+	{
+		{
+			std::lock_guard<std::mutex> lock{ m_StreamMutex };
+			m_IsStopping = true;
+		}
+
+		m_StreamCondition.notify_all();
+
+		for (auto& streamer : m_Streamers)
+		{
+			streamer.join();
+		}
+	}
+
+	void VirtualTexture::Bake(const std::string& imagePath, const std::string& pageFilePath)
+	{
+		const std::unique_ptr<Texture> pTexture{ Texture::LoadFromFile(imagePath, TextureFormat::RGBA8, TextureLayout::Linear) };
+
+		std::ofstream pageFile{ pageFilePath, std::ios::binary };
+		if (!pageFile)
+		{
+			throw std::runtime_error("Failed to create virtual texture page file " + pageFilePath);
+		}
+
+		PageFileHeader header{};
+		header.width = pTexture->GetMipLevel(0).width;
+		header.height = pTexture->GetMipLevel(0).height;
+		header.levelCount = pTexture->GetMipCount();
+		header.pageSize = PageSize;
+		header.pageBorder = PageBorder;
+		pageFile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+		std::vector<uint8_t> page(static_cast<size_t>(PageStride) * PageStride * BytesPerTexel);
+
+		for (int level{}; level < pTexture->GetMipCount(); ++level)
+		{
+			const Texture::MipLevel& mipLevel{ pTexture->GetMipLevel(level) };
+			const int pagesPerRow{ (mipLevel.width + PageSize - 1) / PageSize };
+			const int pagesPerColumn{ (mipLevel.height + PageSize - 1) / PageSize };
+
+			for (int pageY{}; pageY < pagesPerColumn; ++pageY)
+			{
+				for (int pageX{}; pageX < pagesPerRow; ++pageX)
+				{
+					//Border and padding texels wrap around the level for the wrap sampler, clamp sampling never reads them
+					for (int y{}; y < PageStride; ++y)
+					{
+						const int levelY{ Wrap(pageY * PageSize + y - PageBorder, mipLevel.height) };
+
+						for (int x{}; x < PageStride; ++x)
+						{
+							const int levelX{ Wrap(pageX * PageSize + x - PageBorder, mipLevel.width) };
+							std::memcpy(page.data() + (x + static_cast<size_t>(y) * PageStride) * BytesPerTexel,
+								mipLevel.pTexels + (levelX + static_cast<size_t>(levelY) * mipLevel.width) * BytesPerTexel, BytesPerTexel);
+						}
+					}
+
+					pageFile.write(reinterpret_cast<const char*>(page.data()), page.size());
+				}
+			}
+		}
+	}
+
+	bool VirtualTexture::IsBakeCurrent(const std::string& imagePath, const std::string& pageFilePath)
+	{
+		std::error_code error{};
+		const auto pageFileTime{ std::filesystem::last_write_time(pageFilePath, error) };
+		if (error)
+		{
+			return false;
+		}
+
+		//An image that cannot be read is left to the constructor to report
+		const auto imageTime{ std::filesystem::last_write_time(imagePath, error) };
+		if (!error && imageTime > pageFileTime)
+		{
+			return false;
+		}
+
+		std::ifstream pageFile{ pageFilePath, std::ios::binary };
+		PageFileHeader header{};
+		return pageFile.read(reinterpret_cast<char*>(&header), sizeof(header)) && std::string(header.magic, 4) == "VTEX" &&
+			header.pageSize == PageSize && header.pageBorder == PageBorder;
+	}
+
+	ColorRGB VirtualTexture::Sample(const Vector2& uv, const SamplerState& sampler, float uvLod) const
+	{
+		const float lod{ Clamp(uvLod + m_LodOffset, 0.0f, static_cast<float>(m_Levels.size() - 1)) };
+
+		float u{ uv.x };
+		float v{ uv.y };
+		if (sampler.addressMode == TextureAddressMode::Wrap)
+		{
+			u -= std::floor(u);
+			v -= std::floor(v);
+		}
+		else
+		{
+			u = Saturate(u);
+			v = Saturate(v);
+		}
+
+		switch (sampler.filter)
+		{
+		case dae::TextureFilter::Point:
+			return SampleLevel(static_cast<int>(lod + 0.5f), u, v, false, sampler.addressMode);
+		case dae::TextureFilter::Bilinear:
+			return SampleLevel(static_cast<int>(lod + 0.5f), u, v, true, sampler.addressMode);
+		case dae::TextureFilter::Trilinear:
+		{
+			const int level{ static_cast<int>(lod) };
+			const ColorRGB colour{ SampleLevel(level, u, v, true, sampler.addressMode) };
+
+			if (level + 1 >= static_cast<int>(m_Levels.size()))
+			{
+				return colour;
+			}
+
+			return ColorRGB::Lerp(colour, SampleLevel(level + 1, u, v, true, sampler.addressMode), lod - level);
+		}
+		default:
+			return {};
+		}
+	}
+
+	void VirtualTexture::Update()
+	{
+		std::vector<LoadedPage> loadedPages{};
+		{
+			std::lock_guard<std::mutex> lock{ m_StreamMutex };
+			std::swap(loadedPages, m_LoadedPages);
+		}
+
+		//Map the pages that arrived, evicting the least recently used page that was not needed this frame
+		bool hasMappedPage{};
+		for (LoadedPage& loadedPage : loadedPages)
+		{
+			m_IsPagePending[loadedPage.page] = false;
+
+			if (m_Frame - m_PageFrames[loadedPage.page].load(std::memory_order_relaxed) > RequestLifetime)
+			{
+				continue;
+			}
+
+			int slot{ -1 };
+			uint32_t oldestFrame{ m_Frame };
+
+			for (int candidate{ m_PinnedSlotCount }; candidate < static_cast<int>(m_SlotPages.size()); ++candidate)
+			{
+				if (m_SlotPages[candidate] < 0)
+				{
+					slot = candidate;
+					break;
+				}
+
+				const uint32_t frame{ m_PageFrames[m_SlotPages[candidate]].load(std::memory_order_relaxed) };
+				if (frame < oldestFrame)
+				{
+					oldestFrame = frame;
+					slot = candidate;
+				}
+			}
+
+			//Every slot is in use by the current view, the budget is too small for it
+			if (slot < 0)
+			{
+				continue;
+			}
+
+			if (m_SlotPages[slot] >= 0)
+			{
+				m_PageTable[m_SlotPages[slot]] = -1;
+			}
+
+			std::memcpy(m_SlotTexels.data() + slot * m_PageBytes, loadedPage.texels.data(), m_PageBytes);
+			m_SlotPages[slot] = loadedPage.page;
+			m_PageTable[loadedPage.page] = slot;
+			hasMappedPage = true;
+		}
+
+		//Request what this frame needed but did not have, coarse pages first (pages are stored finest level first)
+		std::vector<int> missingPages{};
+		for (int page{ static_cast<int>(m_PageTable.size()) - 1 }; page >= 0; --page)
+		{
+			if (m_PageFrames[page].load(std::memory_order_relaxed) == m_Frame && m_PageTable[page] < 0 && !m_IsPagePending[page])
+			{
+				missingPages.push_back(page);
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> lock{ m_StreamMutex };
+
+			//Drop queued requests the view moved away from
+			std::erase_if(m_RequestedPages, [this](int page)
+				{
+					if (m_PageFrames[page].load(std::memory_order_relaxed) == m_Frame)
+					{
+						return false;
+					}
+
+					m_IsPagePending[page] = false;
+					return true;
+				});
+
+			for (int page : missingPages)
+			{
+				if (m_RequestedPages.size() >= MaxQueuedRequests)
+				{
+					break;
+				}
+
+				m_RequestedPages.push_back(page);
+				m_IsPagePending[page] = true;
+			}
+		}
+
+		m_StreamCondition.notify_all();
+
+		//Missing pages the queue had no room for wait on pending ones, so no pending page means nothing is missing either
+		m_IsSettled = !hasMappedPage && std::none_of(m_IsPagePending.begin(), m_IsPagePending.end(), [](bool isPending) { return isPending; });
+
+		++m_Frame;
+	}
+
+	bool VirtualTexture::IsSettled() const
+	{
+		return m_IsSettled;
+	}
+
+	int VirtualTexture::GetResidentPageCount() const
+	{
+		return static_cast<int>(std::count_if(m_SlotPages.begin(), m_SlotPages.end(), [](int page) { return page >= 0; }));
+	}
+
+	int VirtualTexture::GetPageCount() const
+	{
+		return static_cast<int>(m_PageTable.size());
+	}
+
+	size_t VirtualTexture::GetBudgetBytes() const
+	{
+		return m_BudgetBytes;
+	}
+
+	ColorRGB VirtualTexture::SampleLevel(int level, float u, float v, bool isBilinear, TextureAddressMode addressMode) const
+	{
+		//Walk up the chain until a resident page covers the uv, the pinned tail levels always do
+		for (int current{ level }; current < static_cast<int>(m_Levels.size()); ++current)
+		{
+			const Level& mipLevel{ m_Levels[current] };
+			const int texelX{ std::min(static_cast<int>(u * mipLevel.width), mipLevel.width - 1) };
+			const int texelY{ std::min(static_cast<int>(v * mipLevel.height), mipLevel.height - 1) };
+			const int pageX{ texelX / PageSize };
+			const int pageY{ texelY / PageSize };
+			const int page{ mipLevel.firstPage + pageX + pageY * mipLevel.pagesPerRow };
+
+			//Feedback, the fallback pages are marked too so they do not get evicted while they stand in
+			m_PageFrames[page].store(m_Frame, std::memory_order_relaxed);
+
+			const int slot{ m_PageTable[page] };
+			if (slot < 0)
+			{
+				continue;
+			}
+
+			const uint8_t* pTexels{ m_SlotTexels.data() + slot * m_PageBytes };
+			auto fetch = [pTexels](int x, int y)
+			{
+				const uint8_t* pTexel{ pTexels + (x + y * PageStride) * BytesPerTexel };
+				return ColorRGB{ pTexel[0] / 255.0f, pTexel[1] / 255.0f, pTexel[2] / 255.0f };
+			};
+
+			if (!isBilinear)
+			{
+				return fetch(texelX - pageX * PageSize + PageBorder, texelY - pageY * PageSize + PageBorder);
+			}
+
+			//The texel the uv falls in is inside the page, so its bilinear neighbours are at most one border texel out
+			const float x{ u * mipLevel.width - 0.5f - pageX * PageSize + PageBorder };
+			const float y{ v * mipLevel.height - 0.5f - pageY * PageSize + PageBorder };
+			int x0{ static_cast<int>(x) };
+			int y0{ static_cast<int>(y) };
+			const float xBlend{ x - x0 };
+			const float yBlend{ y - y0 };
+			int x1{ x0 + 1 };
+			int y1{ y0 + 1 };
+
+			//The border holds the texels across the wrapped edge, clamping keeps the footprint on the level's edge texels instead
+			if (addressMode == TextureAddressMode::Clamp)
+			{
+				const int levelLeft{ PageBorder - pageX * PageSize };
+				const int levelTop{ PageBorder - pageY * PageSize };
+				x0 = std::max(x0, levelLeft);
+				y0 = std::max(y0, levelTop);
+				x1 = std::min(x1, levelLeft + mipLevel.width - 1);
+				y1 = std::min(y1, levelTop + mipLevel.height - 1);
+			}
+
+			const ColorRGB top{ ColorRGB::Lerp(fetch(x0, y0), fetch(x1, y0), xBlend) };
+			const ColorRGB bottom{ ColorRGB::Lerp(fetch(x0, y1), fetch(x1, y1), xBlend) };
+			return ColorRGB::Lerp(top, bottom, yBlend);
+		}
+
+		return {};
+	}
+
+	void VirtualTexture::LoadPage(std::ifstream& pageFile, int page, uint8_t* pTexels) const
+	{
+		pageFile.seekg(m_PageFileHeaderBytes + page * m_PageBytes);
+		pageFile.read(reinterpret_cast<char*>(pTexels), m_PageBytes);
+	}
+
+	void VirtualTexture::StreamLoop()
+	{
+		std::ifstream pageFile{ m_PageFilePath, std::ios::binary };
+
+		while (true)
+		{
+			int page{};
+
+			{
+				std::unique_lock<std::mutex> lock{ m_StreamMutex };
+				m_StreamCondition.wait(lock, [this]() { return m_IsStopping || !m_RequestedPages.empty(); });
+
+				if (m_IsStopping)
+				{
+					return;
+				}
+
+				page = m_RequestedPages.front();
+				m_RequestedPages.pop_front();
+			}
+
+			LoadedPage loadedPage{ page, std::vector<uint8_t>(m_PageBytes) };
+			LoadPage(pageFile, page, loadedPage.texels.data());
+
+			std::lock_guard<std::mutex> lock{ m_StreamMutex };
+			m_LoadedPages.push_back(std::move(loadedPage));
+		}
+	}
+}
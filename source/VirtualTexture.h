@@ -0,0 +1,101 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ColorRGB.h"
+#include "DataTypes.h"
+
+namespace dae
+{
+	struct Vector2;
+
+	//RGBA8 texture that lives in a page file on disk, only the pages the software rasterizer asked for are kept in memory
+	//Sampling records which pages it needed (the feedback), Update streams missing ones in on background threads
+	//and evicts the least recently used ones to stay under the memory budget
+	//Until a page arrives, lookups fall back to the closest coarser mip that is resident
+	class VirtualTexture final
+	{
+	public:
+		//Pages hold PageSize x PageSize texels plus a border, so bilinear filtering never needs a second page
+		static constexpr int PageSize{ 128 };
+		static constexpr int PageBorder{ 1 };
+
+		VirtualTexture(const std::string& pageFilePath, size_t budgetBytes);
+		~VirtualTexture();
+
+		VirtualTexture(const VirtualTexture&) = delete;
+		VirtualTexture(VirtualTexture&&) noexcept = delete;
+		VirtualTexture& operator=(const VirtualTexture&) = delete;
+		VirtualTexture& operator=(VirtualTexture&&) noexcept = delete;
+
+		//Splits an image and its mip chain into pages and writes them to pageFilePath
+		static void Bake(const std::string& imagePath, const std::string& pageFilePath);
+		//False when the page file is missing, older than the image or baked with another page layout
+		static bool IsBakeCurrent(const std::string& imagePath, const std::string& pageFilePath);
+
+		//Safe to call from several threads during a frame, as long as Update is not running
+		ColorRGB Sample(const Vector2& uv, const SamplerState& sampler, float uvLod) const;
+
+		//Call once per frame after rasterizing: maps finished pages, requests missing ones and evicts unused ones
+		void Update();
+		//True when the last Update mapped no page and none is on its way, the same view would sample the same texels again
+		bool IsSettled() const;
+
+		int GetResidentPageCount() const;
+		int GetPageCount() const;
+		size_t GetBudgetBytes() const;
+
+	private:
+		struct Level
+		{
+			int width{};
+			int height{};
+			int pagesPerRow{};
+			int pagesPerColumn{};
+			int firstPage{};
+		};
+
+		struct LoadedPage
+		{
+			int page{};
+			std::vector<uint8_t> texels{};
+		};
+
+		ColorRGB SampleLevel(int level, float u, float v, bool isBilinear, TextureAddressMode addressMode) const;
+		void LoadPage(std::ifstream& pageFile, int page, uint8_t* pTexels) const;
+		void StreamLoop();
+
+		std::string m_PageFilePath{};
+		std::vector<Level> m_Levels{};
+		float m_LodOffset{};
+		size_t m_PageBytes{};
+		size_t m_PageFileHeaderBytes{};
+
+		//Page table: physical slot of every page, -1 when it is not resident
+		std::vector<int> m_PageTable{};
+		//Feedback: the last frame every page was needed in
+		mutable std::vector<std::atomic<uint32_t>> m_PageFrames;
+		std::vector<bool> m_IsPagePending{};
+		uint32_t m_Frame{ 1 };
+		bool m_IsSettled{};
+
+		//Physical pages, the number of slots is what the budget allows
+		std::vector<uint8_t> m_SlotTexels{};
+		std::vector<int> m_SlotPages{};
+		int m_PinnedSlotCount{};
+		size_t m_BudgetBytes{};
+
+		//Streaming
+		std::vector<std::thread> m_Streamers{};
+		std::deque<int> m_RequestedPages{};
+		std::vector<LoadedPage> m_LoadedPages{};
+		std::mutex m_StreamMutex{};
+		std::condition_variable m_StreamCondition{};
+		bool m_IsStopping{ false };
+	};
+}
@@ -6,6 +6,8 @@
 
 #undef main
 #include "Renderer.h"
+#include "TextureBenchmark.h"
+#include "FastMath.h"
 
 using namespace dae;
 
@@ -15,15 +17,193 @@ void ShutDown(SDL_Window* pWindow)
 	SDL_Quit();
 }
 
-int main(int argc, char* args[])
+void PrintUsage()
+{
+	std::cout << "\033[33m";
+	std::cout << "[Command Line]\n";
+	std::cout << "\t--benchmark-textures\t\t\tTime the texture layouts and formats, then quit\n";
+	std::cout << "\t--fastmath-report\t\t\tPrint the error of every math accuracy, then quit\n";
+	std::cout << "\t--compressed-textures\t\t\tStore the vehicle maps block compressed\n";
+	std::cout << "\t--virtual-textures\t\t\tStream the software diffuse map from a page file\n";
+	std::cout << "\t--virtual-texture-budget=<MiB>\t\tMemory for the streamed pages, above 0\n";
+	std::cout << "\t--math-accuracy=exact|fast|fastest\tPow and normalize in the software shading\n";
+	std::cout << "\t--frame-budget=<ms>\t\t\tStart the resolution governor with this budget\n";
+	std::cout << "\t--exposure=<multiplier>\t\t\tStart the software post-processing with this exposure\n";
+	std::cout << "\t--white-point=<linear>\t\t\tStart the software post-processing with this white point\n";
+	std::cout << "\t--srgb-output\t\t\t\tStart the software post-processing with sRGB encoding\n";
+	std::cout << "\033[0m";
+	std::cout << '\n';
+}
+
+//Prints what is wrong with a command line argument and how to use them, the caller quits
+int RejectArgument(const std::string& argument, const std::string& expected)
+{
+	std::cout << "\033[31m";
+	std::cout << "**(SHARED) Invalid argument " << argument << ", expected " << expected;
+	std::cout << '\n';
+	PrintUsage();
+
+	SDL_Quit();
+	return 1;
+}
+
+//The whole number after the '=' of a --name=<value> argument, false when that is not one
+bool ParseArgumentValue(const std::string& argument, size_t& value)
+{
+	const std::string text{ argument.substr(argument.find('=') + 1) };
+
+	//stoull would wrap a negative number around
+	if (text.empty() || !std::isdigit(static_cast<unsigned char>(text.front())))
+	{
+		return false;
+	}
+
+	try
+	{
+		size_t length{};
+		value = std::stoull(text, &length);
+		return length == text.size();
+	}
+	catch (const std::logic_error&)
+	{
+		//std::invalid_argument and std::out_of_range
+		return false;
+	}
+}
+
+//The finite number after the '=' of a --name=<value> argument, false when that is not one
+bool ParseArgumentValue(const std::string& argument, float& value)
 {
-	//Unreferenced parameters
-	(void)argc;
-	(void)args;
+	const std::string text{ argument.substr(argument.find('=') + 1) };
+
+	//stof would skip leading whitespace
+	if (text.empty() || std::isspace(static_cast<unsigned char>(text.front())))
+	{
+		return false;
+	}
 
+	try
+	{
+		size_t length{};
+		value = std::stof(text, &length);
+		return length == text.size() && std::isfinite(value);
+	}
+	catch (const std::logic_error&)
+	{
+		//std::invalid_argument and std::out_of_range
+		return false;
+	}
+}
+
+int main(int argc, char* args[])
+{
 	//Create window + surfaces
 	SDL_Init(SDL_INIT_VIDEO);
 
+	RendererSettings settings{};
+
+	for (int i{ 1 }; i < argc; ++i)
+	{
+		const std::string argument{ args[i] };
+
+		//Command line tools run instead of the renderer
+		if (argument == "--benchmark-textures")
+		{
+			TextureBenchmark::Run("Resources/vehicle_diffuse.png");
+			SDL_Quit();
+			return 0;
+		}
+
+		if (argument == "--fastmath-report")
+		{
+			FastMath::Report();
+			SDL_Quit();
+			return 0;
+		}
+
+		if (argument == "--compressed-textures")
+		{
+			settings.compressTextures = true;
+		}
+		else if (argument == "--virtual-textures")
+		{
+			settings.useVirtualTextures = true;
+		}
+		else if (argument.starts_with("--virtual-texture-budget="))
+		{
+			size_t budgetMiB{};
+			if (!ParseArgumentValue(argument, budgetMiB) || budgetMiB == 0 || budgetMiB > SIZE_MAX / (1024 * 1024))
+			{
+				return RejectArgument(argument, "a whole number of MiB above 0");
+			}
+
+			settings.virtualTextureBudget = budgetMiB * 1024 * 1024;
+		}
+		else if (argument.starts_with("--math-accuracy="))
+		{
+			const std::string accuracy{ argument.substr(argument.find('=') + 1) };
+			if (accuracy == "exact")
+			{
+				settings.mathAccuracy = MathAccuracy::Exact;
+			}
+			else if (accuracy == "fast")
+			{
+				settings.mathAccuracy = MathAccuracy::Fast;
+			}
+			else if (accuracy == "fastest")
+			{
+				settings.mathAccuracy = MathAccuracy::Fastest;
+			}
+			else
+			{
+				return RejectArgument(argument, "exact, fast or fastest");
+			}
+		}
+		else if (argument.starts_with("--frame-budget="))
+		{
+			float budgetMs{};
+			if (!ParseArgumentValue(argument, budgetMs) || budgetMs <= 0.0f)
+			{
+				return RejectArgument(argument, "a number of milliseconds above 0");
+			}
+
+			settings.frameBudgetMs = budgetMs;
+			settings.governResolution = true;
+		}
+		else if (argument.starts_with("--exposure="))
+		{
+			float exposure{};
+			if (!ParseArgumentValue(argument, exposure) || exposure <= 0.0f)
+			{
+				return RejectArgument(argument, "a multiplier above 0");
+			}
+
+			settings.exposure = exposure;
+			settings.postProcessing = true;
+		}
+		else if (argument.starts_with("--white-point="))
+		{
+			//The tone mapping divides by its square
+			float whitePoint{};
+			if (!ParseArgumentValue(argument, whitePoint) || whitePoint <= 0.0f)
+			{
+				return RejectArgument(argument, "a linear value above 0");
+			}
+
+			settings.whitePoint = whitePoint;
+			settings.postProcessing = true;
+		}
+		else if (argument == "--srgb-output")
+		{
+			settings.srgbOutput = true;
+			settings.postProcessing = true;
+		}
+		else
+		{
+			return RejectArgument(argument, "one of the options below");
+		}
+	}
+
 	const uint32_t width = 640;
 	const uint32_t height = 480;
 
@@ -38,7 +218,7 @@ int main(int argc, char* args[])
 
 	//Initialize "framework"
 	const auto pTimer = new Timer();
-	const auto pRenderer = new Renderer(pWindow);
+	const auto pRenderer = new Renderer(pWindow, settings);
 
 	//Start loop
 	pTimer->Start();
@@ -55,6 +235,13 @@ int main(int argc, char* args[])
 			case SDL_QUIT:
 				isLooping = false;
 				break;
+			case SDL_WINDOWEVENT:
+				//Unchanged frames are not presented again, so a window that got uncovered needs a full one
+				if (e.window.event == SDL_WINDOWEVENT_EXPOSED)
+				{
+					pRenderer->InvalidateFrame();
+				}
+				break;
 			case SDL_KEYUP:
 				//Test for a key
 				if (e.key.keysym.scancode == SDL_SCANCODE_F1)
@@ -101,6 +288,70 @@ int main(int argc, char* args[])
 				{
 					pRenderer->ToggleFPS();
 				}
+				else if (e.key.keysym.scancode == SDL_SCANCODE_A)
+				{
+					pRenderer->ToggleTextureAddressing();
+				}
+				else if (e.key.keysym.scancode == SDL_SCANCODE_T)
+				{
+					pRenderer->ToggleTangentSpaceLighting();
+				}
+				else if (e.key.keysym.scancode == SDL_SCANCODE_B)
+				{
+					pRenderer->ToggleBatchedShading();
+				}
+				else if (e.key.keysym.scancode == SDL_SCANCODE_I)
+				{
+					pRenderer->ToggleFixedPointShading();
+				}
+				else if (e.key.keysym.scancode == SDL_SCANCODE_L)
+				{
+					pRenderer->CycleLocalLights();
+				}
+				else if (e.key.keysym.scancode == SDL_SCANCODE_H)
+				{
+					pRenderer->ToggleShadows();
+				}
+				else if (e.key.keysym.scancode == SDL_SCANCODE_K)
+				{
+					pRenderer->ToggleShadingLod();
+				}
+				else if (e.key.keysym.scancode == SDL_SCANCODE_J)
+				{
+					pRenderer->ToggleShadingLodView();
+				}
+				else if (e.key.keysym.scancode == SDL_SCANCODE_U)
+				{
+					pRenderer->ToggleTextureSpaceShading();
+				}
+				else if (e.key.keysym.scancode == SDL_SCANCODE_O)
+				{
+					pRenderer->CycleTemporalReuse();
+				}
+				else if (e.key.keysym.scancode == SDL_SCANCODE_P)
+				{
+					pRenderer->ToggleDirtyRegions();
+				}
+				else if (e.key.keysym.scancode == SDL_SCANCODE_V)
+				{
+					pRenderer->ToggleCoarseShading();
+				}
+				else if (e.key.keysym.scancode == SDL_SCANCODE_C)
+				{
+					pRenderer->ToggleCheckerboard();
+				}
+				else if (e.key.keysym.scancode == SDL_SCANCODE_G)
+				{
+					pRenderer->ToggleResolutionGovernor();
+				}
+				else if (e.key.keysym.scancode == SDL_SCANCODE_M)
+				{
+					pRenderer->ToggleMultisampling();
+				}
+				else if (e.key.keysym.scancode == SDL_SCANCODE_X)
+				{
+					pRenderer->TogglePostProcessing();
+				}
 				break;
 			default: ;
 			}
@@ -112,6 +363,12 @@ int main(int argc, char* args[])
 		//--------- Render ---------
 		pRenderer->Render();
 
+		//Nothing changed, sleep until there is input or a frame's time has passed instead of spinning
+		if (!pRenderer->HasPresentedFrame())
+		{
+			SDL_WaitEventTimeout(nullptr, 16);
+		}
+
 		//--------- Timer ---------
 		pTimer->Update();
 		printTimer += pTimer->GetElapsed();